@@ -257,7 +257,7 @@ void handleFileUpload()
 
     if (fsUploadFile)
     {
-      fsUploadFile.write(upload.buf, upload.currentSize);
+      fsUploadFile.write(upload.data, upload.currentSize);
     }
   }
   else if (upload.status == UPLOAD_FILE_END)
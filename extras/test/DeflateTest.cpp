@@ -0,0 +1,278 @@
+/****************************************************************************************************************************
+  DeflateTest.cpp - Round trip of the deflate encoder through zlib: each input is compressed as gzip and as deflate,
+  written in pieces of 1, 7 and 1460 bytes and at once, then inflated and compared with the input. Then responses of
+  the server with compression enabled, and the ratio, time and memory of the encoder.
+
+  The inputs are longer than twice the largest window, so that the window slides, and include content without
+  matches and runs longer than the longest match. Built with the default window, hash and output buffer sizes, and
+  with others from the smallest to the largest.
+  Usage: DeflateTest [iterations of the benchmark]
+
+  Licensed under MIT license
+ *****************************************************************************************************************************/
+
+#include <random>
+#include <vector>
+
+#include <zlib.h>
+
+#include "HostTest.h"
+
+EthernetWebServer server(80);
+
+// Inflate a gzip or zlib stream, or return "" if it's not a complete and valid one
+static std::string inflateAll(const std::string& compressed, bool gzip)
+{
+  z_stream    stream = {};
+  std::string result;
+  char        buf[4096];
+  int         status;
+
+  inflateInit2(&stream, gzip ? 16 + 15 : 15);
+
+  stream.next_in  = (Bytef*) compressed.data();
+  stream.avail_in = compressed.size();
+
+  do
+  {
+    stream.next_out   = (Bytef*) buf;
+    stream.avail_out  = sizeof(buf);
+    status            = inflate(&stream, Z_NO_FLUSH);
+
+    result.append(buf, sizeof(buf) - stream.avail_out);
+  } while (status == Z_OK);
+
+  // Nothing may follow the stream
+  if ( (status != Z_STREAM_END) || stream.avail_in )
+    result = "";
+
+  inflateEnd(&stream);
+
+  return result;
+}
+
+////////////////////////////////////////
+
+static std::string  compressed;
+static size_t       writes = 0;
+
+static void collect(void* context, const uint8_t* data, size_t length)
+{
+  compressed.append((const char*) data, length);
+  writes++;
+}
+
+static std::string compress(ethernetDeflateEncoder& encoder, HTTPContentEncoding encoding, const std::string& input,
+                            size_t piece)
+{
+  compressed.clear();
+  encoder.begin(encoding);
+
+  for (size_t pos = 0; pos < input.size(); pos += piece)
+    encoder.write((const uint8_t*) input.data() + pos, (input.size() - pos < piece) ? input.size() - pos : piece);
+
+  encoder.finish();
+
+  return compressed;
+}
+
+////////////////////////////////////////
+
+static std::string jsonContent()
+{
+  std::string json = "[";
+
+  for (int i = 0; json.size() < 70000; i++)
+  {
+    json += "{\"id\":" + std::to_string(i) + ",\"name\":\"sensor-" + std::to_string(i % 37) + "\",\"value\":" +
+            std::to_string(i * 7919 % 1000) + ",\"ok\":" + ((i % 5) ? "true" : "false") + "},";
+  }
+
+  json.back() = ']';
+
+  return json;
+}
+
+static std::string htmlContent()
+{
+  std::string html = "<!DOCTYPE html><html><head><title>Sensors</title></head><body><table>\n";
+
+  for (int i = 0; html.size() < 70000; i++)
+  {
+    html += "<tr><td class=\"name\">Room " + std::to_string(i % 23) + "</td><td class=\"temp\">" +
+            std::to_string(180 + i * 31 % 90) + "</td><td><a href=\"/history?room=" + std::to_string(i % 23) +
+            "\">history</a></td></tr>\n";
+  }
+
+  return html + "</table></body></html>\n";
+}
+
+// Bytes without matches, then text pieces separated by random bytes, then long runs of one byte and of two
+static std::string mixedContent()
+{
+  std::mt19937  random(1);
+  std::string   mixed;
+
+  for (int i = 0; i < 40000; i++)
+    mixed += (char) random();
+
+  for (int i = 0; i < 1000; i++)
+    mixed += "temperature=" + std::string(1, (char) random()) + std::to_string(random() % 100) + "&";
+
+  mixed += std::string(30000, 'a');
+
+  for (int i = 0; i < 5000; i++)
+    mixed += "ab";
+
+  return mixed + "z";
+}
+
+static const struct
+{
+  const char*   name;
+  std::string   content;
+} inputs[] =
+{
+  { "empty",  "" },
+  { "1 byte", "x" },
+  { "3 bytes", "aaa" },
+  { "json",   jsonContent() },
+  { "html",   htmlContent() },
+  { "mixed",  mixedContent() }
+};
+
+static void testRoundTrip(ethernetDeflateEncoder& encoder)
+{
+  static const size_t pieces[] = { 1, 7, 1460, SIZE_MAX };
+
+  for (const auto& input : inputs)
+  {
+    for (int encoding = ENCODING_GZIP; encoding <= ENCODING_DEFLATE; encoding++)
+    {
+      for (size_t piece : pieces)
+      {
+        ethernetDeflateStats before = encoder.stats();
+        std::string          output = compress(encoder, (HTTPContentEncoding) encoding, input.content, piece);
+        ethernetDeflateStats after  = encoder.stats();
+
+        if (inflateAll(output, encoding == ENCODING_GZIP) != input.content)
+        {
+          printf("Round trip failed: %s, %s, pieces of %d bytes\n", input.name,
+                 (encoding == ENCODING_GZIP) ? "gzip" : "deflate", (int) piece);
+          hostTestFailures++;
+        }
+
+        CHECK_EQUAL(after.responses - before.responses, 1);
+        CHECK_EQUAL(after.inputBytes - before.inputBytes, input.content.size());
+        CHECK_EQUAL(after.outputBytes - before.outputBytes, output.size());
+      }
+    }
+  }
+}
+
+// Compressed output is passed on once HTTP_DEFLATE_OUTPUT_BUFLEN bytes are ready, and at the end
+static void testOutputBuffer(ethernetDeflateEncoder& encoder)
+{
+  writes = 0;
+
+  std::string output = compress(encoder, ENCODING_GZIP, inputs[5].content, 1460);
+
+  CHECK_EQUAL(writes, (output.size() + HTTP_DEFLATE_OUTPUT_BUFLEN - 1) / HTTP_DEFLATE_OUTPUT_BUFLEN);
+}
+
+////////////////////////////////////////
+
+// The body of the response to a GET of uri, sent with acceptEncoding, and inflated if it's compressed
+static std::string responseBody(const char* uri, const char* acceptEncoding, const char* expectedEncoding,
+                                const char* version = "1.1")
+{
+  HostResponse response = hostResponse(server, std::string("GET ") + uri + " HTTP/" + version + "\r\n" +
+                                       "Accept-Encoding: " + acceptEncoding + "\r\n\r\n");
+
+  CHECK_EQUAL(response.code, 200);
+  CHECK_EQUAL(response.header("Content-Encoding"), expectedEncoding);
+
+  if (!*expectedEncoding)
+    return response.body;
+
+  return inflateAll(response.body, !strcmp(expectedEncoding, "gzip"));
+}
+
+static void testServer()
+{
+  const std::string& json = inputs[3].content;
+
+  server.on("/json", [&json]()
+  {
+    server.send(200, "application/json", json.c_str());
+  });
+
+  server.on("/stream", [&json]()
+  {
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "text/html", "");
+
+    for (size_t pos = 0; pos < json.size(); pos += 1000)
+      server.sendContent(json.substr(pos, 1000).c_str());
+
+    server.sendContent("");
+  });
+
+  server.on("/image", [&json]()
+  {
+    server.send(200, "image/png", json.c_str());
+  });
+
+  server.begin();
+
+  // Not enabled yet
+  CHECK(responseBody("/json", "gzip", "") == json);
+
+  server.enableCompression();
+
+  CHECK(responseBody("/json", "gzip, deflate, br", "gzip") == json);
+  CHECK(responseBody("/json", "deflate", "deflate") == json);
+  CHECK(responseBody("/json", "gzip;q=0, deflate;q=0.5", "deflate") == json);
+  CHECK(responseBody("/json", "identity", "") == json);
+  CHECK(responseBody("/json", "gzip", "gzip", "1.0") == json);
+  CHECK(responseBody("/stream", "gzip", "gzip") == json);
+  CHECK(responseBody("/stream", "deflate", "deflate", "1.0") == json);
+  CHECK(responseBody("/image", "gzip", "") == json);
+}
+
+////////////////////////////////////////
+
+static void bench(ethernetDeflateEncoder& encoder, unsigned iterations)
+{
+  printf("window %d bits, hash %d bits, output %d bytes: %u bytes of memory\n", HTTP_DEFLATE_WINDOW_BITS,
+         HTTP_DEFLATE_HASH_BITS, HTTP_DEFLATE_OUTPUT_BUFLEN, (unsigned) encoder.stats().memory);
+
+  for (const auto& input : inputs)
+  {
+    if (input.content.size() < 1024)
+      continue;
+
+    size_t    length = 0;
+    HostTimer timer;
+
+    for (unsigned i = 0; i < iterations; i++)
+      length = compress(encoder, ENCODING_GZIP, input.content, 1460).size();
+
+    double micros = timer.micros() / iterations;
+
+    printf("%-6s %6u -> %6u bytes, ratio %5.2f, %6.2f us/KB\n", input.name, (unsigned) input.content.size(),
+           (unsigned) length, (double) input.content.size() / length, micros / (input.content.size() / 1024.0));
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  static ethernetDeflateEncoder encoder(collect, nullptr);
+
+  testRoundTrip(encoder);
+  testOutputBuffer(encoder);
+  testServer();
+  bench(encoder, (argc > 1) ? atoi(argv[1]) : 20);
+
+  return hostTestResult("DeflateTest");
+}
@@ -0,0 +1,65 @@
+/****************************************************************************************************************************
+  HeaderBench.cpp - Time, heap allocations and write() calls per response, for responses with more and more headers.
+
+  The requests are as short as possible, so that what's measured is mostly the response: its status line, the headers
+  added by the handler with sendHeader(), those of CORS, and their write to the client. Only the API of the original
+  library is used, so that the benchmark also builds against it, see README.md.
+  Usage: HeaderBench [responses]
+
+  Licensed under MIT license
+ *****************************************************************************************************************************/
+
+#include "HostTest.h"
+
+EthernetWebServer server(80);
+
+static const char content[] = "{\"temperature\":21.5,\"humidity\":48}";
+
+static void bench(const char* name, const char* uri, int code, unsigned count)
+{
+  HostResponse    response;
+  HostBenchResult result = hostBench(server, std::string("GET ") + uri + " HTTP/1.1\r\n\r\n", count, response);
+
+  CHECK_EQUAL(response.code, code);
+
+  printf("%-30s %7.2f us %6.1f allocations %5.1f writes %5u header bytes\n", name, result.micros, result.allocations,
+         result.writes, (unsigned) response.headers.size() + 4);
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned count = (argc > 1) ? atoi(argv[1]) : 50000;
+
+  server.on("/plain", []()
+  {
+    server.send(200, "application/json", content);
+  });
+
+  server.on("/headers", []()
+  {
+    server.sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");
+    server.sendHeader("X-Device", "sensor-node-12");
+    server.sendHeader("Set-Cookie", "session=8f14e45fceea167a5a36dedd4bea2543; Path=/; HttpOnly");
+    server.send(200, "application/json", content);
+  });
+
+  server.on("/redirect", []()
+  {
+    server.sendHeader("Cache-Control", "no-cache");
+    server.sendHeader("Location", "/index.html", true);
+    server.send(302, "text/plain", "");
+  });
+
+  server.begin();
+
+  bench("send(), no header", "/plain", 200, count);
+  bench("3 sendHeader(), then send()", "/headers", 200, count);
+  bench("redirect, a header first", "/redirect", 302, count);
+
+  server.enableCORS();
+
+  bench("CORS, no header", "/plain", 200, count);
+  bench("CORS, 3 sendHeader()", "/headers", 200, count);
+
+  return hostTestResult("HeaderBench");
+}
@@ -0,0 +1,275 @@
+/****************************************************************************************************************************
+  HostTest.h - Helpers of the EthernetWebServer host tests and benchmarks.
+
+  Each test is one translation unit: it sets the configuration macros it needs, then includes this file, which
+  includes the whole header-only library on top of the host mocks.
+
+  Licensed under MIT license
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <chrono>
+#include <string>
+
+#include "MockEthernet.h"
+#include "MockHeap.h"
+
+#include <EthernetWebServer.h>
+
+////////////////////////////////////////
+
+static int hostTestFailures = 0;
+
+#define CHECK(cond)                                                                     \
+  do                                                                                    \
+  {                                                                                     \
+    if (!(cond))                                                                        \
+    {                                                                                   \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);                   \
+      hostTestFailures++;                                                               \
+    }                                                                                   \
+  } while (0)
+
+#define CHECK_EQUAL(actual, expected)                                                   \
+  hostCheckEqual(actual, expected, #actual, __FILE__, __LINE__)
+
+inline void hostCheckEqual(const std::string& actual, const std::string& expected, const char* expr,
+                           const char* file, int line)
+{
+  if (actual != expected)
+  {
+    printf("%s:%d: %s is \"%.200s\", expected \"%.200s\"\n", file, line, expr, actual.c_str(), expected.c_str());
+    hostTestFailures++;
+  }
+}
+
+inline void hostCheckEqual(long long actual, long long expected, const char* expr, const char* file, int line)
+{
+  if (actual != expected)
+  {
+    printf("%s:%d: %s is %lld, expected %lld\n", file, line, expr, actual, expected);
+    hostTestFailures++;
+  }
+}
+
+// Return value of main()
+inline int hostTestResult(const char* name)
+{
+  if (hostTestFailures)
+    printf("%s: %d check(s) failed\n", name, hostTestFailures);
+  else
+    printf("%s: all checks passed\n", name);
+
+  fflush(stdout);
+
+  return hostTestFailures ? 1 : 0;
+}
+
+////////////////////////////////////////
+
+// Response parsed from what the server wrote
+struct HostResponse
+{
+  int         code    = 0;
+  std::string headers;          // status line and headers, without the empty line ending them
+  std::string body;             // the chunked framing removed
+  bool        chunked = false;
+
+  // Value of the header name, or "" if it wasn't sent
+  std::string header(const char* name) const
+  {
+    std::string key = std::string("\r\n") + name + ": ";
+    size_t      pos = headers.find(key);
+
+    if (pos == std::string::npos)
+      return "";
+
+    pos += key.size();
+
+    return headers.substr(pos, headers.find("\r\n", pos) - pos);
+  }
+
+  bool hasHeader(const char* name) const
+  {
+    return headers.find(std::string("\r\n") + name + ": ") != std::string::npos;
+  }
+};
+
+// Parse the response at the start of output, whose body ends after its Content-Length, its last chunk, or at the
+// end of output. Return the length of the response, or 0 if it's incomplete
+inline size_t hostParseResponse(const std::string& output, HostResponse& response)
+{
+  size_t headersEnd = output.find("\r\n\r\n");
+
+  if (headersEnd == std::string::npos)
+    return 0;
+
+  response          = HostResponse();
+  response.headers  = output.substr(0, headersEnd);
+  response.code     = atoi(output.c_str() + output.find(' ') + 1);
+  response.chunked  = (response.header("Transfer-Encoding") == "chunked");
+
+  size_t pos = headersEnd + 4;
+
+  if (response.chunked)
+  {
+    while (true)
+    {
+      size_t lineEnd = output.find("\r\n", pos);
+
+      if (lineEnd == std::string::npos)
+        return 0;
+
+      size_t length = strtoul(output.c_str() + pos, NULL, 16);
+
+      pos = lineEnd + 2;
+
+      if (length == 0)
+        return pos + 2;
+
+      if (pos + length + 2 > output.size())
+        return 0;
+
+      response.body.append(output, pos, length);
+      pos += length + 2;
+    }
+  }
+
+  if (response.hasHeader("Content-Length"))
+  {
+    size_t length = strtoul(response.header("Content-Length").c_str(), NULL, 10);
+
+    if (pos + length > output.size())
+      return 0;
+
+    response.body = output.substr(pos, length);
+
+    return pos + length;
+  }
+
+  response.body = output.substr(pos);
+
+  return output.size();
+}
+
+////////////////////////////////////////
+
+// Run the server until it has read all the input of connection, or closed it, then a few more times to let it answer
+inline void hostServe(EthernetWebServer& server, const MockConnectionPtr& connection)
+{
+  for (int i = 0; (i < 10000) && !connection->done(); i++)
+    server.handleClient();
+
+  for (int i = 0; i < 4; i++)
+    server.handleClient();
+}
+
+// Close connection from the client side, and let the server release it
+inline void hostClose(EthernetWebServer& server, const MockConnectionPtr& connection)
+{
+  connection->open = false;
+
+  for (int i = 0; (i < 10) && !connection->stopped; i++)
+  {
+    server.handleClient();
+
+    // Past any timeout of a request left incomplete
+    mockMillis() += 60000;
+  }
+}
+
+// Send input on a new connection, and return what the server wrote back before the client closed it
+inline std::string hostRequest(EthernetWebServer& server, const std::string& input)
+{
+  MockConnectionPtr connection = MockNetwork::connect(input);
+
+  hostServe(server, connection);
+  hostClose(server, connection);
+
+  return connection->output;
+}
+
+inline HostResponse hostResponse(EthernetWebServer& server, const std::string& input)
+{
+  HostResponse response;
+
+  hostParseResponse(hostRequest(server, input), response);
+
+  return response;
+}
+
+////////////////////////////////////////
+
+class HostTimer
+{
+  public:
+
+    HostTimer() : _start(std::chrono::steady_clock::now()) {}
+
+    double micros() const
+    {
+      return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - _start).count();
+    }
+
+  private:
+
+    std::chrono::steady_clock::time_point _start;
+};
+
+////////////////////////////////////////
+
+// Average cost of a request served by hostBench()
+struct HostBenchResult
+{
+  double micros       = 0;
+  double allocations  = 0;    // calls to operator new
+  double reads        = 0;    // read() calls of the server, each an SPI transaction on W5x00
+  double writes       = 0;    // write() calls, each a transfer to the TX buffer and a SEND command on W5x00
+  double outputBytes  = 0;
+};
+
+// Serve input count times, each on its own connection, and return the average cost of a request. The connections
+// are set up and closed outside the measurement. The last response is parsed into response
+inline HostBenchResult hostBench(EthernetWebServer& server, const std::string& input, unsigned count,
+                                 HostResponse& response)
+{
+  HostBenchResult result;
+  std::string     output;
+
+  for (unsigned i = 0; i < count; i++)
+  {
+    MockConnectionPtr connection = MockNetwork::connect(input);
+
+    connection->output.reserve(output.size() + 512);
+
+    uint64_t  allocations = MockHeap::allocations;
+    HostTimer timer;
+
+    hostServe(server, connection);
+
+    result.micros       += timer.micros();
+    result.allocations  += MockHeap::allocations - allocations;
+    result.reads        += connection->reads;
+    result.writes       += connection->writes;
+    result.outputBytes  += connection->output.size();
+
+    hostClose(server, connection);
+    output.swap(connection->output);
+  }
+
+  hostParseResponse(output, response);
+
+  result.micros       /= count;
+  result.allocations  /= count;
+  result.reads        /= count;
+  result.writes       /= count;
+  result.outputBytes  /= count;
+
+  return result;
+}
+
+#endif // HOST_TEST_H
@@ -0,0 +1,224 @@
+/****************************************************************************************************************************
+  JsonTest.cpp - Correctness of the JSON parser of onJson(): paths of the values, unescaping, limits of depth, path
+  and value length, documents ending early, received whole or a byte at a time. Then routes registered with onJson().
+
+  Licensed under MIT license
+ *****************************************************************************************************************************/
+
+#include "HostTest.h"
+
+EthernetWebServer server(80);
+
+static ethernetJsonParser parser;
+
+// Values of the last document, "path=value" separated by ' ', with the type of each as a prefix: s, n, b or 0
+static std::string values;
+
+static void recordValue(const ethernetJsonValue& value)
+{
+  static const char types[] = "snb0";
+
+  values += std::string(values.empty() ? "" : " ") + types[value.type] + value.path + "=" +
+            std::string(value.value, value.length) + (value.truncated ? "..." : "");
+}
+
+// Parse doc in pieces of pieceLength bytes, and return the error, the values in values
+static HTTPJsonError parse(const std::string& doc, size_t pieceLength = SIZE_MAX)
+{
+  values.clear();
+  parser.begin();
+
+  for (size_t pos = 0; pos < doc.size(); pos += pieceLength)
+  {
+    size_t length = (doc.size() - pos < pieceLength) ? doc.size() - pos : pieceLength;
+
+    parser.feed((const uint8_t *) doc.data() + pos, length, []()
+    {
+      recordValue(parser.value());
+    });
+  }
+
+  parser.end([]()
+  {
+    recordValue(parser.value());
+  });
+
+  return parser.error();
+}
+
+// Parsed whole, and a byte at a time, doc gives the error and the values expected
+static void checkParse(const std::string& doc, HTTPJsonError error, const std::string& expected)
+{
+  CHECK_EQUAL(parse(doc), error);
+  CHECK_EQUAL(values, expected);
+
+  CHECK_EQUAL(parse(doc, 1), error);
+  CHECK_EQUAL(values, expected);
+}
+
+////////////////////////////////////////
+
+static void testPaths()
+{
+  checkParse("{\"wifi\":{\"ssid\":\"home\",\"channel\":6},\"leds\":[{\"on\":true},{\"on\":false,\"level\":null}]}",
+             JSON_OK, "swifi.ssid=home nwifi.channel=6 bleds[0].on=true bleds[1].on=false 0leds[1].level=null");
+
+  checkParse("{\"a\":{\"b\":[1,[2,3],{\"c\":\"x\"}]}}", JSON_OK, "na.b[0]=1 na.b[1][0]=2 na.b[1][1]=3 sa.b[2].c=x");
+
+  // Empty objects and arrays have no values, but take their index
+  checkParse("[[],{},-1.5e+3]", JSON_OK, "n[2]=-1.5e+3");
+
+  // A document which is a single value has an empty path, a number ending it being complete at the end
+  checkParse("\"text\"", JSON_OK, "s=text");
+  checkParse(" 42 ", JSON_OK, "n=42");
+  checkParse("42", JSON_OK, "n=42");
+}
+
+static void testStrings()
+{
+  checkParse("{\"s\":\"a\\\"b\\\\c\\/d\\n\\t\"}", JSON_OK, "ss=a\"b\\c/d\n\t");
+
+  // "\uXXXX" in UTF-8, a surrogate pair being one code point, a lone surrogate U+FFFD
+  checkParse("[\"\\u00e9\\u20AC\",\"\\ud83d\\ude00!\",\"\\ud83d\",\"\\ude00\"]", JSON_OK,
+             "s[0]=\xC3\xA9\xE2\x82\xAC s[1]=\xF0\x9F\x98\x80! s[2]=\xEF\xBF\xBD s[3]=\xEF\xBF\xBD");
+
+  // Keys are unescaped too
+  checkParse("{\"k\\u0065y\":1}", JSON_OK, "nkey=1");
+
+  checkParse("[\"\\x\"]", JSON_SYNTAX_ERROR, "");
+  checkParse("[\"\\u12G4\"]", JSON_SYNTAX_ERROR, "");
+  checkParse("[\"a\nb\"]", JSON_SYNTAX_ERROR, "");
+}
+
+static void testLimits()
+{
+  // Nesting
+  std::string deepest = std::string(HTTP_JSON_MAX_DEPTH, '[') + "1" + std::string(HTTP_JSON_MAX_DEPTH, ']');
+  std::string path;
+
+  for (int i = 0; i < HTTP_JSON_MAX_DEPTH; i++)
+    path += "[0]";
+
+  checkParse(deepest, JSON_OK, "n" + path + "=1");
+  checkParse("[" + deepest + "]", JSON_TOO_DEEP, "");
+
+  // Path, with its NUL: "key[9]" fits, "key[10]" doesn't
+  std::string key(HTTP_JSON_PATH_LEN - 4, 'k');
+  std::string elements;
+  std::string expected;
+
+  for (int i = 0; i < 10; i++)
+  {
+    elements += std::to_string(i) + ",";
+    expected += std::string(i ? " " : "") + "n" + key + "[" + std::to_string(i) + "]=" + std::to_string(i);
+  }
+
+  checkParse("{\"" + key + "\":[" + elements + "10]}", JSON_TOO_LONG, expected);
+  checkParse("{\"" + key + "k\":[1]}", JSON_TOO_LONG, "");
+  checkParse("{\"abc\":{\"" + key + "\":1}}", JSON_TOO_LONG, "");
+
+  // A string value too long is cut, a key or a number can't be
+  std::string longest(HTTP_JSON_VALUE_LEN - 1, 'v');
+
+  checkParse("[\"" + longest + "\"]", JSON_OK, "s[0]=" + longest);
+  checkParse("[\"" + longest + "w\"]", JSON_OK, "s[0]=" + longest + "...");
+  checkParse("{\"" + longest + "w\":1}", JSON_TOO_LONG, "");
+  checkParse("[" + std::string(HTTP_JSON_VALUE_LEN, '1') + "]", JSON_TOO_LONG, "");
+}
+
+static void testInvalid()
+{
+  // Ending early, the values before still passed. A number in an object or array only ends with what follows it
+  checkParse("", JSON_INCOMPLETE, "");
+  checkParse("{\"a\":1", JSON_INCOMPLETE, "");
+  checkParse("{\"a\":1,", JSON_INCOMPLETE, "na=1");
+  checkParse("{\"a\":", JSON_INCOMPLETE, "");
+  checkParse("{\"a\":\"tex", JSON_INCOMPLETE, "");
+  checkParse("[\"\\u00", JSON_INCOMPLETE, "");
+  checkParse("[1,2", JSON_INCOMPLETE, "n[0]=1");
+
+  checkParse("{\"a\" 1}", JSON_SYNTAX_ERROR, "");
+  checkParse("{a:1}", JSON_SYNTAX_ERROR, "");
+  checkParse("[1,]", JSON_SYNTAX_ERROR, "n[0]=1");
+  checkParse("[1}", JSON_SYNTAX_ERROR, "n[0]=1");
+  checkParse("[01]", JSON_SYNTAX_ERROR, "");
+  checkParse("[tru]", JSON_SYNTAX_ERROR, "");
+  checkParse("{} {}", JSON_SYNTAX_ERROR, "");
+}
+
+////////////////////////////////////////
+
+static void testRoute()
+{
+  HostResponse response;
+  std::string  body = "{\"ssid\":\"home\",\"leds\":[1,2]}";
+
+  // Whatever the parameters of the type, the body is parsed as it's received
+  values.clear();
+  response = hostResponse(server, "POST /api/config HTTP/1.1\r\n"
+                          "Content-Type: application/json; charset=utf-8\r\n"
+                          "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                          "\r\n" + body);
+
+  CHECK_EQUAL(response.code, 200);
+  CHECK_EQUAL(values, "sssid=home nleds[0]=1 nleds[1]=2");
+
+  // Chunked
+  values.clear();
+  response = hostResponse(server, "POST /api/config HTTP/1.1\r\n"
+                          "Content-Type: application/json\r\n"
+                          "Transfer-Encoding: chunked\r\n"
+                          "\r\n"
+                          "9\r\n{\"ssid\":\"\r\n"
+                          "5\r\nhome\"\r\n"
+                          "1\r\n}\r\n"
+                          "0\r\n\r\n");
+
+  CHECK_EQUAL(response.code, 200);
+  CHECK_EQUAL(values, "sssid=home");
+
+  // Another type isn't parsed
+  values.clear();
+  response = hostResponse(server, "POST /api/config HTTP/1.1\r\n"
+                          "Content-Type: text/plain\r\n"
+                          "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                          "\r\n" + body);
+
+  CHECK_EQUAL(response.code, 415);
+  CHECK_EQUAL(values, "");
+
+  // The body ending before the document
+  values.clear();
+  response = hostResponse(server, "POST /api/config HTTP/1.1\r\n"
+                          "Content-Type: application/json\r\n"
+                          "Content-Length: 10\r\n"
+                          "\r\n"
+                          "{\"ssid\":\"h");
+
+  CHECK_EQUAL(response.code, 400);
+  CHECK_EQUAL(response.body, "1");
+}
+
+int main()
+{
+  testPaths();
+  testStrings();
+  testLimits();
+  testInvalid();
+
+  server.onJson("/api/config", HTTP_POST, []()
+  {
+    HTTPJsonError error = server.jsonError();
+
+    server.send((error == JSON_OK) ? 200 : ((error == JSON_NOT_JSON) ? 415 : 400), "text/plain", String((int) error));
+  }, []()
+  {
+    recordValue(server.jsonValue());
+  });
+
+  server.begin();
+
+  testRoute();
+
+  return hostTestResult("JsonTest");
+}
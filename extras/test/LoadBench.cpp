@@ -0,0 +1,176 @@
+/****************************************************************************************************************************
+  LoadBench.cpp - Latency of clients connecting together, served by one sketch loop.
+
+  The requests arrive at a given rate from the time their client connects, as over a slow network, and the sketch
+  loop calls handleClient() once per millisecond. The latency of a client is the time from its connection until
+  its response is complete. Built with HTTP_MAX_CONNECTIONS 1, the default of the mock Ethernet library, and 4.
+  Also the latency of a GET sent while another client trickles the body of a post.
+  Only the API of the original library is used, so that the benchmark also builds against it, see README.md.
+  Usage: LoadBench [clients]
+
+  Licensed under MIT license
+ *****************************************************************************************************************************/
+
+#include <vector>
+
+#include "HostTest.h"
+
+#ifndef HTTP_MAX_CONNECTIONS
+  // Original library
+  #define HTTP_MAX_CONNECTIONS  1
+#endif
+
+EthernetWebServer server(80);
+
+static const char request[] =
+  "GET /api/status HTTP/1.1\r\n"
+  "Host: 192.168.2.100\r\n"
+  "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101 Firefox/115.0\r\n"
+  "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+  "Accept-Language: en-US,en;q=0.5\r\n"
+  "Accept-Encoding: gzip, deflate\r\n"
+  "Connection: close\r\n"
+  "\r\n";
+
+// Run the sketch loop until each client got its response, and print the latencies. Client i connects at
+// connectAt[i] ms, and its request arrives at bytesPerMs[i]
+static void bench(const char* name, const std::vector<unsigned long>& connectAt, const std::vector<size_t>& bytesPerMs)
+{
+  size_t                          clients = connectAt.size();
+  std::vector<MockConnectionPtr>  connections(clients);
+  std::vector<unsigned long>      latency(clients);
+  size_t                          done    = 0;
+  unsigned long                   start   = millis();
+
+  while ( (done < clients) && (millis() - start < 60000) )
+  {
+    for (size_t i = 0; i < clients; i++)
+    {
+      if (!connections[i] && (millis() - start == connectAt[i]))
+      {
+        connections[i] = MockNetwork::connect(request);
+        connections[i]->bytesPerMs = bytesPerMs[i];
+      }
+    }
+
+    server.handleClient();
+
+    for (size_t i = 0; i < clients; i++)
+    {
+      HostResponse response;
+
+      if ( connections[i] && !latency[i] && hostParseResponse(connections[i]->output, response) )
+      {
+        CHECK_EQUAL(response.code, 200);
+
+        latency[i] = millis() - connections[i]->connectedAt + 1;
+        done++;
+      }
+    }
+
+    delay(1);
+  }
+
+  CHECK_EQUAL(done, clients);
+
+  unsigned long total = 0;
+  unsigned long worst = 0;
+
+  for (size_t i = 0; i < clients; i++)
+  {
+    total += latency[i];
+    worst  = (latency[i] > worst) ? latency[i] : worst;
+  }
+
+  printf("%-44s mean %6.1f ms  max %5lu ms  (", name, (double) total / clients, worst);
+
+  for (size_t i = 0; i < clients; i++)
+    printf("%s%lu", i ? " " : "", latency[i]);
+
+  printf(")\n");
+
+  // Let the server close what's left
+  for (size_t i = 0; i < clients; i++)
+    hostClose(server, connections[i]);
+}
+
+// A post whose body trickles in, a byte every 2 s, then a GET on another connection. The post mustn't hold the request
+// state for ever: the GET is answered once the post had HTTP_MAX_POST_WAIT for its whole body. With one connection
+// the GET waits to be accepted, as with the original library, and isn't checked
+static void benchSlowBody()
+{
+  MockConnectionPtr post = MockNetwork::connect("POST /api/status HTTP/1.1\r\n"
+                                                "Content-Type: text/plain\r\n"
+                                                "Content-Length: 100\r\n"
+                                                "\r\n" + std::string(100, 'x'));
+  MockConnectionPtr get;
+  unsigned long     latency = 0;
+  unsigned long     start   = millis();
+
+  post->received = post->input.size() - 100;
+
+  while ( !latency && (millis() - start < 60000) )
+  {
+    if ( (millis() - start) % 2000 == 1999 )
+      post->receive(1);
+
+    if (millis() - start == 100)
+      get = MockNetwork::connect(request);
+
+    server.handleClient();
+
+    HostResponse response;
+
+    if ( get && hostParseResponse(get->output, response) )
+    {
+      CHECK_EQUAL(response.code, 200);
+
+      latency = millis() - get->connectedAt + 1;
+    }
+
+    delay(1);
+  }
+
+  if (HTTP_MAX_CONNECTIONS > 1)
+    CHECK(latency > 0);
+
+  if (latency)
+    printf("%-44s GET after %5lu ms\n", "post body at 1 byte/2 s, then a GET", latency);
+  else
+    printf("%-44s GET not answered in 60 s\n", "post body at 1 byte/2 s, then a GET");
+
+  post->received = SIZE_MAX;
+  hostClose(server, post);
+
+  if (get)
+    hostClose(server, get);
+}
+
+int main(int argc, char* argv[])
+{
+  size_t clients = (argc > 1) ? atoi(argv[1]) : 4;
+
+  server.on("/api/status", []()
+  {
+    server.send(200, "application/json", "{\"temperature\":21.5,\"humidity\":48}");
+  });
+
+  server.begin();
+
+  printf("HTTP_MAX_CONNECTIONS %d, %u clients, request of %u bytes\n", HTTP_MAX_CONNECTIONS, (unsigned) clients,
+         (unsigned) (sizeof(request) - 1));
+
+  // Each request takes about 30 ms to arrive
+  bench("together, 10 bytes/ms", std::vector<unsigned long>(clients, 0), std::vector<size_t>(clients, 10));
+
+  // A slow client first, the others stuck behind it unless served concurrently
+  std::vector<size_t> rates(clients, 100);
+
+  rates[0] = 1;
+
+  bench("one at 1 byte/ms, then others at 100 bytes/ms", std::vector<unsigned long>(clients, 0), rates);
+
+  benchSlowBody();
+
+  return hostTestResult("LoadBench");
+}
@@ -0,0 +1,124 @@
+/****************************************************************************************************************************
+  LookupBench.cpp - Time of arg(), hasArg(), header() and hasHeader() in the handler of a form post, with 16 arguments
+  and 8 collected headers out of 12, and time and heap allocations of the whole request.
+
+  The handler looks up every argument and header by name, and a few missing ones, the names already in Strings. The
+  headers are looked up in the case they were collected in, which the original library needs. Only the API of the original library is used, so that the
+  benchmark also builds against it, see README.md.
+  Usage: LookupBench [requests]
+
+  Licensed under MIT license
+ *****************************************************************************************************************************/
+
+#include "HostTest.h"
+
+EthernetWebServer server(80);
+
+static const char* argNames[] =
+{
+  "ssid", "password", "ip", "mask", "gateway", "dns1", "dns2", "hostname",
+  "ntp", "tz", "interval", "unit", "mqttHost", "mqttPort", "mqttUser", "mqttPass"
+};
+
+static const char* headerKeys[] =
+{
+  "User-Agent", "Accept", "Accept-Language", "Referer", "Origin", "Cookie", "Authorization", "X-Requested-With"
+};
+
+static const int ARGS     = sizeof(argNames) / sizeof(argNames[0]);
+static const int HEADERS  = sizeof(headerKeys) / sizeof(headerKeys[0]);
+static const int MISSING  = 4;
+
+// Names looked up, built once: the arguments and the headers, then names of neither
+static String   argKeys[ARGS + MISSING];
+static String   headerLookups[HEADERS + MISSING];
+
+// Repeats of the lookups in each request, to time them
+static const int  REPEATS = 10;
+
+static double   lookupMicros      = 0;
+static uint64_t lookupAllocations = 0;
+static unsigned lookupsFound      = 0;
+
+static void handleSettings()
+{
+  uint64_t  allocations = MockHeap::allocations;
+  HostTimer timer;
+  unsigned  found       = 0;
+
+  for (int repeat = 0; repeat < REPEATS; repeat++)
+  {
+    for (const String& name : argKeys)
+      found += server.hasArg(name) + (server.arg(name).length() > 0);
+
+    for (const String& name : headerLookups)
+      found += server.hasHeader(name) + (server.header(name).length() > 0);
+  }
+
+  lookupMicros      += timer.micros();
+  lookupAllocations += MockHeap::allocations - allocations;
+  lookupsFound       = found / REPEATS;
+
+  server.send(200, "text/plain", "saved");
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned count = (argc > 1) ? atoi(argv[1]) : 20000;
+
+  std::string body;
+
+  for (int i = 0; i < ARGS; i++)
+  {
+    argKeys[i] = argNames[i];
+    body      += std::string(i ? "&" : "") + argNames[i] + "=value" + std::to_string(i);
+  }
+
+  for (int i = 0; i < HEADERS; i++)
+    headerLookups[i] = headerKeys[i];
+
+  for (int i = 0; i < MISSING; i++)
+  {
+    argKeys[ARGS + i]           = "missing" + String(i);
+    headerLookups[HEADERS + i]  = "X-Missing-" + String(i);
+  }
+
+  std::string request =
+    "POST /settings HTTP/1.1\r\n"
+    "Host: 192.168.2.100\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101 Firefox/115.0\r\n"
+    "Accept: text/html,application/xhtml+xml\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Referer: http://192.168.2.100/settings\r\n"
+    "Origin: http://192.168.2.100\r\n"
+    "Cookie: session=8f14e45f\r\n"
+    "Authorization: Basic YWRtaW46YWRtaW4=\r\n"
+    "X-Requested-With: XMLHttpRequest\r\n"
+    "Content-Type: application/x-www-form-urlencoded\r\n"
+    "Content-Length: " + std::to_string(body.size()) + "\r\n"
+    "\r\n" + body;
+
+  server.collectHeaders(headerKeys, HEADERS);
+  server.on("/settings", HTTP_POST, handleSettings);
+  server.begin();
+
+  HostResponse    response;
+  HostBenchResult result = hostBench(server, request, count, response);
+
+  CHECK_EQUAL(response.code, 200);
+
+  // Found, and not empty, for each argument and header
+  CHECK_EQUAL(lookupsFound, 2 * (ARGS + HEADERS));
+
+  int       lookups  = 2 * (ARGS + MISSING + HEADERS + MISSING);
+  double    repeated = (double) (REPEATS - 1) / REPEATS / count;
+
+  printf("%d arguments, %d collected headers: %d lookups %6.2f us, %5.1f ns/lookup, %5.1f allocations\n", ARGS,
+         HEADERS, lookups, lookupMicros / count / REPEATS, lookupMicros * 1000 / count / REPEATS / lookups,
+         (double) lookupAllocations / count / REPEATS);
+  printf("whole request, lookups once: %6.2f us, %5.1f allocations\n", result.micros - lookupMicros * repeated,
+         result.allocations - lookupAllocations * repeated);
+
+  return hostTestResult("LookupBench");
+}
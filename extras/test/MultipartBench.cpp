@@ -0,0 +1,130 @@
+/****************************************************************************************************************************
+  MultipartBench.cpp - Throughput of a file upload in a multipart/form-data post, and read() calls per MB, each an SPI
+  transaction on W5x00.
+
+  The file is 4 MB of random bytes, with CR LF, "--" and beginnings of the boundary spread in it, after a text field.
+  The upload handler checks the size and a checksum of what it gets. Only the API of the original library is used, so
+  that the benchmark also builds against it, see README.md, except with HTTP_UPLOAD_ZERO_COPY.
+  Usage: MultipartBench [uploads]
+
+  Licensed under MIT license
+ *****************************************************************************************************************************/
+
+#include <random>
+
+#include "HostTest.h"
+
+#ifndef HTTP_UPLOAD_ZERO_COPY
+  // Original library
+  #define HTTP_UPLOAD_ZERO_COPY   false
+#endif
+
+EthernetWebServer server(80);
+
+static const char     boundary[]  = "----WebKitFormBoundary7MA4YWxkTrZu0gW";
+static const size_t   FILE_SIZE   = 4 * 1024 * 1024;
+
+static std::string  file;
+
+// What the upload handler got of the last file
+static size_t       uploadSize;
+static uint32_t     uploadChecksum;
+static bool         uploadEnded;
+
+static uint32_t checksum(uint32_t hash, const uint8_t* data, size_t length)
+{
+  for (size_t i = 0; i < length; i++)
+    hash = (hash ^ data[i]) * 16777619UL;
+
+  return hash;
+}
+
+static void handleUpload()
+{
+  ethernetHTTPUpload& upload = server.upload();
+
+  if (upload.status == UPLOAD_FILE_START)
+  {
+    uploadSize      = 0;
+    uploadChecksum  = 2166136261UL;
+    uploadEnded     = false;
+  }
+  else if (upload.status == UPLOAD_FILE_WRITE)
+  {
+#if HTTP_UPLOAD_ZERO_COPY
+    uploadChecksum = checksum(uploadChecksum, upload.data, upload.currentSize);
+#else
+    uploadChecksum = checksum(uploadChecksum, upload.buf, upload.currentSize);
+#endif
+    uploadSize += upload.currentSize;
+  }
+  else if (upload.status == UPLOAD_FILE_END)
+  {
+    uploadEnded = (upload.totalSize == uploadSize);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned count = (argc > 1) ? atoi(argv[1]) : 3;
+
+  std::mt19937 random(1);
+
+  file.resize(FILE_SIZE);
+
+  for (char& c : file)
+    c = (char) random();
+
+  // What the boundary scanner stops on: CR LF, then "--", then more and more of the boundary, but never all of it
+  for (size_t pos = 1000; pos + 64 < FILE_SIZE; pos += 997)
+  {
+    std::string near = std::string("\r\n--") + std::string(boundary, random() % (sizeof(boundary) - 1)) + '\0';
+
+    file.replace(pos, near.size(), near);
+  }
+
+  CHECK(file.find(std::string("\r\n--") + boundary) == std::string::npos);
+
+  std::string body =
+    std::string("--") + boundary + "\r\n"
+    "Content-Disposition: form-data; name=\"description\"\r\n"
+    "\r\n"
+    "Firmware image\r\n"
+    "--" + boundary + "\r\n"
+    "Content-Disposition: form-data; name=\"firmware\"; filename=\"firmware.bin\"\r\n"
+    "Content-Type: application/octet-stream\r\n"
+    "\r\n" + file + "\r\n"
+    "--" + boundary + "--\r\n";
+
+  std::string request =
+    "POST /upload HTTP/1.1\r\n"
+    "Host: 192.168.2.100\r\n"
+    "Content-Type: multipart/form-data; boundary=" + std::string(boundary) + "\r\n"
+    "Content-Length: " + std::to_string(body.size()) + "\r\n"
+    "Connection: close\r\n"
+    "\r\n" + body;
+
+  server.on("/upload", HTTP_POST, []()
+  {
+    server.send(200, "text/plain", server.arg("description"));
+  }, handleUpload);
+
+  server.begin();
+
+  HostResponse    response;
+  HostBenchResult result = hostBench(server, request, count, response);
+
+  CHECK_EQUAL(response.code, 200);
+  CHECK_EQUAL(response.body, "Firmware image");
+  CHECK_EQUAL(uploadSize, FILE_SIZE);
+  CHECK(uploadEnded);
+  CHECK(uploadChecksum == checksum(2166136261UL, (const uint8_t*) file.data(), file.size()));
+
+  double megabytes = request.size() / 1e6;
+
+  printf("%u KB file%s: %7.1f MB/s %8.1f read() calls/MB %6.1f allocations\n", (unsigned) (FILE_SIZE / 1024),
+         HTTP_UPLOAD_ZERO_COPY ? ", zero copy" : "", megabytes / (result.micros / 1e6), result.reads / megabytes,
+         result.allocations);
+
+  return hostTestResult("MultipartBench");
+}
@@ -0,0 +1,103 @@
+/****************************************************************************************************************************
+  ParserBench.cpp - Requests per second and heap allocations per request of the request parser.
+
+  Each request comes on its own connection, closed by the server after the response, and is answered by a handler
+  reading two arguments and a header. Only the API of the original library is used, so that the benchmark also
+  builds against it, see README.md.
+  Usage: ParserBench [requests]
+
+  Licensed under MIT license
+ *****************************************************************************************************************************/
+
+#include "HostTest.h"
+
+EthernetWebServer server(80);
+
+static const char getRequest[] =
+  "GET /api/status?id=12&fmt=json HTTP/1.1\r\n"
+  "Host: 192.168.2.100\r\n"
+  "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101 Firefox/115.0\r\n"
+  "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+  "Accept-Language: en-US,en;q=0.5\r\n"
+  "Accept-Encoding: gzip, deflate\r\n"
+  "Referer: http://192.168.2.100/\r\n"
+  "Connection: close\r\n"
+  "Upgrade-Insecure-Requests: 1\r\n"
+  "\r\n";
+
+static const char postRequest[] =
+  "POST /api/settings HTTP/1.1\r\n"
+  "Host: 192.168.2.100\r\n"
+  "User-Agent: curl/7.81.0\r\n"
+  "Accept: */*\r\n"
+  "Content-Type: application/x-www-form-urlencoded\r\n"
+  "Content-Length: 73\r\n"
+  "Connection: close\r\n"
+  "\r\n"
+  "ssid=Office+Network&password=s3cr%21t&ip=192.168.2.100&mask=255.255.255.0";
+
+static void bench(const char* name, const char* request, unsigned count)
+{
+  // Warm up, and check the answer
+  HostResponse response = hostResponse(server, request);
+
+  CHECK_EQUAL(response.code, 200);
+  CHECK_EQUAL(response.body, "{\"ok\":1}");
+
+  std::string input(request);
+  uint64_t    allocations = 0;
+  double      micros      = 0;
+
+  for (unsigned i = 0; i < count; i++)
+  {
+    // The connection and its output buffer are allocated outside the measurement
+    MockConnectionPtr connection = MockNetwork::connect(input);
+
+    connection->output.reserve(512);
+
+    uint64_t  start = MockHeap::allocations;
+    HostTimer timer;
+
+    hostServe(server, connection);
+
+    micros      += timer.micros();
+    allocations += MockHeap::allocations - start;
+
+    hostClose(server, connection);
+  }
+
+  printf("%-28s %8.2f us/request %10.0f requests/s %8.1f allocations/request\n", name, micros / count,
+         count * 1e6 / micros, (double) allocations / count);
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned count = (argc > 1) ? atoi(argv[1]) : 20000;
+
+  static const char* headerKeys[] = { "User-Agent", "Referer" };
+
+  server.collectHeaders(headerKeys, 2);
+
+  server.on("/api/status", []()
+  {
+    if ( (server.arg("id") == "12") && (server.arg("fmt") == "json") && (server.header("User-Agent").length() > 10) )
+      server.send(200, "application/json", "{\"ok\":1}");
+    else
+      server.send(400, "text/plain", "Bad arguments");
+  });
+
+  server.on("/api/settings", HTTP_POST, []()
+  {
+    if ( (server.arg("ssid") == "Office Network") && (server.arg("password") == "s3cr!t") && (server.args() >= 4) )
+      server.send(200, "application/json", "{\"ok\":1}");
+    else
+      server.send(400, "text/plain", "Bad arguments");
+  });
+
+  server.begin();
+
+  bench("GET, 8 headers, 2 args", getRequest, count);
+  bench("POST, urlencoded, 4 args", postRequest, count);
+
+  return hostTestResult("ParserBench");
+}
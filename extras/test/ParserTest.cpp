@@ -0,0 +1,643 @@
+/****************************************************************************************************************************
+  ParserTest.cpp - Correctness of the request parser: request line, query, headers, bodies, Content-Length and
+  chunked bodies, Expect: 100-continue, multipart fields, bodies streamed to onBody(), with requests received at
+  once or a byte at a time, and the headers framing their responses.
+
+  Built twice, the second time with HTTP_REQUEST_ARENA_FALLBACK 0 to check the bodies the arena can't hold.
+
+  Licensed under MIT license
+ *****************************************************************************************************************************/
+
+#include "HostTest.h"
+
+EthernetWebServer server(80);
+
+// What the handler saw of the last request. As before, a query field without "=", such as flag, is dropped
+static std::string  seen;
+static int          handled = 0;
+
+static const char getRequest[] =
+  "GET /path/item?a=1&b=two%20words&empty=&flag HTTP/1.1\r\n"
+  "Host: 192.168.2.100\r\n"
+  "Accept: */*\r\n"
+  "X-Token:   abc123  \r\n"
+  "Connection: close\r\n"
+  "\r\n";
+
+static const char getSeen[] =
+  "GET /path/item args=3 a=1 b=two words empty= host=192.168.2.100 token=abc123 headers=2 accept=0";
+
+////////////////////////////////////////
+
+static void recordRequest()
+{
+  handled++;
+
+  seen = (server.method() == HTTP_GET) ? "GET " : (server.method() == HTTP_POST) ? "POST " : "OTHER ";
+  seen += server.uri() + " args=" + String(server.args());
+
+  for (int i = 0; i < server.args(); i++)
+    seen += " " + server.argName(i) + "=" + server.arg(i);
+
+  seen += " host=" + server.hostHeader();
+  seen += " token=" + server.header("X-Token");
+  seen += " headers=" + std::to_string(server.headers());
+  seen += " accept=" + std::to_string(server.hasHeader("Accept"));
+
+  server.send(200, "text/plain", "ok");
+}
+
+////////////////////////////////////////
+
+static void testRequestLineAndHeaders()
+{
+  seen.clear();
+
+  HostResponse response = hostResponse(server, getRequest);
+
+  CHECK_EQUAL(response.code, 200);
+  CHECK_EQUAL(response.body, "ok");
+  CHECK_EQUAL(response.header("Connection"), "close");
+  CHECK_EQUAL(seen, getSeen);
+}
+
+// The parser resumes where it stopped when the rest of the request arrives
+static void testByteByByte()
+{
+  seen.clear();
+
+  MockConnectionPtr connection = MockNetwork::connect(getRequest, 0);
+
+  for (size_t i = 0; i < sizeof(getRequest); i++)
+  {
+    server.handleClient();
+    connection->receive(1);
+  }
+
+  hostServe(server, connection);
+  hostClose(server, connection);
+
+  HostResponse response;
+
+  CHECK(hostParseResponse(connection->output, response) == connection->output.size());
+  CHECK_EQUAL(response.code, 200);
+  CHECK_EQUAL(seen, getSeen);
+}
+
+static void testInvalidRequests()
+{
+  int before = handled;
+
+  // No URI
+  MockConnectionPtr connection = MockNetwork::connect("GARBAGE\r\n\r\n");
+
+  hostServe(server, connection);
+
+  CHECK(connection->stopped);
+  CHECK_EQUAL(connection->output, "");
+
+  // Request line longer than the buffer
+  connection = MockNetwork::connect("GET /" + std::string(HTTP_REQUEST_BUFLEN, 'x') + " HTTP/1.1\r\n\r\n");
+
+  hostServe(server, connection);
+
+  CHECK(connection->stopped);
+
+  CHECK_EQUAL(handled, before);
+}
+
+static void testUrlencodedBody()
+{
+  seen.clear();
+
+  std::string body = "ssid=Office+Network&password=s3cr%21t";
+
+  HostResponse response = hostResponse(server,
+                                       "POST /form?id=7 HTTP/1.1\r\n"
+                                       "Content-Type: application/x-www-form-urlencoded\r\n"
+                                       "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                                       "\r\n" + body);
+
+  CHECK_EQUAL(response.code, 200);
+  CHECK_EQUAL(seen, "POST /form args=4 id=7 ssid=Office Network password=s3cr!t plain=" + body +
+              " host= token= headers=2 accept=0");
+}
+
+// The code of the response to a POST with this Content-Length, and as many body bytes if there's room for them
+static int postWithLength(const std::string& length, size_t bodyLength = 5)
+{
+  return hostResponse(server, "POST /form HTTP/1.1\r\nContent-Length: " + length + "\r\n\r\n" +
+                      std::string(bodyLength, 'x')).code;
+}
+
+static void testContentLength()
+{
+  CHECK_EQUAL(postWithLength("5"), 200);
+  CHECK_EQUAL(postWithLength("0", 0), 200);
+
+  // Not a number, or more than 32 bits
+  CHECK_EQUAL(postWithLength(""), 400);
+  CHECK_EQUAL(postWithLength("abc"), 400);
+  CHECK_EQUAL(postWithLength("-1"), 400);
+  CHECK_EQUAL(postWithLength("+5"), 400);
+  CHECK_EQUAL(postWithLength("5x"), 400);
+  CHECK_EQUAL(postWithLength("0x5"), 400);
+  CHECK_EQUAL(postWithLength("4294967296"), 400);
+  CHECK_EQUAL(postWithLength("99999999999999999999"), 400);
+  CHECK_EQUAL(postWithLength("18446744073709551615"), 400);
+
+  // Also for a GET, whose body would be skipped
+  CHECK_EQUAL(hostResponse(server, "GET /form HTTP/1.1\r\nContent-Length: -1\r\n\r\n").code, 400);
+
+#if HTTP_REQUEST_ARENA_FALLBACK
+  // Beyond the arena, from the heap
+  CHECK_EQUAL(postWithLength("100000", 100000), 200);
+#else
+  // Beyond the arena, rejected before the body is read. 4294967295 + 1 used to wrap to 0
+  CHECK_EQUAL(postWithLength(std::to_string(HTTP_REQUEST_ARENA_SIZE)), 413);
+  CHECK_EQUAL(postWithLength("4294967295"), 413);
+#endif
+
+  server.setMaxBodyLength(1000);
+  CHECK_EQUAL(postWithLength("1001"), 413);
+  server.setMaxBodyLength(0);
+}
+
+// A multipart field of many lines, longer than the arena. Each line used to leave a copy of the value on the heap,
+// it now moves once to the heap and grows there. Without fallback, the value is cut where the arena is full
+static void testMultipartValue()
+{
+  std::string value;
+
+  for (int i = 0; i < 1000; i++)
+    value += std::string(i ? "\n" : "") + "line " + std::to_string(i) + std::string(56, '.');
+
+  std::string lines = value;
+
+  for (size_t pos = 0; (pos = lines.find('\n', pos)) != std::string::npos; pos += 2)
+    lines.replace(pos, 1, "\r\n");
+
+  std::string body = "--XyZ\r\nContent-Disposition: form-data; name=\"notes\"\r\n\r\n" + lines + "\r\n--XyZ--\r\n";
+
+  server.resetArenaStats();
+  seen.clear();
+
+  HostResponse response = hostResponse(server,
+                                       "POST /notes HTTP/1.1\r\n"
+                                       "Content-Type: multipart/form-data; boundary=XyZ\r\n"
+                                       "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                                       "\r\n" + body);
+
+  CHECK_EQUAL(response.code, 200);
+
+#if HTTP_REQUEST_ARENA_FALLBACK
+  CHECK(seen == value);
+  CHECK_EQUAL(server.arenaStats().heapAllocs, 1);
+  CHECK_EQUAL(server.arenaStats().failures, 0);
+  CHECK(server.arenaStats().heapHighWater < 2 * value.size());
+#else
+  CHECK(seen.size() < HTTP_REQUEST_ARENA_SIZE);
+  CHECK(seen == value.substr(0, seen.size()));
+  CHECK(server.arenaStats().failures > 0);
+#endif
+}
+
+// An urlencoded field in a chunked body longer than the arena, the body growing a chunk at a time. It moves once to
+// the heap, then its decoded value. Without fallback, the request is rejected
+static void testChunkedFormValue()
+{
+  std::string value(3 * HTTP_REQUEST_ARENA_SIZE, 'v');
+  std::string body = "ssid=" + value;
+  std::string chunks;
+
+  for (size_t pos = 0; pos < body.size(); pos += 100)
+  {
+    std::string chunk = body.substr(pos, 100);
+    char        size[8];
+
+    snprintf(size, sizeof(size), "%zx", chunk.size());
+    chunks += std::string(size) + "\r\n" + chunk + "\r\n";
+  }
+
+  server.resetArenaStats();
+  seen.clear();
+
+  HostResponse response = hostResponse(server,
+                                       "POST /form HTTP/1.1\r\n"
+                                       "Content-Type: application/x-www-form-urlencoded\r\n"
+                                       "Transfer-Encoding: chunked\r\n"
+                                       "\r\n" + chunks + "0\r\n\r\n");
+
+#if HTTP_REQUEST_ARENA_FALLBACK
+  CHECK_EQUAL(response.code, 200);
+  CHECK(seen.find(" ssid=" + value + " plain=" + body + " ") != std::string::npos);
+  CHECK_EQUAL(server.arenaStats().heapAllocs, 2);
+  CHECK_EQUAL(server.arenaStats().failures, 0);
+#else
+  CHECK_EQUAL(response.code, 413);
+  CHECK_EQUAL(seen, "");
+#endif
+}
+
+// Requests sent back to back on one connection get their responses in order
+static void testPipelined()
+{
+  std::string output = hostRequest(server,
+                                   "GET /path/item?a=1 HTTP/1.1\r\n\r\n"
+                                   "POST /form HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc"
+                                   "GET /path/item?a=3 HTTP/1.1\r\nConnection: close\r\n\r\n");
+  HostResponse response;
+  size_t       pos = 0;
+
+  for (int i = 0; i < 3; i++)
+  {
+    size_t length = hostParseResponse(output.substr(pos), response);
+
+    CHECK(length > 0);
+    CHECK_EQUAL(response.code, 200);
+    CHECK_EQUAL(response.header("Connection"), (i < 2) ? "keep-alive" : "close");
+
+    pos += length;
+  }
+
+  CHECK_EQUAL(pos, output.size());
+}
+
+static const std::string chunkedPost =
+  "POST /form HTTP/1.1\r\n"
+  "Content-Type: application/x-www-form-urlencoded\r\n"
+  "Transfer-Encoding: chunked\r\n"
+  "\r\n";
+
+// A chunked body is decoded in place, its extensions and trailers dropped. The request after it on the same
+// connection is parsed from where the body ended
+static void testChunkedBody()
+{
+  std::string body =
+    "4;name=value\r\na=1&\r\n"
+    "5 ; last\r\nb=two\r\n"
+    "0\r\n"
+    "X-Checksum: 1234\r\n"
+    "\r\n";
+
+  seen.clear();
+
+  HostResponse response = hostResponse(server, chunkedPost + body);
+
+  CHECK_EQUAL(response.code, 200);
+  CHECK_EQUAL(response.header("Connection"), "keep-alive");
+  CHECK_EQUAL(seen, "POST /form args=3 a=1 b=two plain=a=1&b=two host= token= headers=2 accept=0");
+
+  std::string output = hostRequest(server, chunkedPost + body +
+                                   "GET /path/item?a=3 HTTP/1.1\r\nConnection: close\r\n\r\n");
+  size_t      length = hostParseResponse(output, response);
+
+  CHECK(length > 0);
+  CHECK_EQUAL(response.code, 200);
+
+  hostParseResponse(output.substr(length), response);
+
+  CHECK_EQUAL(response.code, 200);
+  CHECK_EQUAL(seen, "GET /path/item args=1 a=3 host= token= headers=2 accept=0");
+}
+
+// Each size line and CRLF split across reads, the parser resuming in the middle of them
+static void testChunkedByteByByte()
+{
+  seen.clear();
+
+  std::string request = chunkedPost + "9;x=y\r\nssid=home\r\n0\r\n\r\n";
+
+  MockConnectionPtr connection = MockNetwork::connect(request, 0);
+
+  for (size_t i = 0; i < request.size(); i++)
+  {
+    server.handleClient();
+    connection->receive(1);
+  }
+
+  hostServe(server, connection);
+  hostClose(server, connection);
+
+  HostResponse response;
+
+  CHECK(hostParseResponse(connection->output, response) == connection->output.size());
+  CHECK_EQUAL(response.code, 200);
+  CHECK_EQUAL(seen, "POST /form args=2 ssid=home plain=ssid=home host= token= headers=2 accept=0");
+}
+
+// Return the connection of a chunked post of this body, once the server is done with it
+static MockConnectionPtr chunkedWith(const std::string& body, const char* transferEncoding = "chunked")
+{
+  MockConnectionPtr connection = MockNetwork::connect("POST /form HTTP/1.1\r\n"
+                                                      "Transfer-Encoding: " + std::string(transferEncoding) + "\r\n"
+                                                      "\r\n" + body);
+
+  hostServe(server, connection);
+  hostClose(server, connection);
+
+  return connection;
+}
+
+// The connection of an invalid chunked body is closed, as where the next request starts isn't known
+static void testInvalidChunks()
+{
+  int          before = handled;
+  HostResponse response;
+
+  // Not a hex size
+  MockConnectionPtr connection = chunkedWith("zz\r\nabc\r\n0\r\n\r\n");
+
+  CHECK(connection->stopped);
+  CHECK_EQUAL(connection->output, "");
+
+  // Size too large for 32 bits
+  connection = chunkedWith("100000000\r\n");
+
+  CHECK(connection->stopped);
+  CHECK_EQUAL(connection->output, "");
+
+  // No CRLF after the data
+  connection = chunkedWith("3\r\nabcd\r\n0\r\n\r\n");
+
+  CHECK(connection->stopped);
+  CHECK_EQUAL(connection->output, "");
+
+  // Size line, with its extensions, longer than HTTP_CHUNK_LINE_LEN
+  connection = chunkedWith("3;" + std::string(HTTP_CHUNK_LINE_LEN, 'x') + "\r\nabc\r\n0\r\n\r\n");
+
+  CHECK(connection->stopped);
+  CHECK_EQUAL(connection->output, "");
+
+  CHECK_EQUAL(handled, before);
+
+  // Body longer than setMaxBodyLength(), whatever its chunks
+  server.setMaxBodyLength(8);
+  connection = chunkedWith("5\r\nabcde\r\n5\r\nfghij\r\n0\r\n\r\n");
+  server.setMaxBodyLength(0);
+
+  hostParseResponse(connection->output, response);
+
+  CHECK_EQUAL(response.code, 413);
+  CHECK_EQUAL(response.header("Connection"), "close");
+
+  // Other transfer codings aren't decoded
+  connection = chunkedWith("3\r\nabc\r\n0\r\n\r\n", "gzip, chunked");
+
+  hostParseResponse(connection->output, response);
+
+  CHECK_EQUAL(response.code, 501);
+  CHECK_EQUAL(response.header("Connection"), "close");
+
+  CHECK_EQUAL(handled, before);
+}
+
+// Send a post of body with "Expect: 100-continue" and these headers, the body only once the server had time to
+// answer the headers. Return what the server sent before the body arrived in interim, and after in output
+static void postExpecting(const std::string& headers, const std::string& body, std::string& interim,
+                          std::string& output, const char* version = "HTTP/1.1")
+{
+  std::string head = "POST /form " + std::string(version) + "\r\n"
+                     "Expect: 100-continue\r\n"
+                     "Content-Length: " + std::to_string(body.size()) + "\r\n" + headers + "\r\n";
+
+  MockConnectionPtr connection = MockNetwork::connect(head + body, head.size());
+
+  for (int i = 0; i < 100; i++)
+    server.handleClient();
+
+  interim = connection->output;
+  connection->received = SIZE_MAX;
+
+  hostServe(server, connection);
+  hostClose(server, connection);
+
+  output = connection->output.substr(interim.size());
+}
+
+static void testExpectContinue()
+{
+  std::string   interim;
+  std::string   output;
+  HostResponse  response;
+  int           before = handled;
+
+  // The client waits for 100 Continue before sending the body, then gets the response
+  postExpecting("", "a=1", interim, output);
+
+  CHECK_EQUAL(interim, "HTTP/1.1 100 Continue\r\n\r\n");
+  CHECK(hostParseResponse(output, response) > 0);
+  CHECK_EQUAL(response.code, 200);
+  CHECK_EQUAL(handled, before + 1);
+
+  // HTTP/1.0 clients don't know 100 Continue
+  postExpecting("", "a=1", interim, output, "HTTP/1.0");
+
+  CHECK_EQUAL(interim, "");
+  CHECK(hostParseResponse(output, response) > 0);
+  CHECK_EQUAL(response.code, 200);
+  CHECK_EQUAL(handled, before + 2);
+
+  // Another expectation can't be met
+  postExpecting("Expect: 200-ok\r\n", "a=1", interim, output);
+
+  hostParseResponse(interim, response);
+
+  CHECK_EQUAL(response.code, 417);
+  CHECK_EQUAL(response.header("Connection"), "close");
+
+  // A body too large is refused before the client sends it
+  server.setMaxBodyLength(2);
+  postExpecting("", "a=1", interim, output);
+  server.setMaxBodyLength(0);
+
+  hostParseResponse(interim, response);
+
+  CHECK_EQUAL(response.code, 413);
+  CHECK_EQUAL(response.header("Connection"), "close");
+
+  // The handler set with onExpectContinue() sees the headers, and may answer instead of the route
+  server.onExpectContinue([]()
+  {
+    if (server.header("X-Token") != "secret")
+      server.send(401, "text/plain", "Unauthorized");
+  });
+
+  postExpecting("X-Token: wrong\r\n", "a=1", interim, output);
+
+  hostParseResponse(interim, response);
+
+  CHECK_EQUAL(response.code, 401);
+  CHECK_EQUAL(response.header("Connection"), "close");
+  CHECK_EQUAL(response.body, "Unauthorized");
+  CHECK_EQUAL(handled, before + 2);
+
+  postExpecting("X-Token: secret\r\n", "a=1", interim, output);
+
+  CHECK_EQUAL(interim, "HTTP/1.1 100 Continue\r\n\r\n");
+  CHECK(hostParseResponse(output, response) > 0);
+  CHECK_EQUAL(response.code, 200);
+  CHECK_EQUAL(handled, before + 3);
+
+  server.onExpectContinue(nullptr);
+}
+
+// Events of the body handler of /stream: "start <contentLength> <type>", "write <size>", "end <total>" or
+// "aborted <total>", then "handled" when the request handler is called
+static std::string events;
+
+static void recordBody()
+{
+  const ethernetHTTPBody& body = server.body();
+
+  events += events.empty() ? "" : ", ";
+
+  if (body.status == BODY_START)
+    events += "start " + std::to_string(body.contentLength) + " " + body.contentType;
+  else if (body.status == BODY_WRITE)
+    events += "write " + std::string((const char *) body.data, body.currentSize);
+  else if (body.status == BODY_END)
+    events += "end " + std::to_string(body.totalSize);
+  else if (body.status == BODY_ABORTED)
+    events += "aborted " + std::to_string(body.totalSize);
+}
+
+// Post body to /stream, sent a piece of pieceLength bytes between calls of handleClient(), and the connection
+// closed by the client once sent bytes are. Return the connection
+static MockConnectionPtr postStream(const std::string& body, size_t pieceLength, size_t sent = SIZE_MAX)
+{
+  std::string head = "POST /stream HTTP/1.1\r\n"
+                     "Content-Type: application/octet-stream\r\n"
+                     "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                     "\r\n";
+
+  events.clear();
+
+  MockConnectionPtr connection = MockNetwork::connect(head + body, head.size());
+
+  if (sent > body.size())
+    sent = body.size();
+
+  for (size_t pos = 0; pos < sent; pos += pieceLength)
+  {
+    server.handleClient();
+    connection->receive((sent - pos < pieceLength) ? sent - pos : pieceLength);
+  }
+
+  hostServe(server, connection);
+  hostClose(server, connection);
+
+  return connection;
+}
+
+static void testBodyStream()
+{
+  HostResponse response;
+
+  // In the pieces it arrives in, in the request buffer
+  MockConnectionPtr connection = postStream("0123456789abcdefghij", 7);
+
+  hostParseResponse(connection->output, response);
+
+  CHECK_EQUAL(response.code, 200);
+  CHECK_EQUAL(events, "start 20 application/octet-stream, write 0123456, write 789abcd, write efghij, end 20, "
+              "handled");
+
+  // Empty
+  connection = postStream("", 1);
+
+  hostParseResponse(connection->output, response);
+
+  CHECK_EQUAL(response.code, 200);
+  CHECK_EQUAL(events, "start 0 application/octet-stream, end 0, handled");
+
+  // The client gone before the end, the request handler isn't called
+  connection = postStream("0123456789abcdefghij", 4, 8);
+
+  CHECK(connection->stopped);
+  CHECK_EQUAL(connection->output, "");
+  CHECK_EQUAL(events, "start 20 application/octet-stream, write 0123, write 4567, aborted 8");
+
+  // Larger than setMaxBodyLength(), refused before its body is read
+  server.setMaxBodyLength(10);
+  connection = postStream("0123456789abcdefghij", 20);
+  server.setMaxBodyLength(0);
+
+  hostParseResponse(connection->output, response);
+
+  CHECK_EQUAL(response.code, 413);
+  CHECK_EQUAL(response.header("Connection"), "close");
+  CHECK(connection->stopped);
+  CHECK_EQUAL(events, "");
+}
+
+// Headers set with sendHeader() until the buffer is full leave room for those framing the response, so that a
+// chunked response on a kept-alive connection still ends where the next one starts
+static void testFramingHeaders()
+{
+  std::string output = hostRequest(server,
+                                   "GET /headers HTTP/1.1\r\n\r\n"
+                                   "GET /path/item?a=1 HTTP/1.1\r\nConnection: close\r\n\r\n");
+  HostResponse response;
+  size_t       length = hostParseResponse(output, response);
+
+  CHECK(length > 0);
+  CHECK_EQUAL(response.code, 200);
+  CHECK_EQUAL(response.header("Transfer-Encoding"), "chunked");
+  CHECK_EQUAL(response.header("Connection"), "keep-alive");
+  CHECK_EQUAL(response.body, "abcdef");
+  CHECK(response.hasHeader("X-Header-0"));
+  CHECK(!response.hasHeader("X-Header-11"));
+
+  hostParseResponse(output.substr(length), response);
+
+  CHECK_EQUAL(response.code, 200);
+  CHECK_EQUAL(response.header("Connection"), "close");
+}
+
+int main()
+{
+  static const char* headerKeys[] = { "X-Token" };
+
+  server.collectHeaders(headerKeys, 1);
+  server.on("/path/item", recordRequest);
+  server.on("/form", HTTP_POST, recordRequest);
+  server.on("/notes", HTTP_POST, []()
+  {
+    seen = server.arg("notes");
+    server.send(200, "text/plain", "ok");
+  });
+  server.onBody("/stream", HTTP_POST, []()
+  {
+    events += ", handled";
+    server.send(200, "text/plain", "ok");
+  }, recordBody);
+  server.on("/headers", []()
+  {
+    for (int i = 0; i < 12; i++)
+      server.sendHeader("X-Header-" + String(i), std::string(30, 'x').c_str());
+
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "text/plain", "abc");
+    server.sendContent("def");
+    server.sendContent("");
+  });
+  server.begin();
+
+  testRequestLineAndHeaders();
+  testByteByByte();
+  testInvalidRequests();
+  testUrlencodedBody();
+  testContentLength();
+  testMultipartValue();
+  testChunkedFormValue();
+  testPipelined();
+  testFramingHeaders();
+  testChunkedBody();
+  testChunkedByteByByte();
+  testInvalidChunks();
+  testExpectContinue();
+  testBodyStream();
+
+  return hostTestResult("ParserTest");
+}
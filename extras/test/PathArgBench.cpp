@@ -0,0 +1,83 @@
+/****************************************************************************************************************************
+  PathArgBench.cpp - Time and heap allocations per request of a route capturing path segments with {name}, against a
+  wildcard route, "/old/sensor/" then "*", whose handler takes the segments out of uri() itself.
+
+  Both routes come after 16 others, and both handlers answer with the segments they got. The URI of the request is
+  kept in a String, which allocates for both.
+  Usage: PathArgBench [requests]
+
+  Licensed under MIT license
+ *****************************************************************************************************************************/
+
+#include "HostTest.h"
+
+EthernetWebServer server(80);
+
+static void bench(const char* name, const char* uri, const char* expected, unsigned count)
+{
+  HostResponse    response;
+  HostBenchResult result = hostBench(server, std::string("GET ") + uri + " HTTP/1.1\r\n\r\n", count, response);
+
+  CHECK_EQUAL(response.code, 200);
+  CHECK_EQUAL(response.body, expected);
+
+  printf("%-34s %7.2f us/request %6.1f allocations/request\n", name, result.micros, result.allocations);
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned count = (argc > 1) ? atoi(argv[1]) : 50000;
+
+  static String pages[16];
+
+  for (int i = 0; i < 16; i++)
+  {
+    pages[i] = "/page" + String(i);
+
+    server.on(pages[i], []()
+    {
+      server.send(200, "text/plain", "page");
+    });
+  }
+
+  server.on("/api/sensor/{id}/value", HTTP_GET, []()
+  {
+    server.send(200, "text/plain", server.pathArg("id"));
+  });
+
+  server.on("/api/sensor/{id}/history/{day}", HTTP_GET, []()
+  {
+    char reply[64];
+
+    strcpy(reply, server.pathArg("id"));
+    strcat(reply, " ");
+    strcat(reply, server.pathArg("day"));
+    server.send(200, "text/plain", reply);
+  });
+
+  // The same two routes, parsed by hand
+  server.on("/old/sensor/*", HTTP_GET, []()
+  {
+    const String& uri    = server.uri();
+    int           start  = strlen("/old/sensor/");
+    int           slash  = uri.indexOf('/', start);
+    String        id     = uri.substring(start, slash);
+    String        rest   = uri.substring(slash + 1);
+
+    if (rest == "value")
+      server.send(200, "text/plain", id);
+    else if (rest.startsWith("history/"))
+      server.send(200, "text/plain", id + " " + rest.substring(strlen("history/")));
+    else
+      server.send(404, "text/plain", "Not found");
+  });
+
+  server.begin();
+
+  bench("{id}", "/api/sensor/42/value", "42", count);
+  bench("/* and substring()", "/old/sensor/42/value", "42", count);
+  bench("{id} and {day}", "/api/sensor/42/history/2022-11-15", "42 2022-11-15", count);
+  bench("/* and substring(), 2 segments", "/old/sensor/42/history/2022-11-15", "42 2022-11-15", count);
+
+  return hostTestResult("PathArgBench");
+}
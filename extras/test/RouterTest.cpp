@@ -0,0 +1,298 @@
+/****************************************************************************************************************************
+  RouterTest.cpp - Correctness of the router: whatever the order routes are added in, static, "{name}" and wildcard
+  ones and handlers without route URI, the first added accepting the request wins, as when every handler was asked
+  canHandle() in turn. Routes added after begin() are found too. Routes of a table in flash come first, matched by
+  their methods and URI.
+
+  Licensed under MIT license
+ *****************************************************************************************************************************/
+
+#include <algorithm>
+#include <vector>
+
+#include "HostTest.h"
+
+// Handler without route URI, for the URIs containing text, whatever the method
+class ContainsHandler : public ethernetRequestHandler
+{
+  public:
+
+    ContainsHandler(const char* text) : _text(text) {}
+
+    bool canHandle(const HTTPMethod& method, const String& uri) override
+    {
+      ETW_UNUSED(method);
+
+      return uri.indexOf(_text) >= 0;
+    }
+
+    bool handle(EthernetWebServer& server, const HTTPMethod& method, const String& uri) override
+    {
+      if (!canHandle(method, uri))
+        return false;
+
+      server.send(200, "text/plain", "contains");
+
+      return true;
+    }
+
+  private:
+
+    const char* _text;
+};
+
+struct Route
+{
+  const char* name;
+  const char* uri;          // nullptr for a ContainsHandler
+  HTTPMethod  method;
+};
+
+static const Route routes[] =
+{
+  { "status",   "/api/status",        HTTP_GET  },
+  { "id",       "/api/{id}",          HTTP_ANY  },
+  { "prefix",   "/api/*",             HTTP_ANY  },
+  { "value",    "/api/{id}/value",    HTTP_POST },
+  { "contains", nullptr,              HTTP_ANY  }
+};
+
+static const int ROUTES = sizeof(routes) / sizeof(routes[0]);
+
+static const char* uris[] =
+{
+  "/api/status", "/api/7", "/api/7/value", "/api/status/value", "/api/", "/api", "/apix", "/other", "/"
+};
+
+static EthernetWebServer* server;
+
+// What the route answers: its name, then its path arguments
+static void answer(const char* name)
+{
+  String reply = name;
+
+  for (int i = 0; i < server->pathArgs(); i++)
+    reply += " " + String(server->pathArg(i));
+
+  server->send(200, "text/plain", reply);
+}
+
+// The answer expected for the routes added in order: the first accepting the request, as the handler list does
+static std::string expected(const std::vector<int>& order, HTTPMethod method, const char* uri)
+{
+  for (int i : order)
+  {
+    const Route& route = routes[i];
+
+    if (!route.uri)
+    {
+      if (strstr(uri, "value"))
+        return "contains";
+
+      continue;
+    }
+
+    if ( (route.method != HTTP_ANY) && (route.method != method) )
+      continue;
+
+    ethernetHTTPView args[HTTP_MAX_PATH_ARGS];
+    int count = ethernetMatchRoute(route.uri, uri, args, HTTP_MAX_PATH_ARGS);
+
+    if (count < 0)
+      continue;
+
+    std::string reply = route.name;
+
+    for (int arg = 0; arg < count; arg++)
+      reply += " " + std::string(uri + args[arg].offset, args[arg].length);
+
+    return reply;
+  }
+
+  return "";
+}
+
+// Every order of the routes, every request
+static void testPrecedence()
+{
+  std::vector<int> order;
+
+  for (int i = 0; i < ROUTES; i++)
+    order.push_back(i);
+
+  int orders = 0;
+
+  do
+  {
+    EthernetWebServer orderServer(80);
+
+    server = &orderServer;
+
+    for (int i : order)
+    {
+      const Route& route = routes[i];
+
+      if (!route.uri)
+      {
+        orderServer.addHandler(new ContainsHandler("value"));
+
+        continue;
+      }
+
+      orderServer.on(route.uri, route.method, [&route]()
+      {
+        answer(route.name);
+      });
+    }
+
+    orderServer.begin();
+
+    for (HTTPMethod method : { HTTP_GET, HTTP_POST })
+    {
+      for (const char* uri : uris)
+      {
+        HostResponse response = hostResponse(orderServer, std::string((method == HTTP_GET) ? "GET " : "POST ") +
+                                             uri + " HTTP/1.1\r\nContent-Length: 0\r\n\r\n");
+        std::string  reply    = expected(order, method, uri);
+
+        CHECK_EQUAL(response.code, reply.empty() ? 404 : 200);
+
+        if (!reply.empty())
+          CHECK_EQUAL(response.body, reply);
+      }
+    }
+
+    orders++;
+  } while (std::next_permutation(order.begin(), order.end()));
+
+  CHECK_EQUAL(orders, 120);
+
+  server = nullptr;
+}
+
+// The tree is built on the first request, and again on the next after a route is added
+static void testAddedAfterBegin()
+{
+  EthernetWebServer lateServer(80);
+
+  server = &lateServer;
+
+  lateServer.on("/api/{id}", HTTP_GET, []()
+  {
+    answer("id");
+  });
+
+  lateServer.begin();
+
+  CHECK_EQUAL(hostResponse(lateServer, "GET /api/status HTTP/1.1\r\n\r\n").body, "id status");
+  CHECK_EQUAL(hostResponse(lateServer, "GET /late HTTP/1.1\r\n\r\n").code, 404);
+
+  lateServer.on("/late", HTTP_GET, []()
+  {
+    answer("late");
+  });
+
+  // Added later, it still comes after "{id}"
+  lateServer.on("/api/status", HTTP_GET, []()
+  {
+    answer("status");
+  });
+
+  CHECK_EQUAL(hostResponse(lateServer, "GET /late HTTP/1.1\r\n\r\n").body, "late");
+  CHECK_EQUAL(hostResponse(lateServer, "GET /api/status HTTP/1.1\r\n\r\n").body, "id status");
+
+  lateServer.addHandler(new ContainsHandler("late"));
+
+  CHECK_EQUAL(hostResponse(lateServer, "GET /late HTTP/1.1\r\n\r\n").body, "late");
+  CHECK_EQUAL(hostResponse(lateServer, "GET /later/x HTTP/1.1\r\n\r\n").body, "contains");
+
+  server = nullptr;
+}
+
+// Route table kept in flash, matched in order before the handlers added with on()
+static void tableLed()
+{
+  answer("table led");
+}
+
+static void tablePost()
+{
+  answer("table post");
+}
+
+static void tableFiles()
+{
+  answer("table files");
+}
+
+static const char tableUriLed[]   PROGMEM = "/led/{state}";
+static const char tableUriPost[]  PROGMEM = "/api/{id}";
+static const char tableUriFiles[] PROGMEM = "/files/*";
+
+static const ethernetRoute table[] PROGMEM =
+{
+  { tableUriLed,    ETHERNET_ROUTE_METHOD(HTTP_GET) | ETHERNET_ROUTE_METHOD(HTTP_PUT),  tableLed,   nullptr },
+  { tableUriPost,   ETHERNET_ROUTE_METHOD(HTTP_POST),                                   tablePost,  nullptr },
+  { tableUriFiles,  ETHERNET_ROUTE_METHOD(HTTP_ANY),                                    tableFiles, nullptr }
+};
+
+static std::string tableAnswer(EthernetWebServer& tableServer, const char* method, const char* uri)
+{
+  HostResponse response = hostResponse(tableServer, std::string(method) + " " + uri +
+                                       " HTTP/1.1\r\nContent-Length: 0\r\n\r\n");
+
+  return (response.code == 200) ? response.body : std::to_string(response.code);
+}
+
+static void testRouteTable()
+{
+  EthernetWebServer tableServer(80);
+
+  server = &tableServer;
+
+  // Added before the table, still matched after it
+  tableServer.on("/api/{id}", HTTP_ANY, []()
+  {
+    answer("id");
+  });
+
+  tableServer.on("/led/*", HTTP_ANY, []()
+  {
+    answer("led prefix");
+  });
+
+  tableServer.setRouteTable(table, sizeof(table) / sizeof(table[0]));
+  tableServer.begin();
+
+  // Path arguments of the table route, for each of its methods
+  CHECK_EQUAL(tableAnswer(tableServer, "GET", "/led/on"), "table led on");
+  CHECK_EQUAL(tableAnswer(tableServer, "PUT", "/led/off"), "table led off");
+  CHECK_EQUAL(tableAnswer(tableServer, "POST", "/api/7"), "table post 7");
+  CHECK_EQUAL(tableAnswer(tableServer, "DELETE", "/files/a/b.txt"), "table files");
+  CHECK_EQUAL(tableAnswer(tableServer, "GET", "/files"), "table files");
+
+  // Another method, or a URI no table route accepts, falls through to the dynamic routes
+  CHECK_EQUAL(tableAnswer(tableServer, "POST", "/led/on"), "led prefix");
+  CHECK_EQUAL(tableAnswer(tableServer, "GET", "/led/on/now"), "led prefix");
+  CHECK_EQUAL(tableAnswer(tableServer, "GET", "/api/7"), "id 7");
+  CHECK_EQUAL(tableAnswer(tableServer, "DELETE", "/api/7"), "id 7");
+  CHECK_EQUAL(tableAnswer(tableServer, "GET", "/other"), "404");
+
+  // Without table, the same requests go to the dynamic routes
+  tableServer.setRouteTable(nullptr, 0);
+
+  CHECK_EQUAL(tableAnswer(tableServer, "GET", "/led/on"), "led prefix");
+  CHECK_EQUAL(tableAnswer(tableServer, "POST", "/api/7"), "id 7");
+  CHECK_EQUAL(tableAnswer(tableServer, "GET", "/files/a"), "404");
+
+  server = nullptr;
+}
+
+int main()
+{
+  testPrecedence();
+  testAddedAfterBegin();
+  testRouteTable();
+
+  return hostTestResult("RouterTest");
+}
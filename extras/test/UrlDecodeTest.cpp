@@ -0,0 +1,227 @@
+/****************************************************************************************************************************
+  UrlDecodeTest.cpp - urlDecodeChars(), which scans 4 bytes at a time and reads hex digits from a PROGMEM table,
+  checked against the original char-by-char urlDecode(), then both timed on form payloads.
+
+  Every string of up to 6 chars of an alphabet of escape chars, hex and other digits and a byte above 0x7F, and of up
+  to 9 chars of a smaller one, is decoded into another buffer and in place, so that an escape falls at each position
+  of the word scan and of its tail. Then every "%XY" byte pair, and random strings of up to 80 bytes.
+  Usage: UrlDecodeTest [iterations of the benchmark]
+
+  Licensed under MIT license
+ *****************************************************************************************************************************/
+
+#include <random>
+
+#include "HostTest.h"
+
+// urlDecode() of the original library
+static std::string referenceDecode(const std::string& text)
+{
+  std::string   decoded;
+  char          temp[]  = "0x00";
+  unsigned int  len     = text.length();
+  unsigned int  i       = 0;
+
+  while (i < len)
+  {
+    char decodedChar;
+    char encodedChar = text[i++];
+
+    if ((encodedChar == '%') && (i + 1 < len))
+    {
+      temp[2] = text[i++];
+      temp[3] = text[i++];
+
+      decodedChar = strtol(temp, NULL, 16);
+    }
+    else if (encodedChar == '+')
+    {
+      decodedChar = ' ';
+    }
+    else
+    {
+      decodedChar = encodedChar;
+    }
+
+    decoded += decodedChar;
+  }
+
+  return decoded;
+}
+
+////////////////////////////////////////
+
+static uint64_t checked = 0;
+
+// Decode text into another buffer and in place, and compare both with the reference
+static bool checkDecode(const std::string& text)
+{
+  std::string expected = referenceDecode(text);
+
+  // Guard bytes after the end, which mustn't be touched
+  char source[128 + 4];
+  char dest[128 + 4];
+
+  memcpy(source, text.data(), text.size());
+  memcpy(source + text.size(), "\xA5\xA5\xA5\xA5", 4);
+  memset(dest, 0x5A, sizeof(dest));
+
+  size_t length       = urlDecodeChars(dest, source, text.size());
+  bool   ok           = (std::string(dest, length) == expected) && (dest[length] == 0x5A);
+
+  length  = urlDecodeChars(source, source, text.size());
+  ok      = ok && (std::string(source, length) == expected) && !memcmp(source + text.size(), "\xA5\xA5\xA5\xA5", 4);
+
+  checked++;
+
+  if (!ok)
+  {
+    printf("Mismatch decoding \"");
+
+    for (char c : text)
+      printf(isprint((unsigned char) c) ? "%c" : "\\x%02X", (uint8_t) c);
+
+    printf("\"\n");
+    hostTestFailures++;
+  }
+
+  return ok;
+}
+
+// Every string of up to maxLength chars of alphabet, until the first mismatch
+static void checkAllStrings(const char* alphabet, size_t maxLength)
+{
+  size_t      letters = strlen(alphabet);
+  std::string text;
+
+  for (size_t length = 0; length <= maxLength; length++)
+  {
+    std::vector<size_t> digits(length, 0);
+
+    text.assign(length, alphabet[0]);
+
+    while (true)
+    {
+      if (!checkDecode(text))
+        return;
+
+      size_t i = 0;
+
+      // Next string, like a counter in base letters
+      while ( (i < length) && (++digits[i] == letters) )
+      {
+        digits[i]  = 0;
+        text[i]    = alphabet[0];
+        i++;
+      }
+
+      if (i == length)
+        break;
+
+      text[i] = alphabet[digits[i]];
+    }
+  }
+}
+
+static void testCorrectness()
+{
+  // '%' and '+', hex digits of both cases and at the limits of their ranges, chars just outside them, a high byte
+  checkAllStrings("%+09afAFgG:\xC3", 6);
+  checkAllStrings("%+0Fx", 9);
+
+  // Every byte pair after '%', between runs of clean chars and at the end
+  for (int high = 0; high < 256; high++)
+  {
+    for (int low = 0; low < 256; low++)
+    {
+      std::string escape = std::string("%") + (char) high + (char) low;
+
+      checkDecode("abc" + escape + "defgh" + escape);
+      checkDecode(escape + "+" + escape.substr(0, 2));
+    }
+  }
+
+  std::mt19937  random(1);
+  const char    frequent[] = "%%%++09afAFgxyz";
+
+  for (int i = 0; i < 300000; i++)
+  {
+    std::string text(random() % 81, 0);
+
+    for (char& c : text)
+      c = (random() % 4) ? frequent[random() % (sizeof(frequent) - 1)] : (char) random();
+
+    checkDecode(text);
+  }
+
+  // Through the public API
+  CHECK_EQUAL(EthernetWebServer::urlDecode("a%20b+c%2Bd%zz%4"), std::string("a b c+d\0%4", 10));
+  CHECK_EQUAL(EthernetWebServer::urlDecode(""), "");
+
+  printf("%llu strings decoded as by the original urlDecode()\n", (unsigned long long) checked);
+}
+
+////////////////////////////////////////
+
+static const char* const payloads[][2] =
+{
+  { "WiFi settings",  "ssid=Office+Network+2.4GHz&password=s3cr%21t%26p%40ss&ip=192.168.2.100&mask=255.255.255.0"
+                      "&gateway=192.168.2.1&dns=8.8.8.8&hostname=sensor-node-12&ntp=pool.ntp.org&tz=Europe%2FParis" },
+  { "Text area",      "message=Hello+there%2C%0D%0AThe+sensor+in+the+north+room+reported+21.5%C2%B0C+at+10%3A42"
+                      "+and+48%25+humidity.+Please+check+the+window+%28it+might+be+open%29+and+reply+to+this+message"
+                      "+when+done.%0D%0AThanks%21" },
+  { "JSON field",     "config=%7B%22interval%22%3A60%2C%22sensors%22%3A%5B%22t1%22%2C%22t2%22%2C%22h1%22%5D%2C%22"
+                      "alarm%22%3A%7B%22min%22%3A15%2C%22max%22%3A28%7D%7D" },
+  { "No escapes",     "device=sensor-node-12&firmware=2.3.0&uptime=123456&heap=23480&rssi=-61&temperature=21.5"
+                      "&humidity=48&pressure=1013.2&battery=3.71&status=ok&lastReset=powerOn" }
+};
+
+static void bench(unsigned iterations)
+{
+  printf("%-14s %6s %14s %14s %14s\n", "payload", "bytes", "original", "urlDecode()", "in place");
+
+  for (const auto& payload : payloads)
+  {
+    std::string text(payload[1]);
+    String      textString(payload[1]);
+    std::vector<char> buf(text.size());
+    size_t      sink = 0;
+
+    HostTimer timer;
+
+    for (unsigned i = 0; i < iterations; i++)
+      sink += referenceDecode(text).size();
+
+    double original = timer.micros();
+
+    timer = HostTimer();
+
+    for (unsigned i = 0; i < iterations; i++)
+      sink += EthernetWebServer::urlDecode(textString).length();
+
+    double decode = timer.micros();
+
+    timer = HostTimer();
+
+    for (unsigned i = 0; i < iterations; i++)
+    {
+      memcpy(buf.data(), text.data(), text.size());
+      sink += urlDecodeChars(buf.data(), buf.data(), text.size());
+    }
+
+    double inPlace = timer.micros();
+
+    CHECK(sink > 0);
+
+    printf("%-14s %6u %11.3f us %11.3f us %11.3f us\n", payload[0], (unsigned) text.size(), original / iterations,
+           decode / iterations, inPlace / iterations);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  testCorrectness();
+  bench((argc > 1) ? atoi(argv[1]) : 100000);
+
+  return hostTestResult("UrlDecodeTest");
+}
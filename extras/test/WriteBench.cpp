@@ -0,0 +1,100 @@
+/****************************************************************************************************************************
+  WriteBench.cpp - write() calls per response, each a transfer to the TX buffer of the socket and a SEND command, so
+  at least one packet, on W5x00. Also the time of a response.
+
+  The responses are chunked, sent in small and large pieces by sendContent(), and with Content-Length by send().
+  Built with the default output buffer, and without, as for AVR. Only the API of the original library is used, so
+  that the benchmark also builds against it, see README.md; sendParts() is only measured when it's there.
+  Usage: WriteBench [responses]
+
+  Licensed under MIT license
+ *****************************************************************************************************************************/
+
+#include "HostTest.h"
+
+#ifndef HTTP_OUTPUT_BUFLEN
+  // Original library
+  #define HTTP_OUTPUT_BUFLEN    0
+#endif
+
+EthernetWebServer server(80);
+
+static std::string content;
+
+static void bench(const char* name, const char* uri, unsigned count)
+{
+  HostResponse    response;
+  HostBenchResult result = hostBench(server, std::string("GET ") + uri + " HTTP/1.1\r\n\r\n", count, response);
+
+  CHECK_EQUAL(response.code, 200);
+  CHECK(response.body == content.substr(0, response.body.size()));
+  CHECK(response.body.size() >= 4000);
+
+  printf("%-34s %6.1f writes %6.0f bytes %7.2f us\n", name, result.writes, result.outputBytes, result.micros);
+}
+
+// Send the first pieces * length bytes of content in pieces of length bytes
+static void sendPieces(int pieces, size_t length)
+{
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "text/plain", "");
+
+  for (int i = 0; i < pieces; i++)
+    server.sendContent(content.substr(i * length, length).c_str());
+
+  server.sendContent("");
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned count = (argc > 1) ? atoi(argv[1]) : 20000;
+
+  for (int i = 0; content.size() < 8000; i++)
+    content += "{\"id\":" + std::to_string(i) + ",\"value\":" + std::to_string(i * 7 % 100) + "},\n";
+
+  server.on("/small", []()
+  {
+    sendPieces(100, 40);
+  });
+
+  server.on("/large", []()
+  {
+    sendPieces(4, 1000);
+  });
+
+  server.on("/send", []()
+  {
+    server.send(200, "text/plain", content.substr(0, 4000).c_str());
+  });
+
+#ifdef HTTP_WRITEV_GATHER_LEN
+  server.on("/parts", []()
+  {
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "text/plain", "");
+
+    for (size_t i = 0; i < 4000; i += 400)
+    {
+      ethernetWritePart parts[] = { { content.c_str() + i, 200 }, { content.c_str() + i + 200, 200 } };
+
+      server.sendParts(parts);
+    }
+
+    server.sendContent("");
+  });
+#endif
+
+  server.begin();
+
+  printf("HTTP_OUTPUT_BUFLEN %d\n", HTTP_OUTPUT_BUFLEN);
+
+  bench("chunked, 100 sendContent() of 40 B", "/small", count);
+  bench("chunked, 4 sendContent() of 1000 B", "/large", count);
+  bench("send() of 4000 B", "/send", count);
+
+#ifdef HTTP_WRITEV_GATHER_LEN
+  bench("chunked, 10 sendParts() of 2 x 200 B", "/parts", count);
+#endif
+
+  return hostTestResult("WriteBench");
+}
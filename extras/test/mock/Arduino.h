@@ -0,0 +1,337 @@
+/****************************************************************************************************************************
+  Arduino.h - Host mock of the Arduino core, for the EthernetWebServer host tests.
+
+  Only what the library uses is provided: String on top of std::string, the PROGMEM accessors, millis() driven by
+  the tests, and a Serial printing to stderr.
+
+  Licensed under MIT license
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#ifndef MOCK_ARDUINO_H
+#define MOCK_ARDUINO_H
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <iostream>
+#include <string>
+
+#include "avr/pgmspace.h"
+
+typedef bool    boolean;
+typedef uint8_t byte;
+
+#define F(s)      (s)
+#define FPSTR(s)  ((const char *) (s))
+
+#ifndef min
+  #define min(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+////////////////////////////////////////
+
+// Time of the mocked board, advanced by the tests and by delay()
+inline unsigned long& mockMillis()
+{
+  static unsigned long ms = 0;
+
+  return ms;
+}
+
+inline unsigned long millis()
+{
+  return mockMillis();
+}
+
+inline void delay(unsigned long ms)
+{
+  mockMillis() += ms;
+}
+
+inline void yield()
+{
+}
+
+////////////////////////////////////////
+
+class String : public std::string
+{
+  public:
+
+    String() {}
+    String(const char* str) : std::string(str ? str : "") {}
+    String(const char* str, size_t length) : std::string(str, length) {}
+    String(const std::string& str) : std::string(str) {}
+    explicit String(char c) : std::string(1, c) {}
+    String(int value, int base = 10) : std::string(format(value, base)) {}
+    String(unsigned value, int base = 10) : std::string(format(value, base)) {}
+    String(long value, int base = 10) : std::string(format(value, base)) {}
+    String(unsigned long value, int base = 10) : std::string(format(value, base)) {}
+
+    unsigned length() const
+    {
+      return size();
+    }
+
+    bool reserve(unsigned size)
+    {
+      std::string::reserve(size);
+
+      return true;
+    }
+
+    bool concat(const String& str)
+    {
+      append(str);
+
+      return true;
+    }
+
+    bool concat(const char* str)
+    {
+      append(str);
+
+      return true;
+    }
+
+    bool concat(const char* str, unsigned length)
+    {
+      append(str, length);
+
+      return true;
+    }
+
+    bool concat(char c)
+    {
+      push_back(c);
+
+      return true;
+    }
+
+    String& operator+=(const String& str)
+    {
+      append(str);
+
+      return *this;
+    }
+
+    String& operator+=(const char* str)
+    {
+      append(str);
+
+      return *this;
+    }
+
+    String& operator+=(char c)
+    {
+      push_back(c);
+
+      return *this;
+    }
+
+    String& operator+=(int value)
+    {
+      append(format(value, 10));
+
+      return *this;
+    }
+
+    bool equals(const String& str) const
+    {
+      return *this == str;
+    }
+
+    bool equalsIgnoreCase(const String& str) const
+    {
+      return strcasecmp(c_str(), str.c_str()) == 0;
+    }
+
+    bool startsWith(const String& prefix) const
+    {
+      return compare(0, prefix.size(), prefix) == 0;
+    }
+
+    bool startsWith(const String& prefix, unsigned offset) const
+    {
+      return (offset <= size()) && (compare(offset, prefix.size(), prefix) == 0);
+    }
+
+    bool endsWith(const String& suffix) const
+    {
+      return (size() >= suffix.size()) && (compare(size() - suffix.size(), suffix.size(), suffix) == 0);
+    }
+
+    char charAt(unsigned i) const
+    {
+      return (i < size()) ? (*this)[i] : 0;
+    }
+
+    int indexOf(char c, unsigned from = 0) const
+    {
+      size_t pos = find(c, from);
+
+      return (pos == npos) ? -1 : (int) pos;
+    }
+
+    int indexOf(const String& str, unsigned from = 0) const
+    {
+      size_t pos = find(str, from);
+
+      return (pos == npos) ? -1 : (int) pos;
+    }
+
+    int lastIndexOf(char c) const
+    {
+      size_t pos = rfind(c);
+
+      return (pos == npos) ? -1 : (int) pos;
+    }
+
+    String substring(unsigned from) const
+    {
+      return (from < size()) ? String(substr(from)) : String();
+    }
+
+    String substring(unsigned from, unsigned to) const
+    {
+      if (from > to)
+        std::swap(from, to);
+
+      return (from < size()) ? String(substr(from, to - from)) : String();
+    }
+
+    void remove(unsigned index, unsigned count = (unsigned) -1)
+    {
+      if (index < size())
+        erase(index, count);
+    }
+
+    void replace(const String& find, const String& replacement)
+    {
+      if (find.empty())
+        return;
+
+      for (size_t pos = 0; (pos = std::string::find(find, pos)) != npos; pos += replacement.size())
+        std::string::replace(pos, find.size(), replacement);
+    }
+
+    void toLowerCase()
+    {
+      for (char& c : *this)
+        c = tolower((unsigned char) c);
+    }
+
+    void toUpperCase()
+    {
+      for (char& c : *this)
+        c = toupper((unsigned char) c);
+    }
+
+    void trim()
+    {
+      while (size() && isspace((unsigned char) back()))
+        pop_back();
+
+      size_t start = 0;
+
+      while ( (start < size()) && isspace((unsigned char) (*this)[start]) )
+        start++;
+
+      erase(0, start);
+    }
+
+    long toInt() const
+    {
+      return atol(c_str());
+    }
+
+  private:
+
+    template<typename T>
+    static std::string format(T value, int base)
+    {
+      if (base == 10)
+        return std::to_string(value);
+
+      char buf[2 + 8 * sizeof(T)];
+
+      snprintf(buf, sizeof(buf), (base == 16) ? "%llx" : "%llo", (unsigned long long) value);
+
+      return buf;
+    }
+};
+
+inline String operator+(const String& a, const String& b)
+{
+  String result(a);
+
+  result += b;
+
+  return result;
+}
+
+inline String operator+(const String& a, const char* b)
+{
+  String result(a);
+
+  result += b;
+
+  return result;
+}
+
+inline String operator+(const char* a, const String& b)
+{
+  String result(a);
+
+  result += b;
+
+  return result;
+}
+
+inline String operator+(const String& a, char b)
+{
+  String result(a);
+
+  result += b;
+
+  return result;
+}
+
+inline String operator+(const String& a, int b)
+{
+  return a + String(b);
+}
+
+////////////////////////////////////////
+
+class Print
+{
+  public:
+
+    template<typename T>
+    void print(const T& value)
+    {
+      std::cerr << value;
+    }
+
+    template<typename T>
+    void println(const T& value)
+    {
+      std::cerr << value << std::endl;
+    }
+
+    void println()
+    {
+      std::cerr << std::endl;
+    }
+};
+
+extern Print Serial;
+
+#endif // MOCK_ARDUINO_H
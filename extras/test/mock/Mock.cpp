@@ -0,0 +1,57 @@
+/****************************************************************************************************************************
+  Mock.cpp - Globals of the host mocks, for the EthernetWebServer host tests.
+
+  operator new is replaced to count the heap allocations of the library: String, std::string and new.
+
+  Licensed under MIT license
+ *****************************************************************************************************************************/
+
+#include <new>
+
+#include "Arduino.h"
+#include "MockHeap.h"
+
+Print Serial;
+
+uint64_t MockHeap::allocations  = 0;
+uint64_t MockHeap::bytes        = 0;
+
+////////////////////////////////////////
+
+void* operator new(size_t size)
+{
+  MockHeap::allocations++;
+  MockHeap::bytes += size;
+
+  void* ptr = malloc(size ? size : 1);
+
+  if (!ptr)
+    throw std::bad_alloc();
+
+  return ptr;
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+  free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+  free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+  free(ptr);
+}
@@ -0,0 +1,270 @@
+/****************************************************************************************************************************
+  MockEthernet.h - Host mock of EthernetClient and EthernetServer, for the EthernetWebServer host tests.
+
+  A MockConnection holds what the client sends and what the server writes. The tests queue connections with
+  MockNetwork::connect(), which the server then accepts. What the client sends can be released a few bytes at a time,
+  or arrive at a given rate as millis() advances, as it would from the network. Each read() and write() call is counted: on W5x00 each one is an SPI
+  transaction, and each write() also a SEND command.
+
+  Licensed under MIT license
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#ifndef MOCK_ETHERNET_H
+#define MOCK_ETHERNET_H
+
+#include <deque>
+#include <memory>
+
+#include "Arduino.h"
+
+#ifndef MAX_SOCK_NUM
+  #define MAX_SOCK_NUM  8
+#endif
+
+struct MockConnection
+{
+  std::string   input;                // sent by the client
+  size_t        received  = SIZE_MAX; // bytes of input arrived so far, all of them by default
+  size_t        readPos   = 0;        // bytes of input read by the server
+  std::string   output;               // written by the server
+  bool          open      = true;     // not closed by the client
+  bool          stopped   = false;    // closed by the server
+  uint32_t      reads     = 0;        // read() calls
+  uint32_t      writes    = 0;        // write() calls
+  unsigned long connectedAt = 0;      // millis() when the client connected
+  size_t        bytesPerMs  = 0;      // rate at which the input arrives from connectedAt, 0 for all at once
+
+  size_t arrived() const
+  {
+    size_t length = (received < input.size()) ? received : input.size();
+
+    if ( bytesPerMs && ((millis() - connectedAt) * bytesPerMs < length) )
+      length = (millis() - connectedAt) * bytesPerMs;
+
+    return length;
+  }
+
+  // Let count more bytes of the input arrive
+  void receive(size_t count)
+  {
+    received = arrived() + count;
+  }
+
+  bool done() const
+  {
+    return stopped || (readPos == input.size());
+  }
+};
+
+typedef std::shared_ptr<MockConnection> MockConnectionPtr;
+
+////////////////////////////////////////
+
+class EthernetClient
+{
+  public:
+
+    EthernetClient() {}
+    EthernetClient(const MockConnectionPtr& connection) : _connection(connection) {}
+
+    int available()
+    {
+      return _connection ? (int) (_connection->arrived() - _connection->readPos) : 0;
+    }
+
+    int read()
+    {
+      uint8_t c;
+
+      return (read(&c, 1) == 1) ? c : -1;
+    }
+
+    int read(uint8_t* buf, size_t size)
+    {
+      size_t length = available();
+
+      if (!length)
+        return -1;
+
+      if (length > size)
+        length = size;
+
+      memcpy(buf, _connection->input.data() + _connection->readPos, length);
+      _connection->readPos += length;
+      _connection->reads++;
+
+      return (int) length;
+    }
+
+    // Like Stream, wait up to the timeout for more data until size bytes are read
+    size_t readBytes(char* buf, size_t size)
+    {
+      size_t count = 0;
+
+      while ( (count < size) && _wait() )
+        count += read((uint8_t *) buf + count, size - count);
+
+      return count;
+    }
+
+    size_t readBytes(uint8_t* buf, size_t size)
+    {
+      return readBytes((char *) buf, size);
+    }
+
+    // Like Stream, wait for each char up to the timeout, the time passing for the mocked board
+    String readStringUntil(char terminator)
+    {
+      String str;
+      int c;
+
+      while ( ((c = timedRead()) >= 0) && (c != terminator) )
+        str += (char) c;
+
+      return str;
+    }
+
+    int timedRead()
+    {
+      return _wait() ? read() : -1;
+    }
+
+    int peek()
+    {
+      return available() ? (uint8_t) _connection->input[_connection->readPos] : -1;
+    }
+
+    size_t write(const uint8_t* buf, size_t size)
+    {
+      if (!connected())
+        return 0;
+
+      _connection->output.append((const char *) buf, size);
+      _connection->writes++;
+
+      return size;
+    }
+
+    size_t write(const char* buf, size_t size)
+    {
+      return write((const uint8_t *) buf, size);
+    }
+
+    size_t write(uint8_t c)
+    {
+      return write(&c, 1);
+    }
+
+    uint8_t connected()
+    {
+      return _connection && !_connection->stopped && (_connection->open || available());
+    }
+
+    void stop()
+    {
+      if (_connection)
+        _connection->stopped = true;
+    }
+
+    void flush() {}
+    void setTimeout(unsigned long timeout)
+    {
+      _timeout = timeout;
+    }
+
+    operator bool()
+    {
+      return (bool) _connection;
+    }
+
+    bool operator==(const EthernetClient& other) const
+    {
+      return _connection == other._connection;
+    }
+
+    bool operator!=(const EthernetClient& other) const
+    {
+      return _connection != other._connection;
+    }
+
+  private:
+
+    // Return false if no data arrived before the timeout
+    bool _wait()
+    {
+      unsigned long start = millis();
+
+      while ( !available() && connected() && (millis() - start < _timeout) )
+        delay(1);
+
+      return available();
+    }
+
+    MockConnectionPtr _connection;
+    unsigned long     _timeout = 1000;
+};
+
+////////////////////////////////////////
+
+class MockNetwork
+{
+  public:
+
+    // Queue a connection sending input, to be accepted by the server. Only received bytes of it arrive until more
+    // are let in by MockConnection::receive()
+    static MockConnectionPtr connect(const std::string& input, size_t received = SIZE_MAX)
+    {
+      MockConnectionPtr connection = std::make_shared<MockConnection>();
+
+      connection->input       = input;
+      connection->received    = received;
+      connection->connectedAt = millis();
+      pending().push_back(connection);
+
+      return connection;
+    }
+
+    static std::deque<MockConnectionPtr>& pending()
+    {
+      static std::deque<MockConnectionPtr> connections;
+
+      return connections;
+    }
+};
+
+////////////////////////////////////////
+
+class EthernetServer
+{
+  public:
+
+    EthernetServer(uint16_t port) {}
+
+    void begin() {}
+    void close() {}
+
+    EthernetClient accept()
+    {
+      if (MockNetwork::pending().empty())
+        return EthernetClient();
+
+      MockConnectionPtr connection = MockNetwork::pending().front();
+
+      MockNetwork::pending().pop_front();
+
+      return EthernetClient(connection);
+    }
+
+    // Before accept(), Ethernet libraries only returned connections with data available
+    EthernetClient available()
+    {
+      if (MockNetwork::pending().empty() || !MockNetwork::pending().front()->arrived())
+        return EthernetClient();
+
+      return accept();
+    }
+};
+
+#endif // MOCK_ETHERNET_H
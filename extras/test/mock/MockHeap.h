@@ -0,0 +1,21 @@
+/****************************************************************************************************************************
+  MockHeap.h - Heap allocations counted by the host mocks, for the EthernetWebServer host tests.
+
+  Licensed under MIT license
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#ifndef MOCK_HEAP_H
+#define MOCK_HEAP_H
+
+#include <stdint.h>
+
+// Calls to operator new and bytes they allocated, since the start of the program
+struct MockHeap
+{
+  static uint64_t allocations;
+  static uint64_t bytes;
+};
+
+#endif // MOCK_HEAP_H
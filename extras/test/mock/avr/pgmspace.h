@@ -0,0 +1,32 @@
+/****************************************************************************************************************************
+  pgmspace.h - Host mock of avr/pgmspace.h, for the EthernetWebServer host tests.
+
+  The host has one address space: flash is read in place, like on the ARM boards.
+
+  Licensed under MIT license
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#ifndef MOCK_PGMSPACE_H
+#define MOCK_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P     const char *
+
+#define pgm_read_byte(addr)   (*(const uint8_t *) (addr))
+#define pgm_read_word(addr)   (*(const uint16_t *) (addr))
+#define pgm_read_dword(addr)  (*(const uint32_t *) (addr))
+#define pgm_read_ptr(addr)    (*(const void * const *) (addr))
+
+#define memcpy_P    memcpy
+#define strlen_P    strlen
+#define strncpy_P   strncpy
+#define strcmp_P    strcmp
+#define strncmp_P   strncmp
+#define strcasecmp_P  strcasecmp
+
+#endif // MOCK_PGMSPACE_H
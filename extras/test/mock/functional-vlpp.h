@@ -0,0 +1,27 @@
+/****************************************************************************************************************************
+  functional-vlpp.h - Host mock of the Functional-Vlpp library, for the EthernetWebServer host tests.
+
+  Licensed under MIT license
+ *****************************************************************************************************************************/
+
+#pragma once
+
+#ifndef MOCK_FUNCTIONAL_VLPP_H
+#define MOCK_FUNCTIONAL_VLPP_H
+
+#include <functional>
+
+namespace vl
+{
+  template<typename T>
+  class Func : public std::function<T>
+  {
+    public:
+
+      using std::function<T>::function;
+
+      Func() {}
+  };
+}
+
+#endif // MOCK_FUNCTIONAL_VLPP_H
@@ -42,8 +42,10 @@
 #include <libb64/cencode.h>
 #include "EthernetWebServer.hpp"
 #include "detail/RequestHandlersImpl.h"
+#include "detail/JsonRequestHandler.h"
 #include "detail/Debug.h"
 #include "detail/mimetable.h"
+#include "detail/StatusLines.h"
 
 const char * ETHERNET_AUTHORIZATION_HEADER = "Authorization";
 
@@ -90,11 +92,25 @@ EthernetWebServer::EthernetWebServer(int port)
   , _lastHandler(0)
   , _currentArgCount(0)
   , _currentArgs(0)
+  , _currentArgsCapacity(0)
   , _headerKeysCount(0)
   , _currentHeaders(0)
   , _contentLength(0)
   , _clientContentLength(0)
+  , _responseHeadersLength(0)
   , _chunked(false)
+  , _keepAlive(false)
+  , _responseStarted(false)
+  , _contentDropped(false)
+#if (HTTP_OUTPUT_BUFLEN > 0)
+  , _outputLength(0)
+#endif
+  , _connections()
+  , _currentConnection(_connections)
+  , _requestOwner(nullptr)
+  , _requestSince(0)
+  , _requestWaiting(false)
+  , _nextConnection(0)
 {
 }
 
@@ -102,10 +118,29 @@ EthernetWebServer::EthernetWebServer(int port)
 
 EthernetWebServer::~EthernetWebServer()
 {
+  // close() collects the default headers again if none are
+  close();
+
   if (_currentHeaders)
     delete[]_currentHeaders;
 
-  _headerKeysCount = 0;
+  if (_headerSlots)
+    delete[] _headerSlots;
+
+  if (_jsonParser)
+    delete _jsonParser;
+
+#if HTTP_COMPRESSION
+  if (_deflate)
+    delete _deflate;
+
+  _deflate          = nullptr;
+#endif
+
+  _currentHeaders   = nullptr;
+  _headerSlots      = nullptr;
+  _jsonParser       = nullptr;
+  _headerKeysCount  = 0;
   ethernetRequestHandler* handler = _firstHandler;
 
   while (handler)
@@ -114,8 +149,6 @@ EthernetWebServer::~EthernetWebServer()
     delete handler;
     handler = next;
   }
-
-  close();
 }
 
 ////////////////////////////////////////
@@ -123,10 +156,15 @@ EthernetWebServer::~EthernetWebServer()
 void EthernetWebServer::begin()
 {
   _currentStatus = HC_NONE;
+
+  for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++)
+    _connections[i].status = HC_NONE;
   _server.begin();
 
   if (!_headerKeysCount)
     collectHeaders(0, 0);
+
+  _router.build(_firstHandler);
 }
 
 ////////////////////////////////////////
@@ -213,6 +251,29 @@ void EthernetWebServer::on(const String &uri, HTTPMethod method, EthernetWebServ
 
 ////////////////////////////////////////
 
+// Route whose request body is passed to bfn as it's received, see body(), fn answering the request once it's complete
+void EthernetWebServer::onBody(const String &uri, HTTPMethod method, EthernetWebServer::THandlerFunction fn,
+                               EthernetWebServer::THandlerFunction bfn)
+{
+  _addRequestHandler(new ethernetFunctionRequestHandler(fn, THandlerFunction(), uri, method, bfn));
+}
+
+////////////////////////////////////////
+
+// Route whose JSON request body is parsed as it's received, vfn being called with jsonValue() for each value, and fn
+// answering the request once it's complete, with jsonError()
+void EthernetWebServer::onJson(const String &uri, HTTPMethod method, EthernetWebServer::THandlerFunction fn,
+                               EthernetWebServer::THandlerFunction vfn)
+{
+  // One parser is enough for all routes, as the server parses one request at a time
+  if (!_jsonParser)
+    _jsonParser = new ethernetJsonParser();
+
+  _addRequestHandler(new ethernetJsonRequestHandler(fn, vfn, uri, method));
+}
+
+////////////////////////////////////////
+
 void EthernetWebServer::addHandler(ethernetRequestHandler* handler)
 {
   _addRequestHandler(handler);
@@ -220,6 +281,15 @@ void EthernetWebServer::addHandler(ethernetRequestHandler* handler)
 
 ////////////////////////////////////////
 
+// The table stays in flash, and is read one route at a time for each request. Nothing is allocated
+void EthernetWebServer::setRouteTable(const ethernetRoute* routes, uint16_t routeCount)
+{
+  _routeTable       = routes;
+  _routeTableCount  = routes ? routeCount : 0;
+}
+
+////////////////////////////////////////
+
 void EthernetWebServer::_addRequestHandler(ethernetRequestHandler* handler)
 {
   if (!_lastHandler)
@@ -232,6 +302,8 @@ void EthernetWebServer::_addRequestHandler(ethernetRequestHandler* handler)
     _lastHandler->next(handler);
     _lastHandler = handler;
   }
+
+  _router.invalidate();
 }
 
 ////////////////////////////////////////
@@ -243,74 +315,185 @@ void EthernetWebServer::_addRequestHandler(ethernetRequestHandler* handler)
 
 void EthernetWebServer::handleClient()
 {
-  if (_currentStatus == HC_NONE)
+  ethernetHTTPConnection* freeConn = nullptr;
+  ethernetHTTPConnection* idleConn = nullptr;
+
+  for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++)
   {
-    EthernetClient client = _server.available();
+    ethernetHTTPConnection& conn = _connections[i];
 
-    if (!client)
+    if (conn.status == HC_NONE)
     {
-      return;
+      if (!freeConn)
+        freeConn = &conn;
+    }
+    else if ( (conn.status == HC_WAIT_READ) && conn.requestCount && (conn.length == 0) && !conn.client.available() )
+    {
+      // Persistent connection waiting for its next request
+      idleConn = &conn;
     }
+  }
 
-    ET_LOGDEBUG(F("handleClient: New Client"));
+  if (freeConn || idleConn)
+  {
+    EthernetClient client = _acceptClient();
 
-    _currentClient = client;
-    _currentStatus = HC_WAIT_READ;
-    _statusChange = millis();
+    if (client)
+    {
+      ET_LOGDEBUG(F("handleClient: New Client"));
+
+      if (!freeConn)
+      {
+        // Don't make the new client wait for the keep-alive timeout of an idle connection
+        ET_LOGDEBUG(F("handleClient: Close idle connection for new Client"));
+
+        idleConn->client.stop();
+        freeConn = idleConn;
+      }
+
+      freeConn->client        = client;
+      freeConn->status        = HC_WAIT_READ;
+      freeConn->statusChange  = millis();
+      freeConn->requestCount  = 0;
+
+      _currentConnection = freeConn;
+      _resetRequest();
+    }
+  }
+
+  bool callYield = false;
+
+  // Serve each open connection once, starting with a different one each time so that none waits behind the others
+  for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++)
+  {
+    ethernetHTTPConnection& conn = _connections[(_nextConnection + i) % HTTP_MAX_CONNECTIONS];
+
+    if ( (conn.status != HC_NONE) && _handleConnection(conn) )
+      callYield = true;
   }
 
+  _nextConnection = (_nextConnection + 1) % HTTP_MAX_CONNECTIONS;
+
+  if (callYield)
+  {
+    yield();
+  }
+}
+
+////////////////////////////////////////
+
+EthernetClient EthernetWebServer::_acceptClient()
+{
+#if (HTTP_MAX_CONNECTIONS > 1)
+  // Return each new connection once, even before it sends data
+  return _server.accept();
+#else
+  return _server.available();
+#endif
+}
+
+////////////////////////////////////////
+
+// The request state is free for the request of another connection
+void EthernetWebServer::_releaseRequest()
+{
+  _requestOwner   = nullptr;
+  _requestWaiting = false;
+}
+
+////////////////////////////////////////
+
+// Parse what the client of this connection has sent so far, answer its request when complete, and close the
+// connection when done or timed out. Return true if waiting for the client
+bool EthernetWebServer::_handleConnection(ethernetHTTPConnection& conn)
+{
   bool keepCurrentClient = false;
   bool callYield = false;
 
-  if (_currentClient.connected() || _currentClient.available())
+  _currentConnection = &conn;
+  _currentClient = conn.client;
+
+  // Requests pipelined by the client may already be in the buffer, even once it stopped sending
+  if (conn.client.connected() || conn.client.available() || conn.length)
   {
-    switch (_currentStatus)
+    switch (conn.status)
     {
       case HC_NONE:
         // No-op to avoid C++ compiler warning
         break;
 
       case HC_WAIT_READ:
+      {
+        // Parse what the client has sent so far, never wait here for the rest of the request
+        int parsed = _parseRequest(conn.client);
 
-        // Wait for data from client to become available
-        if (_currentClient.available())
+        if (parsed > 0)
         {
-          if (_parseRequest(_currentClient))
-          {
-            _currentClient.setTimeout(HTTP_MAX_SEND_WAIT);
-            _contentLength = CONTENT_LENGTH_NOT_SET;
-            _handleRequest();
+          _currentClient.setTimeout(HTTP_MAX_SEND_WAIT);
+          _contentLength = CONTENT_LENGTH_NOT_SET;
+          _handleRequest();
+          _releaseRequest();
 
-#if 0
+          // Wait for the next request on the same connection, which may already be buffered
+          if (_keepAlive)
+            _prepareNextRequest();
 
-            // Fix for issue with Chrome based browsers: https://github.com/espressif/arduino-esp32/issues/3652
-            if (_currentClient.connected())
-            {
-              _currentStatus = HC_WAIT_CLOSE;
-              _statusChange = millis();
-              keepCurrentClient = true;
-            }
+          if ( _keepAlive && (conn.client.connected() || conn.length) )
+          {
+            ET_LOGDEBUG1(F("handleClient: Keep-alive, requests ="), conn.requestCount);
 
-#endif
+            conn.statusChange = millis();
+            keepCurrentClient = true;
           }
         }
-        else
+        else if (parsed == 0)
         {
-          // !_currentClient.available()
-          if (millis() - _statusChange <= HTTP_MAX_DATA_WAIT)
+          // statusChange is updated each time data is received
+          unsigned long timeout = HTTP_MAX_DATA_WAIT;
+          unsigned long since   = conn.statusChange;
+
+          if (conn.state == HP_BEGIN)
+          {
+            // Waiting for the request of another connection, which is given HTTP_MAX_POST_WAIT for its body
+            _requestWaiting = true;
+            timeout = HTTP_MAX_DATA_WAIT + HTTP_MAX_POST_WAIT;
+          }
+          else if (conn.state >= HP_BODY)
+          {
+            timeout = HTTP_MAX_POST_WAIT;
+
+            // While another connection waits, the whole body must arrive in time, however often bytes trickle in
+            if (_requestWaiting)
+              since = _requestSince;
+          }
+          else if (conn.requestCount && (conn.length == 0))
+          {
+            timeout = HTTP_KEEPALIVE_TIMEOUT;
+          }
+
+          if (millis() - since <= timeout)
           {
             keepCurrentClient = true;
           }
+          else
+          {
+            ET_LOGDEBUG(F("handleClient: Request Timeout"));
+          }
 
           callYield = true;
         }
+        else
+        {
+          ET_LOGDEBUG(F("handleClient: Can't parse request"));
+        }
 
         break;
+      }
 
       case HC_WAIT_CLOSE:
 
         // Wait for client to close the connection
-        if (millis() - _statusChange <= HTTP_MAX_CLOSE_WAIT)
+        if (millis() - conn.statusChange <= HTTP_MAX_CLOSE_WAIT)
         {
           keepCurrentClient = true;
           callYield = true;
@@ -321,20 +504,28 @@ void EthernetWebServer::handleClient()
   if (!keepCurrentClient)
   {
     ET_LOGDEBUG(F("handleClient: Don't keepCurrentClient"));
-    _currentClient = EthernetClient();
-    _currentStatus = HC_NONE;
+
+    if (_requestOwner == &conn)
+    {
+      if (conn.state == HP_FORM_FILE)
+        _parseFormUploadAborted();
+      else if (conn.state == HP_BODY_STREAM)
+        _parseBodyAborted();
+
+      _releaseRequest();
+    }
+
+    conn.state = HP_DONE;
+
+    // KH, fix bug. Have to close the connection
+    conn.client.stop();
+    conn.client = EthernetClient();
+    conn.status = HC_NONE;
     // KH
     //_currentUpload.reset();
   }
 
-  if (callYield)
-  {
-    yield();
-  }
-
-  // KH, fix bug. Have to close the connection
-  _currentClient.stop();
-  //ET_LOGDEBUG(F("handleClient: Client disconnected"));
+  return callYield;
 }
 
 ////////////////////////////////////////
@@ -472,6 +663,12 @@ void EthernetWebServer::close()
   // KH, New v2.3.0
   _currentStatus = HC_NONE;
 
+  for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++)
+    _connections[i].status = HC_NONE;
+
+  _requestOwner   = nullptr;
+  _requestWaiting = false;
+
   if (!_headerKeysCount)
     collectHeaders(0, 0);
 
@@ -489,174 +686,260 @@ void EthernetWebServer::stop()
 
 void EthernetWebServer::sendHeader(const String& name, const String& value, bool first)
 {
-  EWString headerLine = fromString(name);
+  // Room is kept for the headers framing the response, added by _prepareHeader(): "Accept-Ranges" and
+  // "Transfer-Encoding", longer than "Content-Length", "Connection", and "Vary" and "Content-Encoding" if compressing
+  size_t framingLength = sizeof("Accept-Ranges: none\r\nTransfer-Encoding: chunked\r\n") - 1
+                         + sizeof("Connection: keep-alive\r\n") - 1;
+
+#if HTTP_COMPRESSION
+  if (_compressionEnabled)
+    framingLength += sizeof("Vary: Accept-Encoding\r\nContent-Encoding: deflate\r\n") - 1;
+#endif
 
-  headerLine += ": ";
-  headerLine += fromString(value);
-  headerLine += RETURN_NEWLINE;
+  _appendHeader(name.c_str(), value.c_str(), first, framingLength);
+}
 
-  if (first)
-  {
-    _responseHeaders = fromEWString(headerLine + fromString(_responseHeaders));
-  }
-  else
+////////////////////////////////////////
+
+// Formats value in decimal, ending just before end, without sprintf() or String. Returns the first digit
+static char* formatDecimal(char* end, unsigned long value)
+{
+  do
   {
-    _responseHeaders = fromEWString(fromString(_responseHeaders) + headerLine);
-  }
+    *--end = '0' + (value % 10);
+    value /= 10;
+  } while (value);
+
+  return end;
 }
 
 ////////////////////////////////////////
 
-void EthernetWebServer::setContentLength(size_t contentLength)
+// Appends "name: value\r\n" to the response header buffer, or inserts it in front of the headers already there.
+// Room is always kept for the status line and the empty line, added by _prepareHeader(), and reserveLength more
+bool EthernetWebServer::_appendHeader(const char* name, const char* value, bool first, size_t reserveLength)
 {
-  _contentLength = contentLength;
+  // Longest status line, and the empty line ending the headers
+  const size_t reservedLength = ethernetStatus::maxLength + 2 + reserveLength;
+
+  size_t nameLength   = strlen(name);
+  size_t valueLength  = strlen(value);
+  size_t lineLength   = nameLength + valueLength + 4;
+
+  if (_responseHeadersLength + lineLength + reservedLength > HTTP_RESPONSE_HEADER_BUFLEN)
+  {
+    ET_LOGERROR1(F("sendHeader: No room in response header buffer, dropped"), name);
+
+    return false;
+  }
+
+  char* line = _responseHeaders + _responseHeadersLength;
+
+  if (first)
+  {
+    memmove(_responseHeaders + lineLength, _responseHeaders, _responseHeadersLength);
+    line = _responseHeaders;
+  }
+
+  memcpy(line, name, nameLength);
+  line += nameLength;
+  *line++ = ':';
+  *line++ = ' ';
+  memcpy(line, value, valueLength);
+  line += valueLength;
+  *line++ = '\r';
+  *line   = '\n';
+
+  _responseHeadersLength += lineLength;
+
+  return true;
 }
 
 ////////////////////////////////////////
 
-void EthernetWebServer::_prepareHeader(String& response, int code, const char* content_type, size_t contentLength)
+bool EthernetWebServer::_appendHeader(const char* name, size_t value)
 {
-  EWString aResponse = fromString(response);
+  char number[21];
 
-  aResponse = "HTTP/1." + fromString(String(_currentVersion)) + " ";
-  aResponse += fromString(String(code));
-  aResponse += " ";
-  aResponse += fromString(_responseCodeToString(code));
-  aResponse += RETURN_NEWLINE;
+  number[20] = 0;
 
-  ET_LOGDEBUG1(F("_prepareHeader aResponse ="), fromEWString(aResponse));
+  return _appendHeader(name, formatDecimal(number + 20, value));
+}
 
-  using namespace mime;
+////////////////////////////////////////
 
-  if (!content_type)
-    content_type = mimeTable[html].mimeType;
+// Inserts "HTTP/1.x code reason\r\n" in front of the headers, in the room kept by _appendHeader(). The line of a
+// known code is copied whole from the status line table, the line of another code is formatted without reason
+bool EthernetWebServer::_insertStatusLine(int code)
+{
+  size_t lineLength;
+  PGM_P statusLine = ethernetStatus::find(code, lineLength);
 
-  sendHeader("Content-Type", content_type, true);
+  char number[11];
+  char* digits        = nullptr;
+  size_t digitsLength = 0;
 
-  if (_contentLength == CONTENT_LENGTH_NOT_SET)
+  if (!statusLine)
   {
-    sendHeader("Content-Length", String(contentLength));
+    digits        = formatDecimal(number + sizeof(number), (code < 0) ? 0 : code);
+    digitsLength  = number + sizeof(number) - digits;
+    lineLength    = 9 + digitsLength + 3;
   }
-  else if (_contentLength != CONTENT_LENGTH_UNKNOWN)
+
+  if (_responseHeadersLength + lineLength + 2 > HTTP_RESPONSE_HEADER_BUFLEN)
   {
-    sendHeader("Content-Length", String(_contentLength));
+    ET_LOGERROR1(F("_prepareHeader: No room for status line, code ="), code);
+
+    return false;
   }
-  else if (_contentLength == CONTENT_LENGTH_UNKNOWN && _currentVersion)
+
+  memmove(_responseHeaders + lineLength, _responseHeaders, _responseHeadersLength);
+
+  char* line = _responseHeaders;
+
+  if (statusLine)
   {
-    //HTTP/1.1 or above client
-    //let's do chunked
-    _chunked = true;
-    sendHeader("Accept-Ranges", "none");
-    sendHeader("Transfer-Encoding", "chunked");
+    memcpy_P(line, statusLine, lineLength);
   }
-
-  if (_corsEnabled)
+  else
   {
-    sendHeader("Access-Control-Allow-Origin",  "*");
-    sendHeader("Access-Control-Allow-Methods", "*");
-    sendHeader("Access-Control-Allow-Headers", "*");
+    memcpy(line, "HTTP/1.1 ", 9);
+    memcpy(line + 9, digits, digitsLength);
+    memcpy(line + 9 + digitsLength, " \r\n", 3);
   }
 
-  ET_LOGDEBUG(F("_prepareHeader sendHeader Conn close"));
-
-  sendHeader("Connection", "close");
+  // Lines are for HTTP/1.1
+  line[7] = '0' + _currentVersion;
 
-  aResponse += fromString(_responseHeaders);
-  aResponse += RETURN_NEWLINE;
+  _responseHeadersLength += lineLength;
 
-  response = fromEWString(aResponse);
-
-  _responseHeaders = String("");
+  return true;
 }
 
 ////////////////////////////////////////
 
-#if ! ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
-void EthernetWebServer::_prepareHeader(EWString& response, int code, const char* content_type, size_t contentLength)
+void EthernetWebServer::setContentLength(size_t contentLength)
 {
-  response = "HTTP/1." + fromString(String(_currentVersion)) + " ";
-  response += fromString(String(code));
-  response += " ";
-  response += fromString(_responseCodeToString(code));
-  response += RETURN_NEWLINE;
+  _contentLength = contentLength;
+}
 
-  //ET_LOGDEBUG1(F("_prepareHeader response ="), fromEWString(response));
+////////////////////////////////////////
 
+// Completes the response header block in _responseHeaders, around the headers set with sendHeader(), and returns
+// its length. The buffer is then free for the headers of the next response, but keeps the block until written.
+// The headers framing the response come first, in the room kept for them by sendHeader(). If they still don't fit,
+// a 500 response closing the connection is prepared instead, and the content of the response isn't sent
+size_t EthernetWebServer::_prepareHeader(int code, const char* content_type, size_t contentLength)
+{
   using namespace mime;
 
   if (!content_type)
     content_type = mimeTable[html].mimeType;
 
-  sendHeader("Content-Type", content_type, true);
+  _responseStarted = true;
+
+  bool framed = true;
+
+#if HTTP_COMPRESSION
+  HTTPContentEncoding encoding = _responseEncoding(code, content_type, contentLength);
+
+  _compressing = (encoding != ENCODING_NONE);
+
+  if (_compressing)
+  {
+    // The compressed length is only known at the end: the response is chunked, or for HTTP/1.0 ends when closed
+    _contentLength = CONTENT_LENGTH_UNKNOWN;
+    framed &= _appendHeader("Content-Encoding", (encoding == ENCODING_GZIP) ? "gzip" : "deflate");
+  }
+#endif
 
   if (_contentLength == CONTENT_LENGTH_NOT_SET)
   {
-    sendHeader("Content-Length", String(contentLength));
+    framed &= _appendHeader("Content-Length", contentLength);
   }
   else if (_contentLength != CONTENT_LENGTH_UNKNOWN)
   {
-    sendHeader("Content-Length", String(_contentLength));
+    framed &= _appendHeader("Content-Length", _contentLength);
   }
   else if (_contentLength == CONTENT_LENGTH_UNKNOWN && _currentVersion)
   {
     //HTTP/1.1 or above client
     //let's do chunked
     _chunked = true;
-    sendHeader("Accept-Ranges", "none");
-    sendHeader("Transfer-Encoding", "chunked");
+    framed &= _appendHeader("Accept-Ranges", "none");
+    framed &= _appendHeader("Transfer-Encoding", "chunked");
   }
 
-  if (_corsEnabled)
+  // Keep the connection open only if the client asked for it, and can find the end of this response
+  _keepAlive = _currentConnection->keepAlive && (_chunked || (_contentLength != CONTENT_LENGTH_UNKNOWN));
+
+  ET_LOGDEBUG1(F("_prepareHeader sendHeader Connection, keepAlive ="), _keepAlive);
+
+  framed &= _appendHeader("Connection", _keepAlive ? "keep-alive" : "close");
+
+  if (!framed)
+  {
+    ET_LOGERROR1(F("_prepareHeader: No room for framing headers, 500 sent instead, code ="), code);
+
+    _responseHeadersLength  = 0;
+    _chunked                = false;
+    _keepAlive              = false;
+    _contentDropped         = true;
+#if HTTP_COMPRESSION
+    _compressing            = false;
+#endif
+
+    _appendHeader("Content-Length", (size_t) 0);
+    _appendHeader("Connection", "close");
+    _insertStatusLine(500);
+  }
+  else
   {
-    sendHeader("Access-Control-Allow-Origin",  "*");
-    sendHeader("Access-Control-Allow-Methods", "*");
-    sendHeader("Access-Control-Allow-Headers", "*");
+#if HTTP_COMPRESSION
+    // Its header is held until content follows, after the response headers
+    if (_compressing)
+      _deflate->begin(encoding);
+#endif
+
+    if (_corsEnabled)
+    {
+      _appendHeader("Access-Control-Allow-Origin",  "*");
+      _appendHeader("Access-Control-Allow-Methods", "*");
+      _appendHeader("Access-Control-Allow-Headers", "*");
+    }
+
+    _appendHeader("Content-Type", content_type, true);
+    _insertStatusLine(code);
   }
 
-  ET_LOGDEBUG(F("_prepareHeader sendHeader Conn close"));
+  _responseHeaders[_responseHeadersLength++] = '\r';
+  _responseHeaders[_responseHeadersLength++] = '\n';
+  _responseHeaders[_responseHeadersLength]   = 0;
 
-  sendHeader("Connection", "close");
+  ET_LOGDEBUG1(F("_prepareHeader response ="), _responseHeaders);
 
-  response += fromString(_responseHeaders);
-  response += RETURN_NEWLINE;
+  size_t headerLength = _responseHeadersLength;
 
-  _responseHeaders = String("");
+  _responseHeadersLength = 0;
+
+  return headerLength;
 }
-#endif
 
 ////////////////////////////////////////
 
 void EthernetWebServer::send(int code, const char* content_type, const String& content)
 {
-  EWString header;
-
-  _prepareHeader(header, code, content_type, content.length());
-
-  _currentClient.write((const uint8_t *)header.c_str(), header.length());
-
-  if (content.length())
-  {
-    sendContent(content, content.length());
-  }
+  send(code, content_type, content.c_str(), content.length());
 }
 
 ////////////////////////////////////////
 
 void EthernetWebServer::send(int code, char* content_type, const String& content, size_t contentLength)
 {
-  EWString header;
-
   char type[64];
 
   memccpy((void*)type, content_type, 0, sizeof(type));
-  _prepareHeader(header, code, (const char* )type, contentLength);
-
-  _currentClient.write((const uint8_t *) header.c_str(), header.length());
-
-  if (contentLength)
-  {
-    sendContent(content, contentLength);
-  }
+  send(code, (const char* )type, content.c_str(), contentLength);
 }
 
 ////////////////////////////////////////
@@ -686,15 +969,39 @@ void EthernetWebServer::send(int code, const char* content_type, const char* con
 
 void EthernetWebServer::send(int code, const char* content_type, const char* content, size_t contentLength)
 {
-  String header;
+#if HTTP_COMPRESSION
+  // Without length set, the content is the whole response. Else more may follow with sendContent()
+  bool complete = (_contentLength == CONTENT_LENGTH_NOT_SET);
+#endif
+
+  size_t headerLength = _prepareHeader(code, content_type, contentLength);
+
+  if (_contentDropped)
+    contentLength = 0;
 
-  _prepareHeader(header, code, content_type, contentLength);
+#if HTTP_COMPRESSION
+  if (_compressing)
+  {
+    _currentClientWrite(_responseHeaders, headerLength);
+    _compress(content, contentLength);
+
+    if (complete)
+      _finishCompression();
 
-  _currentClient.write((const uint8_t *) header.c_str(), header.length());
+    return;
+  }
+#endif
 
   if (contentLength)
   {
-    sendContent(content, contentLength);
+    ethernetWritePart part = { content, contentLength };
+
+    // The headers and the content are written together
+    _sendParts(_responseHeaders, headerLength, &part, 1);
+  }
+  else
+  {
+    _currentClientWrite(_responseHeaders, headerLength);
   }
 }
 
@@ -702,98 +1009,410 @@ void EthernetWebServer::send(int code, const char* content_type, const char* con
 
 void EthernetWebServer::sendContent(const char* content, size_t contentLength)
 {
-  const char * footer = RETURN_NEWLINE;
+  if (_contentDropped)
+    return;
 
-  if (_chunked)
+#if HTTP_COMPRESSION
+  if (_compressing)
   {
-    char chunkSize[11];
-
-    ET_LOGDEBUG1(F("sendContent_char: _chunked, _currentVersion ="), _currentVersion);
+    // Empty content ends the response, as the last chunk does
+    if (contentLength)
+      _compress(content, contentLength);
+    else
+      _finishCompression();
 
-    sprintf(chunkSize, "%x%s", contentLength, footer);
-    _currentClient.write(chunkSize, strlen(chunkSize));
+    return;
   }
+#endif
 
-  _currentClient.write(content, contentLength);
-
-  if (_chunked)
-  {
-    _currentClient.write(footer, 2);
+  ethernetWritePart part = { content, contentLength };
 
-    if (contentLength == 0)
-    {
-      _chunked = false;
-    }
-  }
+  _sendParts(NULL, 0, &part, 1);
 }
 
 ////////////////////////////////////////
 
-void EthernetWebServer::sendContent(const String& content)
+void EthernetWebServer::sendParts(const ethernetWritePart* parts, uint8_t count)
 {
-  sendContent(content.c_str(), content.length());
-}
+  size_t contentLength = 0;
 
-////////////////////////////////////////
+  for (uint8_t i = 0; i < count; i++)
+    contentLength += parts[i].length;
 
-void EthernetWebServer::sendContent(const String& content, size_t contentLength)
-{
-  sendContent(content.c_str(), contentLength);
+  // Nothing to send. In chunked mode, an empty chunk would end the response
+  if ( (contentLength == 0) || _contentDropped )
+    return;
+
+#if HTTP_COMPRESSION
+  if (_compressing)
+  {
+    for (uint8_t i = 0; i < count; i++)
+      _compress(parts[i].data, parts[i].length);
+
+    return;
+  }
+#endif
+
+  _sendParts(NULL, 0, parts, count);
 }
 
 ////////////////////////////////////////
 
-// KH, Restore PROGMEM commands
-void EthernetWebServer::send_P(int code, PGM_P content_type, PGM_P content)
+// Write the header, if any, then the parts as one piece of content, between the size line and the CRLF of a chunk
+// if the response is chunked. An empty chunk ends the chunked response.
+// Everything is passed to _currentClientWritev() together, a few parts at a time
+void EthernetWebServer::_sendParts(const char* header, size_t headerLength, const ethernetWritePart* parts,
+                                   uint8_t count)
 {
-  size_t contentLength = 0;
+  const uint8_t     maxParts = 8;
 
-  if (content != NULL)
+  ethernetWritePart gathered[maxParts];
+  uint8_t           gatheredCount = 0;
+  bool              chunked       = _chunked;
+  char              chunkSize[12];
+
+  if (header)
   {
-    contentLength = strlen_P(content);
+    gathered[gatheredCount].data    = header;
+    gathered[gatheredCount].length  = headerLength;
+    gatheredCount++;
   }
 
-  String header;
-  char type[64];
-
-  memccpy_P((void*)type, (PGM_VOID_P)content_type, 0, sizeof(type));
-  _prepareHeader(header, code, (const char* )type, contentLength);
+  if (chunked)
+  {
+    size_t contentLength = 0;
 
-  ET_LOGDEBUG1(F("send_P: len = "), contentLength);
-  ET_LOGDEBUG1(F("content = "), content);
-  ET_LOGDEBUG1(F("send_P: hdrlen = "), header.length());
-  ET_LOGDEBUG1(F("header = "), header);
+    for (uint8_t i = 0; i < count; i++)
+      contentLength += parts[i].length;
 
-  _currentClient.write(header.c_str(), header.length());
+    ET_LOGDEBUG1(F("_sendParts: _chunked, _currentVersion ="), _currentVersion);
 
-  if (contentLength)
-  {
-    sendContent_P(content);
-  }
-}
+    gathered[gatheredCount].data    = chunkSize;
+    gathered[gatheredCount].length  = _chunkSizeLine(chunkSize, contentLength);
+    gatheredCount++;
+
+    if (contentLength == 0)
+    {
+      _chunked = false;
+    }
+  }
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (gatheredCount == maxParts)
+    {
+      _currentClientWritev(gathered, gatheredCount);
+      gatheredCount = 0;
+    }
+
+    gathered[gatheredCount++] = parts[i];
+  }
+
+  if (chunked)
+  {
+    if (gatheredCount == maxParts)
+    {
+      _currentClientWritev(gathered, gatheredCount);
+      gatheredCount = 0;
+    }
+
+    gathered[gatheredCount].data    = RETURN_NEWLINE;
+    gathered[gatheredCount].length  = 2;
+    gatheredCount++;
+  }
+
+  _currentClientWritev(gathered, gatheredCount);
+}
 
 ////////////////////////////////////////
 
-void EthernetWebServer::send_P(int code, PGM_P content_type, PGM_P content, size_t contentLength)
+// Size line of a chunk of contentLength bytes, "<hex size>\r\n", in line (12 chars at least). Return its length
+uint8_t EthernetWebServer::_chunkSizeLine(char* line, size_t contentLength)
+{
+  static const char hexDigits[] = "0123456789abcdef";
+
+  uint8_t digits = 1;
+
+  for (size_t rest = contentLength >> 4; rest; rest >>= 4)
+    digits++;
+
+  for (uint8_t i = digits; i > 0; i--)
+  {
+    line[i - 1]     = hexDigits[contentLength & 0x0F];
+    contentLength >>= 4;
+  }
+
+  line[digits]      = '\r';
+  line[digits + 1]  = '\n';
+
+  return digits + 2;
+}
+
+////////////////////////////////////////
+
+#if HTTP_COMPRESSION
+
+void EthernetWebServer::enableCompression(bool value)
+{
+  // One encoder is enough for all responses, as the server sends one response at a time
+  if (value && !_deflate)
+    _deflate = new ethernetDeflateEncoder(_deflateWrite, this);
+
+  _compressionEnabled = value && _deflate;
+}
+
+////////////////////////////////////////
+
+// Text types, compressing well. Images and archives are compressed already
+static bool compressibleType(const char* type)
+{
+  return (strncasecmp(type, "text/", 5) == 0) || strstr(type, "json") || strstr(type, "javascript")
+         || strstr(type, "xml");
+}
+
+////////////////////////////////////////
+
+// Coding of the response being prepared, ENCODING_NONE to send it as it is. Compressed are the text responses with
+// content, whose length isn't set with setContentLength(), and which aren't encoded already with a Content-Encoding
+// header. Those also get "Vary: Accept-Encoding", as caches mustn't pass them to clients accepting another coding
+HTTPContentEncoding EthernetWebServer::_responseEncoding(int code, const char* content_type, size_t contentLength)
+{
+  if ( !_compressionEnabled || (code < 200) || (code == 204) || (code == 304) || !compressibleType(content_type) )
+    return ENCODING_NONE;
+
+  if (_contentLength == CONTENT_LENGTH_NOT_SET)
+  {
+    if (contentLength < HTTP_COMPRESS_MIN_LENGTH)
+      return ENCODING_NONE;
+  }
+  else if (_contentLength != CONTENT_LENGTH_UNKNOWN)
+  {
+    return ENCODING_NONE;
+  }
+
+  const char* line  = _responseHeaders;
+  const char* end   = _responseHeaders + _responseHeadersLength;
+
+  while (line < end)
+  {
+    if (strncasecmp(line, "Content-Encoding:", 17) == 0)
+      return ENCODING_NONE;
+
+    line = (const char *) memchr(line, '\n', end - line);
+
+    if (!line)
+      break;
+
+    line++;
+  }
+
+  // Not compressed if this doesn't fit either
+  if (!_appendHeader("Vary", "Accept-Encoding"))
+    return ENCODING_NONE;
+
+  uint8_t accepted = _currentConnection->acceptEncoding;
+
+  ET_LOGDEBUG1(F("_responseEncoding: accepted ="), accepted);
+
+  // gzip first, "deflate" being sent raw by some servers, and so not decoded the same way by all clients
+  if (accepted & ENCODING_GZIP)
+    return ENCODING_GZIP;
+
+  return (accepted & ENCODING_DEFLATE) ? ENCODING_DEFLATE : ENCODING_NONE;
+}
+
+////////////////////////////////////////
+
+void EthernetWebServer::_compress(const char* content, size_t contentLength)
+{
+  _deflate->write((const uint8_t *) content, contentLength);
+}
+
+////////////////////////////////////////
+
+// Write what the encoder still holds, then the last chunk
+void EthernetWebServer::_finishCompression()
+{
+  _compressing = false;
+  _deflate->finish();
+
+  ET_LOGDEBUG1(F("_finishCompression: compressed bytes sent ="), _deflate->stats().outputBytes);
+
+  if (_chunked)
+  {
+    _sendParts(NULL, 0, NULL, 0);
+  }
+}
+
+////////////////////////////////////////
+
+// Output of the encoder, sent as a piece of content, one chunk
+void EthernetWebServer::_deflateWrite(void* server, const uint8_t* data, size_t length)
+{
+  ethernetWritePart part = { (const char *) data, length };
+
+  ((EthernetWebServer *) server)->_sendParts(NULL, 0, &part, 1);
+}
+
+#endif
+
+////////////////////////////////////////
+
+// Collects what is sent for the response in _outputBuf, to write it to the client in as few pieces as possible.
+// Data larger than the buffer is written directly, once the buffer is filled and flushed
+size_t EthernetWebServer::_currentClientWrite(const char* buffer, size_t length)
 {
-  EWString header;
+#if (HTTP_OUTPUT_BUFLEN > 0)
+  size_t written = 0;
 
+  while (written < length)
+  {
+    size_t remaining = length - written;
+
+    if ( (_outputLength == 0) && (remaining >= HTTP_OUTPUT_BUFLEN) )
+    {
+      return written + _currentClient.write((const uint8_t *) buffer + written, remaining);
+    }
+
+    size_t toCopy = HTTP_OUTPUT_BUFLEN - _outputLength;
+
+    if (toCopy > remaining)
+      toCopy = remaining;
+
+    memcpy(_outputBuf + _outputLength, buffer + written, toCopy);
+    _outputLength += toCopy;
+    written       += toCopy;
+
+    if (_outputLength == HTTP_OUTPUT_BUFLEN)
+      _flushOutput();
+  }
+
+  return written;
+#else
+  return _currentClient.write((const uint8_t *) buffer, length);
+#endif
+}
+
+////////////////////////////////////////
+
+// Write the parts to the client, in as few writes as possible: with the output buffer, they're gathered in it, to be
+// passed to the Ethernet chip together when it's flushed (on W5x00, by one burst to the socket TX buffer and one SEND
+// command). Without, consecutive small parts are gathered on the stack.
+// Override it to pass the parts to the chip without copying them, when its driver can
+size_t EthernetWebServer::_currentClientWritev(const ethernetWritePart* parts, uint8_t count)
+{
+  size_t written = 0;
+
+#if (HTTP_OUTPUT_BUFLEN > 0)
+  for (uint8_t i = 0; i < count; i++)
+  {
+    written += _currentClientWrite(parts[i].data, parts[i].length);
+  }
+#else
+  char    gather[HTTP_WRITEV_GATHER_LEN];
+  size_t  gatherLength = 0;
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    const ethernetWritePart& part = parts[i];
+
+    if ( gatherLength && (gatherLength + part.length > HTTP_WRITEV_GATHER_LEN) )
+    {
+      written      += _currentClientWrite(gather, gatherLength);
+      gatherLength  = 0;
+    }
+
+    if (part.length > HTTP_WRITEV_GATHER_LEN)
+    {
+      written += _currentClientWrite(part.data, part.length);
+    }
+    else
+    {
+      memcpy(gather + gatherLength, part.data, part.length);
+      gatherLength += part.length;
+    }
+  }
+
+  if (gatherLength)
+  {
+    written += _currentClientWrite(gather, gatherLength);
+  }
+#endif
+
+  return written;
+}
+
+////////////////////////////////////////
+
+void EthernetWebServer::_flushOutput()
+{
+#if (HTTP_OUTPUT_BUFLEN > 0)
+  if (_outputLength)
+  {
+    ET_LOGDEBUG1(F("_flushOutput: len ="), _outputLength);
+
+    _currentClient.write((const uint8_t *) _outputBuf, _outputLength);
+    _outputLength = 0;
+  }
+#endif
+}
+
+////////////////////////////////////////
+
+void EthernetWebServer::sendContent(const String& content)
+{
+  sendContent(content.c_str(), content.length());
+}
+
+////////////////////////////////////////
+
+void EthernetWebServer::sendContent(const String& content, size_t contentLength)
+{
+  sendContent(content.c_str(), contentLength);
+}
+
+////////////////////////////////////////
+
+// KH, Restore PROGMEM commands
+void EthernetWebServer::send_P(int code, PGM_P content_type, PGM_P content)
+{
+  send_P(code, content_type, content, content ? strlen_P(content) : 0);
+}
+
+////////////////////////////////////////
+
+void EthernetWebServer::send_P(int code, PGM_P content_type, PGM_P content, size_t contentLength)
+{
   char type[64];
 
   memccpy_P((void*)type, (PGM_VOID_P)content_type, 0, sizeof(type));
-  _prepareHeader(header, code, (const char* )type, contentLength);
 
   ET_LOGDEBUG1(F("send_P: len = "), contentLength);
-  ET_LOGDEBUG1(F("content = "), content);
-  ET_LOGDEBUG1(F("send_P: hdrlen = "), header.length());
-  ET_LOGDEBUG1(F("header = "), fromEWString(header));
 
-  _currentClient.write((const uint8_t *) header.c_str(), header.length());
+#if ETHERNET_PROGMEM_MAPPED
+  // Flash is read in place, the headers and the content are written together
+  send(code, (const char* )type, content, contentLength);
+#else
+  #if HTTP_COMPRESSION
+  bool complete = (_contentLength == CONTENT_LENGTH_NOT_SET);
+  #endif
+
+  size_t headerLength = _prepareHeader(code, (const char* )type, contentLength);
+
+  ET_LOGDEBUG1(F("send_P: hdrlen = "), headerLength);
+
+  _currentClientWrite(_responseHeaders, headerLength);
 
   if (contentLength)
   {
     sendContent_P(content, contentLength);
   }
+
+  #if HTTP_COMPRESSION
+  if (_compressing && complete)
+    _finishCompression();
+  #endif
+#endif
 }
 
 ////////////////////////////////////////
@@ -807,53 +1426,125 @@ void EthernetWebServer::sendContent_P(PGM_P content)
 
 void EthernetWebServer::sendContent_P(PGM_P content, size_t contentLength)
 {
-  const char * footer = RETURN_NEWLINE;
+#if ETHERNET_PROGMEM_MAPPED
+  // Flash is read in place
+  sendContent(content, contentLength);
+#else
+  if (_contentDropped)
+    return;
 
-  if (_chunked)
+  #if HTTP_COMPRESSION
+  if (_compressing)
   {
-    char chunkSize[11];
+    if (!contentLength)
+      _finishCompression();
 
-    ET_LOGDEBUG1(F("sendContent_P: _chunked, _currentVersion ="), _currentVersion);
+    // Copied through the stack to the encoder
+    while (contentLength)
+    {
+      char    buffer[SENDCONTENT_P_BUFFER_SZ];
+      size_t  toCopy = (contentLength < SENDCONTENT_P_BUFFER_SZ) ? contentLength : SENDCONTENT_P_BUFFER_SZ;
+
+      memcpy_P(buffer, content, toCopy);
+      _compress(buffer, toCopy);
 
-    sprintf(chunkSize, "%x%s", contentLength, footer);
-    _currentClient.write(chunkSize, strlen(chunkSize));
+      content       += toCopy;
+      contentLength -= toCopy;
+    }
+
+    return;
   }
+  #endif
 
-  uint8_t* _sendContentBuffer = new uint8_t[SENDCONTENT_P_BUFFER_SZ];
+  bool chunked = _chunked;
 
-  if (_sendContentBuffer)
+  if (chunked)
   {
-    uint16_t count = contentLength / SENDCONTENT_P_BUFFER_SZ;
-    uint16_t remainder = contentLength % SENDCONTENT_P_BUFFER_SZ;
-    uint16_t i = 0;
+    char chunkSize[12];
+
+    ET_LOGDEBUG1(F("sendContent_P: _chunked, _currentVersion ="), _currentVersion);
 
-    for (i = 0; i < count; i++)
+    _currentClientWrite(chunkSize, _chunkSizeLine(chunkSize, contentLength));
+
+    if (contentLength == 0)
     {
-      /* code */
-      memcpy_P(_sendContentBuffer, &content[i * SENDCONTENT_P_BUFFER_SZ], SENDCONTENT_P_BUFFER_SZ);
-      _currentClient.write(_sendContentBuffer, SENDCONTENT_P_BUFFER_SZ);
+      _chunked = false;
     }
+  }
 
-    memcpy_P(_sendContentBuffer, &content[i * SENDCONTENT_P_BUFFER_SZ], remainder);
-    _currentClient.write(_sendContentBuffer, remainder);
+  _currentClientWrite_P(content, contentLength);
 
-    delete [] _sendContentBuffer;
+  if (chunked)
+  {
+    _currentClientWrite(RETURN_NEWLINE, 2);
   }
-  else
+#endif
+}
+
+////////////////////////////////////////
+
+void EthernetWebServer::sendTemplate_P(int code, const char* content_type, PGM_P tmpl,
+                                       const ethernetTemplateRenderer::TProcessorFunction& processor)
+{
+  // The length is only known once the processor was called for each placeholder. HTTP/1.0 can't be chunked, and
+  // the end of the page is then marked by closing the connection
+  if (_contentLength == CONTENT_LENGTH_NOT_SET)
+    setContentLength(CONTENT_LENGTH_UNKNOWN);
+
+  send(code, content_type, "");
+
+  ethernetTemplateRenderer::TWriteFunction writer = [this](const char* data, size_t length)
   {
-    ET_LOGERROR1(F("sendContent_P: Error, can't allocate _sendContentBuffer, Sz ="), SENDCONTENT_P_BUFFER_SZ);
+    sendContent(data, length);
+  };
 
-    return;
-  }
+  size_t length = ethernetTemplateRenderer(processor, writer).render(tmpl);
+
+  ET_LOGDEBUG1(F("sendTemplate_P: len ="), length);
 
   if (_chunked)
   {
-    _currentClient.write(footer, 2);
+    // Last, empty chunk
+    sendContent("", 0);
+  }
+}
+
+////////////////////////////////////////
+
+#if !ETHERNET_PROGMEM_MAPPED
+
+// Copy PROGMEM content to the client, straight into the output buffer, or without output buffer through a small
+// buffer on the stack. Nothing is allocated
+void EthernetWebServer::_currentClientWrite_P(PGM_P content, size_t length)
+{
+  while (length)
+  {
+#if (HTTP_OUTPUT_BUFLEN > 0)
+    size_t toCopy = HTTP_OUTPUT_BUFLEN - _outputLength;
+
+    if (toCopy > length)
+      toCopy = length;
+
+    memcpy_P(_outputBuf + _outputLength, content, toCopy);
+    _outputLength += toCopy;
+
+    if (_outputLength == HTTP_OUTPUT_BUFLEN)
+      _flushOutput();
+#else
+    char    buffer[SENDCONTENT_P_BUFFER_SZ];
+    size_t  toCopy = (length < SENDCONTENT_P_BUFFER_SZ) ? length : SENDCONTENT_P_BUFFER_SZ;
+
+    memcpy_P(buffer, content, toCopy);
+    _currentClientWrite(buffer, toCopy);
+#endif
 
-    _chunked = false;
+    content += toCopy;
+    length  -= toCopy;
   }
 }
 
+#endif
+
 ////////////////////////////////////////
 
 #if (defined(ESP32) || defined(ESP8266))
@@ -891,11 +1582,10 @@ void EthernetWebServer::_streamFileCore(const size_t fileSize, const String &fil
 
 String EthernetWebServer::arg(const String& name)
 {
-  for (int i = 0; i < _currentArgCount; ++i)
-  {
-    if ( _currentArgs[i].key == name )
-      return _currentArgs[i].value;
-  }
+  int i = _argIndex(name);
+
+  if (i >= 0)
+    return _argValue(i);
 
   return String();
 }
@@ -904,8 +1594,10 @@ String EthernetWebServer::arg(const String& name)
 
 String EthernetWebServer::arg(int i)
 {
+  _parsePendingArguments();
+
   if (i < _currentArgCount)
-    return _currentArgs[i].value;
+    return _argValue(i);
 
   return String();
 }
@@ -914,6 +1606,8 @@ String EthernetWebServer::arg(int i)
 
 String EthernetWebServer::argName(int i)
 {
+  _parsePendingArguments();
+
   if (i < _currentArgCount)
     return _currentArgs[i].key;
 
@@ -924,6 +1618,8 @@ String EthernetWebServer::argName(int i)
 
 int EthernetWebServer::args()
 {
+  _parsePendingArguments();
+
   return _currentArgCount;
 }
 
@@ -931,25 +1627,159 @@ int EthernetWebServer::args()
 
 bool EthernetWebServer::hasArg(const String& name)
 {
-  for (int i = 0; i < _currentArgCount; ++i)
+  return (_argIndex(name) >= 0);
+}
+
+////////////////////////////////////////
+
+// FNV-1a hash of key, for the indexes of the arguments and of the collected headers
+uint32_t EthernetWebServer::_hashKey(const char* key, bool foldCase)
+{
+  uint32_t hash = 2166136261UL;
+
+  for ( ; *key; key++)
   {
-    if (_currentArgs[i].key == name)
-      return true;
+    uint8_t c = *key;
+
+    if ( foldCase && (c >= 'A') && (c <= 'Z') )
+      c += 'a' - 'A';
+
+    hash = (hash ^ c) * 16777619UL;
   }
 
-  return false;
+  return hash;
 }
 
 ////////////////////////////////////////
 
-String EthernetWebServer::header(const String& name)
+// Index the arguments of the request, the first one of each name being found first
+void EthernetWebServer::_buildArgIndex()
 {
-  for (int i = 0; i < _headerKeysCount; ++i)
+  _argIndexValid = true;
+  _argIndexCount = _currentArgCount;
+
+  if (_currentArgCount > HTTP_ARG_INDEX_SIZE / 2)
+    return;
+
+  memset(_argSlots, 0, sizeof(_argSlots));
+
+  for (int i = 0; i < _currentArgCount; i++)
   {
-    if (_currentHeaders[i].key == name)
-      return _currentHeaders[i].value;
+    uint16_t slot = _hashKey(_currentArgs[i].key, false) & (HTTP_ARG_INDEX_SIZE - 1);
+
+    while (_argSlots[slot])
+      slot = (slot + 1) & (HTTP_ARG_INDEX_SIZE - 1);
+
+    _argSlots[slot] = i + 1;
+  }
+}
+
+////////////////////////////////////////
+
+// Return the index of the first argument named name, or -1
+int EthernetWebServer::_argIndex(const String& name)
+{
+  _parsePendingArguments();
+
+  if (!_argIndexValid || (_argIndexCount != _currentArgCount))
+    _buildArgIndex();
+
+  if (_currentArgCount > HTTP_ARG_INDEX_SIZE / 2)
+  {
+    for (int i = 0; i < _currentArgCount; ++i)
+    {
+      if (name == _currentArgs[i].key)
+        return i;
+    }
+
+    return -1;
+  }
+
+  uint16_t slot = _hashKey(name.c_str(), false) & (HTTP_ARG_INDEX_SIZE - 1);
+
+  for ( ; _argSlots[slot]; slot = (slot + 1) & (HTTP_ARG_INDEX_SIZE - 1))
+  {
+    if (name == _currentArgs[_argSlots[slot] - 1].key)
+      return _argSlots[slot] - 1;
+  }
+
+  return -1;
+}
+
+////////////////////////////////////////
+
+const char* EthernetWebServer::pathArg(int i)
+{
+  if ( (i >= 0) && (i < _pathArgCount) )
+    return _viewToChars(_pathArgs[i]);
+
+  return "";
+}
+
+////////////////////////////////////////
+
+// The name is looked up in the route URI of the handler, "/api/{id}" gives "id" for pathArg(0)
+const char* EthernetWebServer::pathArg(const char* name)
+{
+  const char* route = nullptr;
+  bool inFlash = (_currentHandler == &_tableHandler);
+
+  if (inFlash)
+    route = _tableHandler.uri();
+  else if (_currentHandler && _currentHandler->routeUri())
+    route = _currentHandler->routeUri()->c_str();
+
+  if (!route)
+    return "";
+
+  int i = 0;
+  char c;
+
+  while ( (c = ethernetRouteChar(route++, inFlash)) )
+  {
+    if (c != '{')
+      continue;
+
+    const char* n = name;
+
+    while ( *n && (ethernetRouteChar(route, inFlash) == *n) )
+    {
+      route++;
+      n++;
+    }
+
+    if ( !*n && (ethernetRouteChar(route, inFlash) == '}') )
+      return pathArg(i);
+
+    i++;
   }
 
+  return "";
+}
+
+////////////////////////////////////////
+
+const char* EthernetWebServer::pathArg(const String& name)
+{
+  return pathArg(name.c_str());
+}
+
+////////////////////////////////////////
+
+int EthernetWebServer::pathArgs()
+{
+  return _pathArgCount;
+}
+
+////////////////////////////////////////
+
+String EthernetWebServer::header(const String& name)
+{
+  int i = _headerIndex(name.c_str());
+
+  if (i >= 0)
+    return _viewToString(_currentHeaders[i].value);
+
   return String();
 }
 
@@ -962,12 +1792,50 @@ void EthernetWebServer::collectHeaders(const char* headerKeys[], const size_t he
   if (_currentHeaders)
     delete[]_currentHeaders;
 
-  _currentHeaders = new RequestArgument[_headerKeysCount];
+  _currentHeaders = new RequestHeader[_headerKeysCount];
   _currentHeaders[0].key = ETHERNET_AUTHORIZATION_HEADER;
+  _currentHeaders[0].value = { 0, 0 };
 
   for (int i = 1; i < _headerKeysCount; i++)
   {
     _currentHeaders[i].key = headerKeys[i - 1];
+    _currentHeaders[i].value = { 0, 0 };
+  }
+
+  // Index the keys by their case-folded hash, with at least half of the slots free. Each header line received
+  // is then looked up in constant time
+  if (_headerSlots)
+    delete[] _headerSlots;
+
+  _headerSlots    = nullptr;
+  _headerSlotMask = 0;
+
+  if (_headerKeysCount > 255)
+    return;
+
+  uint16_t slotCount = 4;
+
+  while (slotCount < 2 * _headerKeysCount)
+    slotCount <<= 1;
+
+  _headerSlots = new uint8_t[slotCount];
+
+  if (!_headerSlots)
+    return;
+
+  _headerSlotMask = slotCount - 1;
+  memset(_headerSlots, 0, slotCount);
+
+  for (int i = 0; i < _headerKeysCount; i++)
+  {
+    _currentHeaders[i].hash = _hashKey(_currentHeaders[i].key.c_str(), true);
+
+    uint16_t slot = _currentHeaders[i].hash & _headerSlotMask;
+
+    while (_headerSlots[slot])
+      slot = (slot + 1) & _headerSlotMask;
+
+    _headerSlots[slot] = i + 1;
   }
 }
 
@@ -976,7 +1844,7 @@ void EthernetWebServer::collectHeaders(const char* headerKeys[], const size_t he
 String EthernetWebServer::header(int i)
 {
   if (i < _headerKeysCount)
-    return _currentHeaders[i].value;
+    return _viewToString(_currentHeaders[i].value);
 
   return String();
 }
@@ -1002,20 +1870,16 @@ int EthernetWebServer::headers()
 
 bool EthernetWebServer::hasHeader(const String& name)
 {
-  for (int i = 0; i < _headerKeysCount; ++i)
-  {
-    if ((_currentHeaders[i].key == name) &&  (_currentHeaders[i].value.length() > 0))
-      return true;
-  }
+  int i = _headerIndex(name.c_str());
 
-  return false;
+  return ( (i >= 0) && (_currentHeaders[i].value.length > 0) );
 }
 
 ////////////////////////////////////////
 
 String EthernetWebServer::hostHeader()
 {
-  return _hostHeader;
+  return _viewToString(_currentConnection->host);
 }
 
 ////////////////////////////////////////
@@ -1034,6 +1898,13 @@ void EthernetWebServer::onNotFound(THandlerFunction fn)
 
 ////////////////////////////////////////
 
+void EthernetWebServer::onExpectContinue(THandlerFunction fn)
+{
+  _expectContinueHandler = fn;
+}
+
+////////////////////////////////////////
+
 void EthernetWebServer::_handleRequest()
 {
   bool handled = false;
@@ -1077,12 +1948,15 @@ void EthernetWebServer::_handleRequest()
     _finalizeResponse();
   }
 
+  // The arguments and body of the request aren't needed anymore
+  _resetArena();
+
 #if ETHERNET_USE_PORTENTA_H7
   ET_LOGDEBUG(F("_handleRequest: Clear _currentUri"));
   //_currentUri = String();
   ET_LOGDEBUG(F("_handleRequest: Done Clear _currentUri"));
 #else
-  _responseHeaders = String("");
+  _responseHeadersLength = 0;
 #endif
 }
 
@@ -1090,141 +1964,39 @@ void EthernetWebServer::_handleRequest()
 
 void EthernetWebServer::_finalizeResponse()
 {
+#if HTTP_COMPRESSION
+  if (_compressing)
+  {
+    _finishCompression();
+  }
+#endif
+
   if (_chunked)
   {
     sendContent(String());
   }
+
+  _flushOutput();
 }
 
 ////////////////////////////////////////
 
 String EthernetWebServer::_responseCodeToString(int code)
 {
-  switch (code)
-  {
-    case 100:
-      return F("Continue");
-
-    case 101:
-      return F("Switching Protocols");
-
-    case 200:
-      return F("OK");
-
-    case 201:
-      return F("Created");
-
-    case 202:
-      return F("Accepted");
-
-    case 203:
-      return F("Non-Authoritative Information");
-
-    case 204:
-      return F("No Content");
-
-    case 205:
-      return F("Reset Content");
-
-    case 206:
-      return F("Partial Content");
-
-    case 300:
-      return F("Multiple Choices");
-
-    case 301:
-      return F("Moved Permanently");
-
-    case 302:
-      return F("Found");
-
-    case 303:
-      return F("See Other");
-
-    case 304:
-      return F("Not Modified");
-
-    case 305:
-      return F("Use Proxy");
-
-    case 307:
-      return F("Temporary Redirect");
+  size_t length;
+  PGM_P statusLine = ethernetStatus::find(code, length);
 
-    case 400:
-      return F("Bad Request");
+  if (!statusLine)
+    return String();
 
-    case 401:
-      return F("Unauthorized");
+  // Reason between "HTTP/1.1 ddd " and CRLF
+  char reason[ethernetStatus::maxLength];
 
-    case 402:
-      return F("Payment Required");
+  length -= ethernetStatus::reasonOffset + 2;
+  memcpy_P(reason, statusLine + ethernetStatus::reasonOffset, length);
+  reason[length] = 0;
 
-    case 403:
-      return F("Forbidden");
-
-    case 404:
-      return F("Not Found");
-
-    case 405:
-      return F("Method Not Allowed");
-
-    case 406:
-      return F("Not Acceptable");
-
-    case 407:
-      return F("Proxy Authentication Required");
-
-    case 408:
-      return F("Request Time-out");
-
-    case 409:
-      return F("Conflict");
-
-    case 410:
-      return F("Gone");
-
-    case 411:
-      return F("Length Required");
-
-    case 412:
-      return F("Precondition Failed");
-
-    case 413:
-      return F("Request Entity Too Large");
-
-    case 414:
-      return F("Request-URI Too Large");
-
-    case 415:
-      return F("Unsupported Media Type");
-
-    case 416:
-      return F("Requested range not satisfiable");
-
-    case 417:
-      return F("Expectation Failed");
-
-    case 500:
-      return F("Internal Server Error");
-
-    case 501:
-      return F("Not Implemented");
-
-    case 502:
-      return F("Bad Gateway");
-
-    case 503:
-      return F("Service Unavailable");
-
-    case 504:
-      return F("Gateway Time-out");
-
-    case 505:
-      return F("HTTP Version not supported");
-
-    default:
-      return "";
-  }
+  return String(reason);
 }
 
 ////////////////////////////////////////
@@ -213,12 +213,24 @@
 
 /////////////////////////////////////////////////////////////////////////
 
-// Permit redefinition of SENDCONTENT_P_BUFFER_SZ in sketch, default is 4K, minimum is 256 bytes
+// Permit redefinition of ETHERNET_PROGMEM_MAPPED in sketch. PROGMEM content is read in place and written to the client
+// as it is, unless flash has its own address space (AVR) or must be read by aligned words (ESP8266)
+#ifndef ETHERNET_PROGMEM_MAPPED
+  #if ( defined(__AVR__) || defined(ESP8266) )
+    #define ETHERNET_PROGMEM_MAPPED   false
+  #else
+    #define ETHERNET_PROGMEM_MAPPED   true
+  #endif
+#endif
+
+// Permit redefinition of SENDCONTENT_P_BUFFER_SZ in sketch. Where PROGMEM content isn't read in place, it's copied
+// into the output buffer, or without output buffer (HTTP_OUTPUT_BUFLEN 0) through a buffer of this size on the stack.
+// Default is 512 bytes for AVR, 1460 bytes for others, minimum is 256 bytes
 #ifndef SENDCONTENT_P_BUFFER_SZ
-  #define SENDCONTENT_P_BUFFER_SZ     4096
-  
-  #if (_ETHERNET_WEBSERVER_LOGLEVEL_ > 3)
-  	#warning SENDCONTENT_P_BUFFER_SZ using default 4 Kbytes
+  #if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+    #define SENDCONTENT_P_BUFFER_SZ   512
+  #else
+    #define SENDCONTENT_P_BUFFER_SZ   1460
   #endif
 #else
   #if (SENDCONTENT_P_BUFFER_SZ < 256)
@@ -237,6 +249,355 @@
 
 /////////////////////////////////////////////////////////////////////////
 
+// Permit redefinition of HTTP_REQUEST_BUFLEN in sketch. The buffer holds the request line and the headers kept
+// for the current request, and must be larger than the longest request line or header line to be accepted.
+// Default is 512 bytes for AVR, 1460 bytes for others, minimum is 128 bytes
+#ifndef HTTP_REQUEST_BUFLEN
+  #if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+    #define HTTP_REQUEST_BUFLEN       512
+  #else
+    #define HTTP_REQUEST_BUFLEN       1460
+  #endif
+#else
+  #if (HTTP_REQUEST_BUFLEN < 128)
+    #undef HTTP_REQUEST_BUFLEN
+    #define HTTP_REQUEST_BUFLEN       128
+
+    #if (_ETHERNET_WEBSERVER_LOGLEVEL_ > 3)
+      #warning HTTP_REQUEST_BUFLEN reset to min 128 bytes
+    #endif
+  #endif
+#endif
+
+// Permit redefinition of HTTP_MAX_READ_PER_LOOP in sketch. Maximum number of bytes read from the client and parsed
+// in one handleClient() call, to keep loop() responsive while a slow or large request is received.
+// Default is 512 bytes for AVR, 2048 bytes for others, minimum is 64 bytes
+#ifndef HTTP_MAX_READ_PER_LOOP
+  #if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+    #define HTTP_MAX_READ_PER_LOOP    512
+  #else
+    #define HTTP_MAX_READ_PER_LOOP    2048
+  #endif
+#else
+  #if (HTTP_MAX_READ_PER_LOOP < 64)
+    #undef HTTP_MAX_READ_PER_LOOP
+    #define HTTP_MAX_READ_PER_LOOP    64
+
+    #if (_ETHERNET_WEBSERVER_LOGLEVEL_ > 3)
+      #warning HTTP_MAX_READ_PER_LOOP reset to min 64 bytes
+    #endif
+  #endif
+#endif
+
+// Permit redefinition of HTTP_MAX_CONNECTIONS in sketch. Number of client connections served concurrently, each with
+// its own HTTP_REQUEST_BUFLEN buffer. More than 1 needs an Ethernet library providing EthernetServer::accept().
+// Default is 4 with Ethernet_Generic, but not more than MAX_SOCK_NUM - 1. Default is 1 for AVR and other libraries
+#ifndef HTTP_MAX_CONNECTIONS
+  #if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE || USE_UIP_ETHERNET || USE_CUSTOM_ETHERNET || \
+        USE_ETHERNET_ESP8266 || USE_ETHERNET_ENC || USE_NATIVE_ETHERNET || USE_QN_ETHERNET )
+    #define HTTP_MAX_CONNECTIONS      1
+  #else
+    #define HTTP_MAX_CONNECTIONS      4
+
+    #if ( defined(MAX_SOCK_NUM) && (MAX_SOCK_NUM <= HTTP_MAX_CONNECTIONS) )
+      #undef HTTP_MAX_CONNECTIONS
+      #define HTTP_MAX_CONNECTIONS    (MAX_SOCK_NUM - 1)
+    #endif
+  #endif
+#endif
+
+#if ( (HTTP_MAX_CONNECTIONS < 1) || !USE_NEW_WEBSERVER_VERSION )
+  #undef HTTP_MAX_CONNECTIONS
+  #define HTTP_MAX_CONNECTIONS        1
+#endif
+
+// Permit redefinition of HTTP_RESPONSE_HEADER_BUFLEN in sketch. The buffer holds the status line and the headers
+// of the response being prepared. Headers set with sendHeader() not fitting in it are dropped, with an error logged,
+// room being kept for Content-Length or Transfer-Encoding, Connection, and Vary and Content-Encoding if compressing.
+// Default is 256 bytes for AVR, 512 bytes for others, minimum is 192 bytes
+#ifndef HTTP_RESPONSE_HEADER_BUFLEN
+  #if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+    #define HTTP_RESPONSE_HEADER_BUFLEN   256
+  #else
+    #define HTTP_RESPONSE_HEADER_BUFLEN   512
+  #endif
+#else
+  #if (HTTP_RESPONSE_HEADER_BUFLEN < 192)
+    #undef HTTP_RESPONSE_HEADER_BUFLEN
+    #define HTTP_RESPONSE_HEADER_BUFLEN   192
+
+    #if (_ETHERNET_WEBSERVER_LOGLEVEL_ > 3)
+      #warning HTTP_RESPONSE_HEADER_BUFLEN reset to min 192 bytes
+    #endif
+  #endif
+#endif
+
+// Permit redefinition of HTTP_OUTPUT_BUFLEN in sketch. Size of the buffer collecting the status line, headers and
+// small pieces of content of a response, so that they are sent to the Ethernet chip in as few writes (and TCP
+// segments) as possible. It's flushed when full and at the end of the response. 0 disables the buffer.
+// Default is 0 for AVR, 1460 bytes (one full TCP segment) for others, minimum is 64 bytes if enabled
+#ifndef HTTP_OUTPUT_BUFLEN
+  #if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+    #define HTTP_OUTPUT_BUFLEN        0
+  #else
+    #define HTTP_OUTPUT_BUFLEN        1460
+  #endif
+#else
+  #if ( (HTTP_OUTPUT_BUFLEN > 0) && (HTTP_OUTPUT_BUFLEN < 64) )
+    #undef HTTP_OUTPUT_BUFLEN
+    #define HTTP_OUTPUT_BUFLEN        64
+
+    #if (_ETHERNET_WEBSERVER_LOGLEVEL_ > 3)
+      #warning HTTP_OUTPUT_BUFLEN reset to min 64 bytes
+    #endif
+  #endif
+#endif
+
+// Permit redefinition of HTTP_WRITEV_GATHER_LEN in sketch. Without output buffer (HTTP_OUTPUT_BUFLEN 0), size of the
+// stack buffer in which consecutive small parts of a response written together, such as the size line, data and
+// CRLF of a chunk, are gathered to be sent by one write. Default is 64 bytes, minimum is 16 bytes
+#ifndef HTTP_WRITEV_GATHER_LEN
+  #define HTTP_WRITEV_GATHER_LEN      64
+#else
+  #if (HTTP_WRITEV_GATHER_LEN < 16)
+    #undef HTTP_WRITEV_GATHER_LEN
+    #define HTTP_WRITEV_GATHER_LEN      16
+
+    #if (_ETHERNET_WEBSERVER_LOGLEVEL_ > 3)
+      #warning HTTP_WRITEV_GATHER_LEN reset to min 16 bytes
+    #endif
+  #endif
+#endif
+
+// Permit redefinition of HTTP_TEMPLATE_BUFLEN in sketch. Size of the buffer on the stack in which sendTemplate_P()
+// gathers the text and values of a page, each full buffer being sent as one piece (one chunk).
+// Default is 128 bytes for AVR, 512 bytes for others, minimum is 32 bytes
+#ifndef HTTP_TEMPLATE_BUFLEN
+  #if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+    #define HTTP_TEMPLATE_BUFLEN      128
+  #else
+    #define HTTP_TEMPLATE_BUFLEN      512
+  #endif
+#else
+  #if (HTTP_TEMPLATE_BUFLEN < 32)
+    #undef HTTP_TEMPLATE_BUFLEN
+    #define HTTP_TEMPLATE_BUFLEN      32
+
+    #if (_ETHERNET_WEBSERVER_LOGLEVEL_ > 3)
+      #warning HTTP_TEMPLATE_BUFLEN reset to min 32 bytes
+    #endif
+  #endif
+#endif
+
+// Permit redefinition of HTTP_KEEPALIVE_TIMEOUT in sketch. Time in ms a persistent (keep-alive) connection is kept
+// open, waiting for the next request. Default is 5000 ms, 0 disables keep-alive
+#ifndef HTTP_KEEPALIVE_TIMEOUT
+  #define HTTP_KEEPALIVE_TIMEOUT      5000
+#endif
+
+// Permit redefinition of HTTP_MAX_KEEPALIVE_REQUESTS in sketch. Maximum number of requests served on one
+// connection before it is closed. Default is 100, 1 disables keep-alive
+#ifndef HTTP_MAX_KEEPALIVE_REQUESTS
+  #define HTTP_MAX_KEEPALIVE_REQUESTS 100
+#endif
+
+// Permit redefinition of HTTP_MAX_PATH_ARGS in sketch. Maximum number of "{name}" path segments of a route URI,
+// such as "/api/sensor/{id}/value", returned by pathArg(). Default is 4 for AVR, 8 for others
+#ifndef HTTP_MAX_PATH_ARGS
+  #if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+    #define HTTP_MAX_PATH_ARGS        4
+  #else
+    #define HTTP_MAX_PATH_ARGS        8
+  #endif
+#endif
+
+// Permit redefinition of HTTP_ARG_INDEX_SIZE in sketch. Slots of the hash index of the request arguments, built on
+// the first arg(name) or hasArg(name) of a request. Requests with more than half as many arguments are searched
+// linearly. Must be a power of 2, default is 16 for AVR, 64 for others, maximum is 256
+#ifndef HTTP_ARG_INDEX_SIZE
+  #if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+    #define HTTP_ARG_INDEX_SIZE       16
+  #else
+    #define HTTP_ARG_INDEX_SIZE       64
+  #endif
+#else
+  #if ( (HTTP_ARG_INDEX_SIZE < 2) || (HTTP_ARG_INDEX_SIZE > 256) || (HTTP_ARG_INDEX_SIZE & (HTTP_ARG_INDEX_SIZE - 1)) )
+    #error HTTP_ARG_INDEX_SIZE must be a power of 2, from 2 to 256
+  #endif
+#endif
+
+// Permit redefinition of HTTP_REQUEST_ARENA_SIZE in sketch. Size of the arena holding the arguments of the request
+// being handled, their decoded keys and values, and its body, all released at once at the end of the request.
+// Default is 256 bytes for AVR, 2048 bytes for others, minimum is 64 bytes. See arenaStats() for sizing
+#ifndef HTTP_REQUEST_ARENA_SIZE
+  #if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+    #define HTTP_REQUEST_ARENA_SIZE   256
+  #else
+    #define HTTP_REQUEST_ARENA_SIZE   2048
+  #endif
+#else
+  #if (HTTP_REQUEST_ARENA_SIZE < 64)
+    #undef HTTP_REQUEST_ARENA_SIZE
+    #define HTTP_REQUEST_ARENA_SIZE   64
+
+    #if (_ETHERNET_WEBSERVER_LOGLEVEL_ > 3)
+      #warning HTTP_REQUEST_ARENA_SIZE reset to min 64 bytes
+    #endif
+  #endif
+#endif
+
+// Permit redefinition of HTTP_REQUEST_ARENA_FALLBACK in sketch. What is allocated for a request once its arena is
+// full: 1 to take it from the heap, freed with the arena at the end of the request, 0 to drop the argument (or
+// reject the body) with an error logged. Default is 1
+#ifndef HTTP_REQUEST_ARENA_FALLBACK
+  #define HTTP_REQUEST_ARENA_FALLBACK 1
+#endif
+
+// Permit redefinition of HTTP_UPLOAD_ZERO_COPY in sketch. true to pass the content of an uploaded file to the upload
+// handler as slices of the request buffer, upload().data and upload().currentSize, valid only during the call.
+// upload().buf, the HTTP_UPLOAD_BUFLEN bytes the content is otherwise copied into, is then left out.
+// Only with USE_NEW_WEBSERVER_VERSION. Default is false
+#ifndef HTTP_UPLOAD_ZERO_COPY
+  #define HTTP_UPLOAD_ZERO_COPY       false
+#endif
+
+#if ( HTTP_UPLOAD_ZERO_COPY && !USE_NEW_WEBSERVER_VERSION )
+  #undef HTTP_UPLOAD_ZERO_COPY
+  #define HTTP_UPLOAD_ZERO_COPY       false
+
+  #if (_ETHERNET_WEBSERVER_LOGLEVEL_ > 3)
+    #warning HTTP_UPLOAD_ZERO_COPY not supported without USE_NEW_WEBSERVER_VERSION
+  #endif
+#endif
+
+// Permit redefinition of HTTP_JSON_MAX_DEPTH, HTTP_JSON_PATH_LEN and HTTP_JSON_VALUE_LEN in sketch. Limits of the
+// JSON bodies of routes registered with onJson(): nesting of objects and arrays, length of the path of a value such
+// as "wifi.ssid", and length of a key or value, longer strings being cut. Defaults are 8, 64 and 64 bytes for AVR,
+// 16, 128 and 256 bytes for others. Minimum lengths are 16 bytes
+#ifndef HTTP_JSON_MAX_DEPTH
+  #if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+    #define HTTP_JSON_MAX_DEPTH       8
+  #else
+    #define HTTP_JSON_MAX_DEPTH       16
+  #endif
+#endif
+
+#ifndef HTTP_JSON_PATH_LEN
+  #if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+    #define HTTP_JSON_PATH_LEN        64
+  #else
+    #define HTTP_JSON_PATH_LEN        128
+  #endif
+#else
+  #if (HTTP_JSON_PATH_LEN < 16)
+    #undef HTTP_JSON_PATH_LEN
+    #define HTTP_JSON_PATH_LEN        16
+
+    #if (_ETHERNET_WEBSERVER_LOGLEVEL_ > 3)
+      #warning HTTP_JSON_PATH_LEN reset to min 16 bytes
+    #endif
+  #endif
+#endif
+
+#ifndef HTTP_JSON_VALUE_LEN
+  #if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+    #define HTTP_JSON_VALUE_LEN       64
+  #else
+    #define HTTP_JSON_VALUE_LEN       256
+  #endif
+#else
+  #if (HTTP_JSON_VALUE_LEN < 16)
+    #undef HTTP_JSON_VALUE_LEN
+    #define HTTP_JSON_VALUE_LEN       16
+
+    #if (_ETHERNET_WEBSERVER_LOGLEVEL_ > 3)
+      #warning HTTP_JSON_VALUE_LEN reset to min 16 bytes
+    #endif
+  #endif
+#endif
+
+// Permit redefinition of HTTP_CHUNK_LINE_LEN in sketch. Longest line accepted in a chunked request body, other than
+// its data: the size of a chunk with its extensions, or a trailer. Longer lines fail the request.
+// Default is 64 bytes for AVR, 256 bytes for others, minimum is 16 bytes
+#ifndef HTTP_CHUNK_LINE_LEN
+  #if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+    #define HTTP_CHUNK_LINE_LEN       64
+  #else
+    #define HTTP_CHUNK_LINE_LEN       256
+  #endif
+#else
+  #if (HTTP_CHUNK_LINE_LEN < 16)
+    #undef HTTP_CHUNK_LINE_LEN
+    #define HTTP_CHUNK_LINE_LEN       16
+
+    #if (_ETHERNET_WEBSERVER_LOGLEVEL_ > 3)
+      #warning HTTP_CHUNK_LINE_LEN reset to min 16 bytes
+    #endif
+  #endif
+#endif
+
+// Permit redefinition of HTTP_COMPRESSION in sketch. true to build in the deflate encoder, which compresses text
+// responses for clients accepting gzip or deflate once enableCompression() is called.
+// Default is false for AVR, true for others
+#ifndef HTTP_COMPRESSION
+  #if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+    #define HTTP_COMPRESSION          false
+  #else
+    #define HTTP_COMPRESSION          true
+  #endif
+#endif
+
+// Permit redefinition of HTTP_DEFLATE_WINDOW_BITS, HTTP_DEFLATE_HASH_BITS and HTTP_DEFLATE_OUTPUT_BUFLEN in sketch.
+// The encoder takes 2^(WINDOW_BITS + 1) + 2^(HASH_BITS + 1) + OUTPUT_BUFLEN bytes, allocated by enableCompression():
+// a larger window finds more matches, a larger hash table keeps more of them. Each OUTPUT_BUFLEN bytes of compressed
+// output are sent as one chunk.
+// Defaults are 8, 8 and 128 for AVR (1.2 KB), 11, 10 and 512 for others (6.5 KB). The window is 8 to 14 bits, the
+// hash table 6 to 14 bits, the output buffer 64 bytes minimum
+#ifndef HTTP_DEFLATE_WINDOW_BITS
+  #if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+    #define HTTP_DEFLATE_WINDOW_BITS    8
+  #else
+    #define HTTP_DEFLATE_WINDOW_BITS    11
+  #endif
+#elif ( (HTTP_DEFLATE_WINDOW_BITS < 8) || (HTTP_DEFLATE_WINDOW_BITS > 14) )
+  #error HTTP_DEFLATE_WINDOW_BITS must be from 8 to 14
+#endif
+
+#ifndef HTTP_DEFLATE_HASH_BITS
+  #if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+    #define HTTP_DEFLATE_HASH_BITS      8
+  #else
+    #define HTTP_DEFLATE_HASH_BITS      10
+  #endif
+#elif ( (HTTP_DEFLATE_HASH_BITS < 6) || (HTTP_DEFLATE_HASH_BITS > 14) )
+  #error HTTP_DEFLATE_HASH_BITS must be from 6 to 14
+#endif
+
+#ifndef HTTP_DEFLATE_OUTPUT_BUFLEN
+  #if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+    #define HTTP_DEFLATE_OUTPUT_BUFLEN  128
+  #else
+    #define HTTP_DEFLATE_OUTPUT_BUFLEN  512
+  #endif
+#else
+  #if (HTTP_DEFLATE_OUTPUT_BUFLEN < 64)
+    #undef HTTP_DEFLATE_OUTPUT_BUFLEN
+    #define HTTP_DEFLATE_OUTPUT_BUFLEN  64
+
+    #if (_ETHERNET_WEBSERVER_LOGLEVEL_ > 3)
+      #warning HTTP_DEFLATE_OUTPUT_BUFLEN reset to min 64 bytes
+    #endif
+  #endif
+#endif
+
+// Permit redefinition of HTTP_COMPRESS_MIN_LENGTH in sketch. Content sent at once by send() shorter than this is
+// sent as it is, compression not paying for the gzip framing and the chunks. Default is 256 bytes
+#ifndef HTTP_COMPRESS_MIN_LENGTH
+  #define HTTP_COMPRESS_MIN_LENGTH    256
+#endif
+
+/////////////////////////////////////////////////////////////////////////
+
 // New definitions only when not using ESP32 WebServer.h
 #if !(( defined(ESP32) || defined(ESP8266) ) && (__has_include("WebServer.h") || __has_include("ESP8266WebServer.h")) )
 
@@ -331,10 +692,125 @@ typedef struct
   size_t  totalSize;      // file size
   size_t  currentSize;    // size of data currently in buf
   size_t  contentLength;  // size of entire post request, file size + headers and other request data.
+  const uint8_t* data;    // currentSize bytes of content for UPLOAD_FILE_WRITE: buf, or a slice of the request buffer
+#if !HTTP_UPLOAD_ZERO_COPY
   uint8_t buf[HTTP_UPLOAD_BUFLEN];
+#endif
 } ethernetHTTPUpload;
 
+enum HTTPBodyStatus
+{
+  BODY_START,
+  BODY_WRITE,
+  BODY_END,
+  BODY_ABORTED
+};
+
+// Body of a request to a route registered with onBody(), passed to its body handler as it's received
+typedef struct
+{
+  HTTPBodyStatus  status;
+  const uint8_t*  data;           // currentSize bytes of the body for BODY_WRITE, valid only during the call
+  size_t          currentSize;
+  size_t          totalSize;      // body bytes passed so far
+  size_t          contentLength;  // size of the whole body, 0 if it's sent chunked
+  const char*     contentType;    // Content-Type of the request, "" if none
+} ethernetHTTPBody;
+
+// Piece of a response passed to sendParts(), or written by _currentClientWritev()
+typedef struct
+{
+  const char* data;
+  size_t      length;
+} ethernetWritePart;
+
+/////////////////////////////////////////////////////////////////////////
+
+// Parser progress, kept across handleClient() calls so that a request can arrive in several pieces
+enum HTTPParserState
+{
+  HP_REQUEST_LINE,
+  HP_HEADERS,
+  HP_BEGIN,             // Headers complete, waiting for the request of another connection to complete
+  HP_BODY,              // Plain or urlencoded body
+  HP_BODY_STREAM,       // Body passed to the body handler of the route as it's received
+  HP_FORM_START,        // Multipart body, before the first boundary
+  HP_FORM_HEADERS,      // Headers of a part
+  HP_FORM_VALUE,        // Value of a form field
+  HP_FORM_FILE,         // Content of an uploaded file
+  HP_FORM_BOUNDARY,     // Rest of the line after the boundary ending a file
+  HP_DONE
+};
+
+// Progress of the decoding of a body sent with "Transfer-Encoding: chunked"
+enum HTTPChunkState
+{
+  CHUNK_SIZE,           // Line with the size of the next chunk
+  CHUNK_DATA,           // Data of a chunk
+  CHUNK_DATA_END,       // CRLF ending the data of a chunk
+  CHUNK_TRAILER,        // Trailer lines, after the last chunk
+  CHUNK_DONE
+};
+
+// Token kept in place, and NUL-terminated, inside ethernetHTTPConnection.buf
+typedef struct
+{
+  uint16_t offset;
+  uint16_t length;
+} ethernetHTTPView;
+
+// State of one client connection. Header lines kept are stored as "name\0value\0" from headersStart to bodyBase
+typedef struct
+{
+  EthernetClient    client;
+  HTTPClientStatus  status;
+  unsigned long     statusChange;   // when the status changed, or data was last received
+  HTTPParserState   state;
+  uint16_t          length;         // bytes held in buf
+  uint16_t          lineStart;      // start of the line not yet parsed
+  uint16_t          headersStart;   // first header line kept, after the request line
+  uint16_t          readPos;        // next unread body byte, body bytes are read together with the headers
+  uint16_t          bodyBase;       // body bytes are buffered after the headers kept, from here to the end of buf
+  ethernetHTTPView  method;
+  ethernetHTTPView  uri;
+  ethernetHTTPView  query;
+  ethernetHTTPView  version;
+  ethernetHTTPView  host;
+  ethernetHTTPView  contentType;
+  ethernetHTTPView  boundary;       // multipart boundary, inside the Content-Type value
+  uint32_t          contentLength;
+  bool              lengthInvalid;  // Content-Length not a decimal number fitting in contentLength, answered with 400
+  uint32_t          bodyRemaining;  // body bytes not parsed yet, UINT32_MAX until the last chunk of a chunked body
+  uint32_t          chunkRemaining; // data bytes of the current chunk not decoded yet
+  uint32_t          chunkedLength;  // data bytes of the chunked body decoded so far
+  uint16_t          chunkEnd;       // end of the chunked body bytes decoded in place, their framing removed
+  HTTPChunkState    chunkState;
+  bool              chunked;        // "Transfer-Encoding: chunked" body
+  bool              transferUnknown;  // other Transfer-Encoding, answered with 501
+#if HTTP_COMPRESSION
+  uint8_t           acceptEncoding; // HTTPContentEncoding bits of the codings the client accepts
+#endif
+  uint16_t          requestCount;   // requests already served on this connection
+  bool              keepAlive;      // client accepts a persistent connection
+  bool              expectContinue; // "Expect: 100-continue", the client waits for it before sending the body
+  bool              expectUnknown;  // Expect header with another expectation, answered with 417
+  uint8_t           formMatch;      // bytes of the boundary delimiter matched at the end of the file content
+  uint8_t           formRetry;      // empty lines skipped before the first boundary
+  bool              isEncoded;      // application/x-www-form-urlencoded body
+  bool              formIsFile;     // current part is a file
+  bool              formPartial;    // last value line was longer than the buffer, and continues
+  char              buf[HTTP_REQUEST_BUFLEN + 1];   // +1 to NUL-terminate the last line of the body in place
+} ethernetHTTPConnection;
+
 #include "detail/RequestHandler.h"
+#include "detail/RequestRouter.h"
+#include "detail/RequestArena.h"
+#include "detail/JsonParser.h"
+#include "detail/TemplateRenderer.h"
+
+#if HTTP_COMPRESSION
+  #include "detail/DeflateEncoder.h"
+#endif
 
 #if (defined(ESP32) || defined(ESP8266))
   #include "FS.h"
@@ -364,10 +840,19 @@ class EthernetWebServer
     void on(const String &uri, THandlerFunction handler);
     void on(const String &uri, HTTPMethod method, THandlerFunction fn);
     void on(const String &uri, HTTPMethod method, THandlerFunction fn, THandlerFunction ufn);
+    void onBody(const String &uri, HTTPMethod method, THandlerFunction fn, THandlerFunction bfn);
+    void onJson(const String &uri, HTTPMethod method, THandlerFunction fn, THandlerFunction vfn);
     void addHandler(ethernetRequestHandler* handler);
+
+    // Routes of a const table in flash (PROGMEM), matched in order before the handlers added with on()
+    void setRouteTable(const ethernetRoute* routes, uint16_t routeCount);
     void onNotFound(THandlerFunction fn);  //called when handler is not assigned
     void onFileUpload(THandlerFunction fn); //handle file uploads
 
+    // Called once the headers of a request with "Expect: 100-continue" are received, before its body. fn may answer
+    // the request, with requestAuthentication() for example, and its body isn't read. Else "100 Continue" is sent
+    void onExpectContinue(THandlerFunction fn);
+
     String uri()
     {
       return _currentUri;
@@ -380,6 +865,9 @@ class EthernetWebServer
 
     EthernetClient client()
     {
+      // The sketch may write to the client directly, after what was sent through the server
+      _flushOutput();
+
       return _currentClient;
     }
 
@@ -395,12 +883,78 @@ class EthernetWebServer
     }
 #endif
 
+    // Body of the request being received, for the body handler of a route registered with onBody()
+    ethernetHTTPBody& body()
+    {
+      return _currentBody;
+    }
+
+    // Value of the JSON body just parsed, for the value handler of a route registered with onJson()
+    const ethernetJsonValue& jsonValue()
+    {
+      return _jsonParser->value();
+    }
+
+    // JSON_OK once the whole JSON body of the request was parsed, for the request handler of a route registered
+    // with onJson()
+    HTTPJsonError jsonError()
+    {
+      return _jsonParser ? _jsonParser->error() : JSON_INCOMPLETE;
+    }
+
+    ethernetJsonParser& jsonParser()
+    {
+      return *_jsonParser;
+    }
+
+    // Answer requests whose Content-Length is more than maxLength with 413, before reading their body. 0, the
+    // default, accepts any length
+    void setMaxBodyLength(uint32_t maxLength)
+    {
+      _maxBodyLength = maxLength;
+    }
+
     String arg(const String& name);        // get request argument value by name
     String arg(int i);              // get request argument value by number
     String argName(int i);          // get request argument name by number
 
     int args();                     // get arguments count
     bool hasArg(const String& name);       // check if argument exists
+
+    // Use of the request arena over all requests, to size HTTP_REQUEST_ARENA_SIZE
+    const ethernetArenaStats& arenaStats()
+    {
+      return _arena.stats();
+    }
+
+    void resetArenaStats()
+    {
+      _arena.resetStats();
+    }
+
+#if HTTP_COMPRESSION
+    // Compress text responses with gzip or deflate, for clients accepting them. The encoder is allocated by the
+    // first call, see HTTP_DEFLATE_WINDOW_BITS
+    void enableCompression(bool value = true);
+
+    // Use of the deflate encoder over all responses
+    ethernetDeflateStats compressionStats()
+    {
+      return _deflate ? _deflate->stats() : ethernetDeflateStats();
+    }
+
+    void resetCompressionStats()
+    {
+      if (_deflate)
+        _deflate->resetStats();
+    }
+#endif
+
+    // Path segments matching the "{name}" segments of the route URI, NUL-terminated in the request buffer
+    const char* pathArg(int i);                   // get path argument value by number
+    const char* pathArg(const char* name);        // get path argument value by name in the route URI
+    const char* pathArg(const String& name);
+    int pathArgs();                               // get path arguments count
     void collectHeaders(const char* headerKeys[], const size_t headerKeysCount); // set the request headers to collect
     String header(const String& name);      // get request header value by name
     String header(int i);              // get request header value by number
@@ -453,6 +1007,16 @@ class EthernetWebServer
 
 		// New
     void sendContent(const char* content, size_t contentLength);
+
+    // Send the parts one after the other as one piece of content (one chunk if the response is chunked), without
+    // first copying them together
+    void sendParts(const ethernetWritePart* parts, uint8_t count);
+
+    template<size_t N>
+    void sendParts(const ethernetWritePart (&parts)[N])
+    {
+      sendParts(parts, N);
+    }
     //////
     
     // KH, Restore PROGMEM commands
@@ -461,6 +1025,12 @@ class EthernetWebServer
 
     void sendContent_P(PGM_P content);
     void sendContent_P(PGM_P content, size_t size);
+
+    // Send the PROGMEM template tmpl, its %NAME% placeholders replaced with what processor returns for NAME, as it's
+    // rendered, without building the page in RAM. It's sent chunked to HTTP/1.1 clients, unless setContentLength()
+    // was called. HTTP/1.0 clients get it without Content-Length, and the connection is closed at its end
+    void sendTemplate_P(int code, const char* content_type, PGM_P tmpl,
+                        const ethernetTemplateRenderer::TProcessorFunction& processor);
     //////
 
     static String urlDecode(const String& text);
@@ -478,6 +1048,7 @@ class EthernetWebServer
       }
 
       send(200, contentType, "");
+      _flushOutput();
 
       return _currentClient.write(file);
     }
@@ -504,6 +1075,7 @@ class EthernetWebServer
     size_t streamFile(T &file, const String& contentType, const int code = 200)
       {
 				_streamFileCore(file.size(), file.name(), contentType, code);
+				_flushOutput();
 				
     		return _currentClient.write(file);     
       }
@@ -516,38 +1088,122 @@ class EthernetWebServer
   
   	////////////////////////////////////////
   
-		virtual size_t _currentClientWrite(const char* buffer, size_t length) 
-		{ 
-			return _currentClient.write( buffer, length ); 
-		}
+		virtual size_t _currentClientWrite(const char* buffer, size_t length);
+		virtual size_t _currentClientWritev(const ethernetWritePart* parts, uint8_t count);
+		void _flushOutput();
+#if !ETHERNET_PROGMEM_MAPPED
+		void _currentClientWrite_P(PGM_P content, size_t length);
+#endif
+		void _sendParts(const char* header, size_t headerLength, const ethernetWritePart* parts, uint8_t count);
+		static uint8_t _chunkSizeLine(char* line, size_t contentLength);
+#if HTTP_COMPRESSION
+		HTTPContentEncoding _responseEncoding(int code, const char* content_type, size_t contentLength);
+		void _compress(const char* content, size_t contentLength);
+		void _finishCompression();
+		static void _deflateWrite(void* server, const uint8_t* data, size_t length);
+#endif
 
 		////////////////////////////////////////
 	
     void _addRequestHandler(ethernetRequestHandler* handler);
     void _handleRequest();
     void _finalizeResponse();
-    bool _parseRequest(EthernetClient& client);
+    void _resetRequest();
+    int  _parseRequestHead(ethernetHTTPConnection& conn);
+    bool _parseRequestLine(ethernetHTTPConnection& conn, char* line, char* lineEnd);
+    char* _parseHeaderLine(ethernetHTTPConnection& conn, char* line, char* lineEnd);
+    void _beginRequest();
+    void _setHeaderValues(ethernetHTTPConnection& conn);
+    bool _findTableRoute();
 
     //KH
 #if USE_NEW_WEBSERVER_VERSION
-    void _parseArguments(const String& data);
+    EthernetClient _acceptClient();
+    bool _handleConnection(ethernetHTTPConnection& conn);
+    void _releaseRequest();
+    int  _parseRequest(EthernetClient& client);
+    void _prepareNextRequest();
+    int  _fillBuffer(EthernetClient& client, size_t maxLength);
+    int  _beginRequestBody();
+    int  _parseRequestBody();
+    int  _parseBodyStream();
+    bool _parseBodyAborted();
+    void _rejectRequest(int code);
+    bool _checkExpectation();
+    int  _decodeChunks();
+    int  _parseFormBody();
+    bool _parseFormFile();
+    void _uploadWrite(const char* data, size_t length);
+    int  _readBodyLine(char*& line);
+    bool _finishForm();
+    void _parseArguments();
+    void _parseArguments(char* data, size_t length, bool inPlace);
     int  _parseArgumentsPrivate(const String& data, vl::Func<void(String&, String&, const String&, int, int, int, int)> handler);
-    bool _parseForm(EthernetClient& client, const String& boundary, uint32_t len);
 #else
+    bool _parseRequest(EthernetClient& client);
+    bool _readRequestHead(EthernetClient& client);
+    int  _clientAvailable(EthernetClient& client);
+    int  _clientRead(EthernetClient& client);
+    int  _clientTimedRead(EthernetClient& client);
+    void _clientReadLine(EthernetClient& client, String& line);
     void _parseArguments(const String& data);
     bool _parseForm(EthernetClient& client, const String& boundary, uint32_t len);
+    uint8_t _uploadReadByte(EthernetClient& client);
+    void _uploadWriteByte(uint8_t b);
 #endif
 
     static String _responseCodeToString(int code);
     bool _parseFormUploadAborted();
-    void _uploadWriteByte(uint8_t b);
-    uint8_t _uploadReadByte(EthernetClient& client);
-    void _prepareHeader(String& response, int code, const char* content_type, size_t contentLength);
+    bool _appendHeader(const char* name, const char* value, bool first = false, size_t reserveLength = 0);
+    bool _appendHeader(const char* name, size_t value);
+    bool _insertStatusLine(int code);
+    size_t _prepareHeader(int code, const char* content_type, size_t contentLength);
+    bool _reserveArgs(int count);
+    void _resetArena();
+    const char* _argValue(int i);
+    int  _headerIndex(const char* headerName);
+    int  _argIndex(const String& name);
+    void _buildArgIndex();
+    static uint32_t _hashKey(const char* key, bool foldCase);
+
+    ////////////////////////////////////////
+
+    inline String _viewToString(const ethernetHTTPView& view)
+    {
+      return view.length ? String(_currentConnection->buf + view.offset) : String();
+    }
+
+    ////////////////////////////////////////
 
-#if ! ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
-    void _prepareHeader(EWString& response, int code, const char* content_type, size_t contentLength);
+    inline const char* _viewToChars(const ethernetHTTPView& view)
+    {
+      return view.length ? _currentConnection->buf + view.offset : "";
+    }
+
+    ////////////////////////////////////////
+
+    // Parse the arguments of the request if it's not done yet
+    inline void _parsePendingArguments()
+    {
+#if USE_NEW_WEBSERVER_VERSION
+      if (_argsPending)
+        _parseArguments();
 #endif
-    bool _collectHeader(const char* headerName, const char* headerValue);
+    }
+
+    ////////////////////////////////////////
+
+    // Body bytes held in the buffer of the current connection, not parsed yet. Those of a chunked body once decoded
+    inline uint16_t _bodyBuffered()
+    {
+      ethernetHTTPConnection& conn = *_currentConnection;
+
+      uint16_t avail = (conn.chunked ? conn.chunkEnd : conn.length) - conn.readPos;
+
+      return (avail < conn.bodyRemaining) ? avail : conn.bodyRemaining;
+    }
+
+    ////////////////////////////////////////
 
 #if (defined(ESP32) || defined(ESP8266))
     void _streamFileCore(const size_t fileSize, const String & fileName, const String & contentType, const int code = 200);
@@ -562,7 +1218,7 @@ class EthernetWebServer
       // read up to sizeof(buffer) bytes
       while ((bytesRead = file.readBytes(buffer, sizeof(buffer))) > 0)
       {
-        _currentClient.write(buffer, bytesRead);
+        _currentClientWrite(buffer, bytesRead);
         contentLength += bytesRead;
       }
 
@@ -570,10 +1226,22 @@ class EthernetWebServer
     }
 #endif
 
+    // Key and value are NUL-terminated strings, in the request or _arena. Until the value of a query or urlencoded
+    // argument is read, encoded is set and value points to its rawLength chars still URL-encoded
     struct RequestArgument
     {
-      String key;
-      String value;
+      const char* key;
+      const char* value;
+      size_t      rawLength;
+      bool        encoded;
+      bool        inPlace;      // value decoded over its raw chars, else into _arena
+    };
+
+    struct RequestHeader
+    {
+      String            key;
+      uint32_t          hash;             // of key, case-folded
+      ethernetHTTPView  value;
     };
     
     bool    					_corsEnabled;
@@ -592,28 +1260,72 @@ class EthernetWebServer
     ethernetRequestHandler*   _currentHandler   = nullptr;
     ethernetRequestHandler*   _firstHandler   	= nullptr;
     ethernetRequestHandler*   _lastHandler   		= nullptr;
+    ethernetRequestRouter     _router;
+    const ethernetRoute*      _routeTable       = nullptr;
+    uint16_t                  _routeTableCount  = 0;
+    ethernetTableRequestHandler _tableHandler;
+    ethernetHTTPView          _pathArgs[HTTP_MAX_PATH_ARGS];
+    uint8_t                   _pathArgCount     = 0;
     THandlerFunction  				_notFoundHandler;
     THandlerFunction  				_fileUploadHandler;
+    THandlerFunction          _expectContinueHandler;
 
     int               _currentArgCount;
     RequestArgument*  _currentArgs   						= nullptr;
+    int               _currentArgsCapacity;     // arguments _currentArgs has room for, in _arena
+    uint8_t           _argSlots[HTTP_ARG_INDEX_SIZE];   // open addressing index of _currentArgs, index + 1 or 0
+    int               _argIndexCount    = 0;    // _currentArgCount when _argSlots was built
+    bool              _argIndexValid    = false;
+    ethernetRequestArena  _arena;               // what is allocated for the request, released at its end
+    ethernetHTTPBody  _currentBody;
+    uint32_t          _maxBodyLength    = 0;    // 0 for any length, see setMaxBodyLength()
+    ethernetJsonParser*   _jsonParser     = nullptr;    // allocated by the first onJson()
+
+#if HTTP_COMPRESSION
+    ethernetDeflateEncoder* _deflate      = nullptr;    // allocated by enableCompression()
+    bool              _compressionEnabled = false;
+    bool              _compressing      = false;    // content of the response goes through _deflate
+#endif
 
     //KH
 #if USE_NEW_WEBSERVER_VERSION
     ethernetHTTPUpload*   _currentUpload   			= nullptr;
     int                   _postArgsLen;
-    RequestArgument*      _postArgs   					= nullptr;
+    RequestArgument*      _postArgs   					= nullptr;     // form arguments, in _arena
+    size_t                _postValueLength;       // of the form value being read
+    char*                 _plainBuf             = nullptr;     // body, in _arena
+    bool                  _argsPending          = false;       // query and urlencoded body not parsed yet
+    char*                 _pendingQuery         = nullptr;     // in the buffer of the connection
+    size_t                _pendingQueryLength   = 0;
+    size_t                _pendingBodyLength    = 0;           // of the urlencoded body in _plainBuf, or 0
 #else
     ethernetHTTPUpload    _currentUpload;
 #endif
 
     int               _headerKeysCount;
-    RequestArgument*  _currentHeaders   				= nullptr;
+    RequestHeader*    _currentHeaders   				= nullptr;
+    uint8_t*          _headerSlots              = nullptr;    // open addressing index of _currentHeaders
+    uint16_t          _headerSlotMask           = 0;
     size_t            _contentLength;
     int              	_clientContentLength;				// "Content-Length" from header of incoming POST or GET request
-    String            _responseHeaders;
-    String            _hostHeader;
+    char              _responseHeaders[HTTP_RESPONSE_HEADER_BUFLEN + 1];   // +1 to NUL-terminate for logging
+    uint16_t          _responseHeadersLength;
     bool              _chunked;
+    bool              _keepAlive;               // response sent with "Connection: keep-alive"
+    bool              _responseStarted;         // status line and headers of the response prepared
+    bool              _contentDropped;          // a 500 sent instead of the response, its framing headers not fitting
+
+#if (HTTP_OUTPUT_BUFLEN > 0)
+    char              _outputBuf[HTTP_OUTPUT_BUFLEN];
+    uint16_t          _outputLength;            // bytes of the response waiting in _outputBuf
+#endif
+
+    ethernetHTTPConnection  _connections[HTTP_MAX_CONNECTIONS];
+    ethernetHTTPConnection* _currentConnection;     // connection being served
+    ethernetHTTPConnection* _requestOwner;          // connection whose request uses the state above, until answered
+    unsigned long           _requestSince;          // when _requestOwner started its body
+    bool                    _requestWaiting;        // another connection waits for _requestOwner to be answered
+    uint8_t                 _nextConnection;        // first connection served by the next handleClient()
 };
 
 /////////////////////////////////////////////////////////////////////////
@@ -39,6 +39,7 @@
 #define ETHERNET_WEBSERVER_PARSING_IMPL_H
 
 #include <Arduino.h>
+#include <errno.h>
 #include "EthernetWebServer.hpp"
 
 #ifndef WEBSERVER_MAX_POST_ARGS
@@ -48,41 +49,7 @@
 ////////////////////////////////////////
 
 // KH
-#if USE_NEW_WEBSERVER_VERSION
-
-////////////////////////////////////////
-
-static bool readBytesWithTimeout(EthernetClient& client, size_t maxLength, String& data, int timeout_ms)
-{
-  if (!data.reserve(maxLength + 1))
-    return false;
-
-  data[0] = 0;  // data.clear()??
-
-  while (data.length() < maxLength)
-  {
-    int tries = timeout_ms;
-    size_t avail;
-
-    while (!(avail = client.available()) && tries--)
-      delay(1);
-
-    if (!avail)
-      break;
-
-    if (data.length() + avail > maxLength)
-      avail = maxLength - data.length();
-
-    while (avail--)
-      data += (char)client.read();
-  }
-
-  return data.length() == maxLength;
-}
-
-////////////////////////////////////////
-
-#else
+#if !USE_NEW_WEBSERVER_VERSION
 
 ////////////////////////////////////////
 
@@ -143,100 +110,601 @@ static char* readBytesWithTimeout(EthernetClient& client, size_t maxLength, size
 
 ////////////////////////////////////////
 
+#endif    // #if !USE_NEW_WEBSERVER_VERSION
+
+////////////////////////////////////////
+
+static inline void setHTTPView(ethernetHTTPView& view, const ethernetHTTPConnection& conn, const char* start,
+                               const char* end)
+{
+  view.offset = start - conn.buf;
+  view.length = end - start;
+}
+
+////////////////////////////////////////
+
+static inline bool strStartsWith(const char* str, const char* prefix)
+{
+  return (strncmp(str, prefix, strlen(prefix)) == 0);
+}
+
+////////////////////////////////////////
+
+// Return true if the comma separated list in a header value contains token, ignoring case
+static bool headerHasToken(const char* value, const char* token)
+{
+  size_t tokenLen = strlen(token);
+
+  while (*value)
+  {
+    while ( (*value == ' ') || (*value == '\t') || (*value == ',') )
+      value++;
+
+    const char* end = value;
+
+    while (*end && (*end != ','))
+      end++;
+
+    const char* tokenEnd = end;
+
+    while ( (tokenEnd > value) && ( (tokenEnd[-1] == ' ') || (tokenEnd[-1] == '\t') ) )
+      tokenEnd--;
+
+    if ( ((size_t) (tokenEnd - value) == tokenLen) && (strncasecmp(value, token, tokenLen) == 0) )
+      return true;
+
+    value = end;
+  }
+
+  return false;
+}
+
+////////////////////////////////////////
+
+#if HTTP_COMPRESSION
+
+// HTTPContentEncoding bits of the codings of an Accept-Encoding value the response can be compressed with: those
+// listed without "q=0", and with "*" those not listed
+static uint8_t acceptedEncodings(const char* value)
+{
+  uint8_t accepted  = ENCODING_NONE;
+  uint8_t listed    = ENCODING_NONE;
+  bool    any       = false;
+
+  while (*value)
+  {
+    while ( (*value == ' ') || (*value == '\t') || (*value == ',') )
+      value++;
+
+    const char* end = value;
+
+    while (*end && (*end != ','))
+      end++;
+
+    const char* tokenEnd = value;
+
+    while ( (tokenEnd < end) && (*tokenEnd != ';') && (*tokenEnd != ' ') && (*tokenEnd != '\t') )
+      tokenEnd++;
+
+    size_t  tokenLen  = tokenEnd - value;
+    uint8_t coding    = ENCODING_NONE;
+    bool    isAny     = false;
+
+    if ( ((tokenLen == 4) && (strncasecmp(value, "gzip", 4) == 0)) ||
+         ((tokenLen == 6) && (strncasecmp(value, "x-gzip", 6) == 0)) )
+      coding = ENCODING_GZIP;
+    else if ( (tokenLen == 7) && (strncasecmp(value, "deflate", 7) == 0) )
+      coding = ENCODING_DEFLATE;
+    else if ( (tokenLen == 1) && (*value == '*') )
+      isAny = true;
+
+    // A q-value of 0, as "q=0" or "q=0.000", refuses the coding
+    bool refused = false;
+
+    for (const char* param = tokenEnd; param < end; param++)
+    {
+      if (*param != ';')
+        continue;
+
+      param++;
+
+      while ( (param < end) && ( (*param == ' ') || (*param == '\t') ) )
+        param++;
+
+      if ( (end - param < 3) || ( (param[0] != 'q') && (param[0] != 'Q') ) || (param[1] != '=') )
+        continue;
+
+      const char* q = param + 2;
+
+      refused = (*q == '0');
+
+      for (q++; refused && (q < end) && (*q != ';') && (*q != ' ') && (*q != '\t'); q++)
+        refused = (*q == '.') || (*q == '0');
+    }
+
+    listed |= coding;
+
+    if (!refused)
+    {
+      accepted |= coding;
+      any      |= isAny;
+    }
+
+    value = end;
+  }
+
+  if (any)
+    accepted |= (ENCODING_GZIP | ENCODING_DEFLATE) & ~listed;
+
+  return accepted;
+}
+
+#endif
+
+////////////////////////////////////////
+
+// Value of the ASCII hex digits, 0xFF for other chars
+static const uint8_t hexDigitValues[128] PROGMEM =
+{
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+////////////////////////////////////////
+
+static inline uint8_t hexDigitValue(char c)
+{
+  return (c & 0x80) ? 0xFF : pgm_read_byte(&hexDigitValues[(uint8_t) c]);
+}
+
+////////////////////////////////////////
+
+#if !defined(__AVR__)
+
+// Non-zero if any byte of the 4 bytes of word is '%' or '+'
+static inline uint32_t hasEscapeByte(uint32_t word)
+{
+  uint32_t percent  = word ^ 0x25252525UL;
+  uint32_t plus     = word ^ 0x2B2B2B2BUL;
+
+  return ( ((percent - 0x01010101UL) & ~percent) | ((plus - 0x01010101UL) & ~plus) ) & 0x80808080UL;
+}
+
+#endif
+
+////////////////////////////////////////
+
+// Decode the length chars of src into dest, which may be src as the decoded string is never longer. Return its
+// length. "%XX" is the value of the hex digits leading XX, 0 if none, and '+' is a space.
+// Runs of chars without '%' or '+' are found 4 bytes at a time except on AVR, and moved at once, or not at all
+// while decoding in place before the first escape
+static size_t urlDecodeChars(char* dest, const char* src, size_t length)
+{
+  char* start = dest;
+  const char* end = src + length;
+
+  while (src < end)
+  {
+    const char* run = src;
+
+#if !defined(__AVR__)
+    while (end - src >= 4)
+    {
+      uint32_t word;
+
+      memcpy(&word, src, 4);
+
+      if (hasEscapeByte(word))
+        break;
+
+      src += 4;
+    }
+#endif
+
+    while ( (src < end) && (*src != '%') && (*src != '+') )
+      src++;
+
+    if (dest != run)
+      memmove(dest, run, src - run);
+
+    dest += src - run;
+
+    if (src == end)
+      break;
+
+    char c = *src++;
+
+    if ( (c == '%') && (src + 1 < end) )
+    {
+      uint8_t high  = hexDigitValue(src[0]);
+      uint8_t low   = hexDigitValue(src[1]);
+
+      c = (high == 0xFF) ? 0 : ( (low == 0xFF) ? high : (high << 4) | low );
+      src += 2;
+    }
+    else if (c == '+')
+    {
+      c = ' ';
+    }
+
+    *dest++ = c;
+  }
+
+  return dest - start;
+}
+
+////////////////////////////////////////
+
+#if USE_NEW_WEBSERVER_VERSION
+
+////////////////////////////////////////
+
+// Number of key=value pairs data may hold
+static int argumentCount(const char* data, size_t length)
+{
+  if (length == 0)
+    return 0;
+
+  int count = 1;
+
+  for (const char* amp = data; (amp = (const char *) memchr(amp, '&', data + length - amp)); amp++)
+    count++;
+
+  return count;
+}
+
+////////////////////////////////////////
+
 #endif    // #if USE_NEW_WEBSERVER_VERSION
 
 ////////////////////////////////////////
 
-bool EthernetWebServer::_parseRequest(EthernetClient& client)
+// Start parsing a new request on the current connection
+void EthernetWebServer::_resetRequest()
 {
-  // Read the first line of HTTP request
-  String req = client.readStringUntil('\r');
-  client.readStringUntil('\n');
+  ethernetHTTPConnection& conn = *_currentConnection;
+
+  conn.state          = HP_REQUEST_LINE;
+  conn.length         = 0;
+  conn.lineStart      = 0;
+  conn.headersStart   = 0;
+  conn.readPos        = 0;
+  conn.bodyBase       = 0;
+  conn.method         = { 0, 0 };
+  conn.uri            = { 0, 0 };
+  conn.query          = { 0, 0 };
+  conn.version        = { 0, 0 };
+  conn.host           = { 0, 0 };
+  conn.contentType    = { 0, 0 };
+  conn.boundary       = { 0, 0 };
+  conn.contentLength  = 0;
+  conn.lengthInvalid  = false;
+  conn.bodyRemaining  = 0;
+  conn.chunkRemaining = 0;
+  conn.chunkedLength  = 0;
+  conn.chunkEnd       = 0;
+  conn.chunkState     = CHUNK_SIZE;
+  conn.chunked        = false;
+  conn.transferUnknown  = false;
+#if HTTP_COMPRESSION
+  conn.acceptEncoding = ENCODING_NONE;
+#endif
+  conn.formMatch      = 0;
+  conn.formRetry      = 0;
+  conn.isEncoded      = false;
+  conn.formIsFile     = false;
+  conn.formPartial    = false;
+  conn.keepAlive      = false;
+  conn.expectContinue = false;
+  conn.expectUnknown  = false;
+}
 
-  //reset header value
-  for (int i = 0; i < _headerKeysCount; ++i)
+////////////////////////////////////////
+
+// Return 1 when the empty line ending the headers is reached, 0 if more data is needed, -1 on error
+int EthernetWebServer::_parseRequestHead(ethernetHTTPConnection& conn)
+{
+  while (conn.state < HP_BEGIN)
   {
-    _currentHeaders[i].value = String();
+    char* line    = conn.buf + conn.lineStart;
+    char* lineEnd = (char *) memchr(line, '\n', conn.length - conn.lineStart);
+
+    if (!lineEnd)
+    {
+      if (conn.length == HTTP_REQUEST_BUFLEN)
+      {
+        ET_LOGDEBUG1(F("_parseRequestHead: Line too long, HTTP_REQUEST_BUFLEN ="), HTTP_REQUEST_BUFLEN);
+
+        return -1;
+      }
+
+      return 0;
+    }
+
+    uint16_t next = (lineEnd - conn.buf) + 1;
+
+    if ( (lineEnd > line) && (lineEnd[-1] == '\r') )
+      lineEnd--;
+
+    if ( (conn.state == HP_REQUEST_LINE) && (lineEnd != line) )
+    {
+      if (!_parseRequestLine(conn, line, lineEnd))
+        return -1;
+
+      conn.lineStart    = next;
+      conn.headersStart = next;
+      conn.state        = HP_HEADERS;
+
+      continue;
+    }
+
+    if (conn.state == HP_HEADERS)
+    {
+      if (lineEnd == line)
+      {
+        // Empty line, end of headers. The body follows, from bodyBase
+        memmove(line, conn.buf + next, conn.length - next);
+        conn.length  -= next - conn.lineStart;
+        conn.readPos  = conn.lineStart;
+        conn.bodyBase = conn.lineStart;
+        conn.chunkEnd = conn.lineStart;
+        conn.state    = HP_BEGIN;
+
+        continue;
+      }
+
+      char* recordEnd = _parseHeaderLine(conn, line, lineEnd);
+
+      if (recordEnd)
+      {
+        // Keep the header as "name\0value\0", and reuse the rest of the line
+        uint16_t end = recordEnd - conn.buf;
+
+        memmove(recordEnd, conn.buf + next, conn.length - next);
+        conn.length    -= next - end;
+        conn.lineStart  = end;
+
+        continue;
+      }
+    }
+
+    // Empty line before the request line, or header not needed. Reuse its space
+    memmove(line, conn.buf + next, conn.length - next);
+    conn.length -= next - conn.lineStart;
   }
 
-  // First line of HTTP request looks like "GET /path HTTP/1.1"
+  return 1;
+}
+
+////////////////////////////////////////
+
+bool EthernetWebServer::_parseRequestLine(ethernetHTTPConnection& conn, char* line, char* lineEnd)
+{
+  // First line of HTTP request looks like "GET /path?search HTTP/1.1"
   // Retrieve the "/path" part by finding the spaces
-  int addr_start  = req.indexOf(' ');
-  int addr_end    = req.indexOf(' ', addr_start + 1);
+  char* addrStart = (char *) memchr(line, ' ', lineEnd - line);
+  char* addrEnd   = addrStart ? (char *) memchr(addrStart + 1, ' ', lineEnd - addrStart - 1) : nullptr;
 
-  if (addr_start == -1 || addr_end == -1)
+  *lineEnd = 0;
+
+  if (!addrEnd)
   {
-    ET_LOGDEBUG1(F("_parseRequest: Invalid request: "), req);
+    ET_LOGDEBUG1(F("_parseRequest: Invalid request: "), line);
 
     return false;
   }
 
-  String methodStr  = req.substring(0, addr_start);
-  String url        = req.substring(addr_start + 1, addr_end);
-  String versionEnd = req.substring(addr_end + 8);
-  _currentVersion   = 0;
-  String searchStr  = "";
-  int hasSearch     = url.indexOf('?');
+  char* search = (char *) memchr(addrStart + 1, '?', addrEnd - addrStart - 1);
+
+  *addrStart  = 0;
+  *addrEnd    = 0;
+
+  setHTTPView(conn.method,  conn, line,           addrStart);
+  setHTTPView(conn.version, conn, addrEnd + 1,    lineEnd);
+
+  // HTTP/1.1 connections are persistent, unless "Connection: close" is received
+  conn.keepAlive = (strcmp(addrEnd + 1, "HTTP/1.1") == 0);
+
+  if (search)
+  {
+    *search = 0;
+
+    setHTTPView(conn.uri,   conn, addrStart + 1,  search);
+    setHTTPView(conn.query, conn, search + 1,     addrEnd);
+  }
+  else
+  {
+    setHTTPView(conn.uri,   conn, addrStart + 1,  addrEnd);
+  }
+
+  return true;
+}
+
+////////////////////////////////////////
+
+// If the header has to be kept, rewrite the line in place as "name\0value\0" and return the end of it.
+// Return nullptr if the line can be dropped
+char* EthernetWebServer::_parseHeaderLine(ethernetHTTPConnection& conn, char* line, char* lineEnd)
+{
+  char* headerDiv = (char *) memchr(line, ':', lineEnd - line);
+
+  if (!headerDiv)
+  {
+    return nullptr;
+  }
+
+  char* value = headerDiv + 1;
+
+  while ( (value < lineEnd) && ( (*value == ' ') || (*value == '\t') ) )
+    value++;
+
+  while ( (lineEnd > value) && ( (lineEnd[-1] == ' ') || (lineEnd[-1] == '\t') ) )
+    lineEnd--;
+
+  // Value moved right after the name
+  size_t valueLen = lineEnd - value;
+
+  *headerDiv  = 0;
+  memmove(headerDiv + 1, value, valueLen);
+  value       = headerDiv + 1;
+  lineEnd     = value + valueLen;
+  *lineEnd    = 0;
+
+  ethernetHTTPView headerValue;
+
+  setHTTPView(headerValue, conn, value, lineEnd);
+
+  ET_LOGDEBUG1(F("headerName: "), line);
+  ET_LOGDEBUG1(F("headerValue: "), value);
+
+  bool keep = (_headerIndex(line) >= 0);
+
+  if (strcasecmp(line, "Content-Type") == 0)
+  {
+    conn.contentType = headerValue;
+    keep = true;
+  }
+  else if (strcasecmp(line, "Content-Length") == 0)
+  {
+    // Only digits: strtoul() would also take a sign or spaces, and clamps what overflows to ULONG_MAX
+    char* end;
+
+    errno = 0;
+    unsigned long length = strtoul(value, &end, 10);
 
-  if (hasSearch != -1)
+    if ( !isdigit((unsigned char) *value) || (end != lineEnd) || (errno == ERANGE) || (length != (uint32_t) length) )
+      conn.lengthInvalid = true;
+    else
+      conn.contentLength = length;
+  }
+  else if (strcasecmp(line, "Host") == 0)
+  {
+    conn.host = headerValue;
+    keep = true;
+  }
+  else if (strcasecmp(line, "Connection") == 0)
+  {
+    if (headerHasToken(value, "close"))
+      conn.keepAlive = false;
+    else if (headerHasToken(value, "keep-alive"))
+      conn.keepAlive = true;
+  }
+  else if (strcasecmp(line, "Transfer-Encoding") == 0)
+  {
+    // Only chunked is decoded, a body compressed or otherwise encoded can't be read
+    if (strcasecmp(value, "chunked") == 0)
+      conn.chunked = true;
+    else
+      conn.transferUnknown = true;
+  }
+  else if (strcasecmp(line, "Expect") == 0)
+  {
+    if (strcasecmp(value, "100-continue") == 0)
+      conn.expectContinue = true;
+    else
+      conn.expectUnknown = true;
+  }
+#if HTTP_COMPRESSION
+  else if (strcasecmp(line, "Accept-Encoding") == 0)
   {
-    searchStr = url.substring(hasSearch + 1);
-    url = url.substring(0, hasSearch);
+    conn.acceptEncoding = acceptedEncodings(value);
   }
+#endif
+
+  return keep ? lineEnd + 1 : nullptr;
+}
 
-  _currentUri = url;
+
+////////////////////////////////////////
+
+// Set the method, URI, version and handler of the request from its request line and headers
+void EthernetWebServer::_beginRequest()
+{
+  ethernetHTTPConnection& conn = *_currentConnection;
+
+  const char* methodStr   = conn.buf + conn.method.offset;
+  const char* versionStr  = conn.buf + conn.version.offset;
+
+  // "HTTP/1.1" => 1, "HTTP/1.0" => 0
+  _currentVersion = 0;
+
+  if ( (conn.version.length == 8) && strStartsWith(versionStr, "HTTP/1.") )
+    _currentVersion = versionStr[7] - '0';
+
+  _resetArena();
+
+  _currentUri = conn.buf + conn.uri.offset;
   _chunked = false;
+  _responseStarted = false;
+  _contentDropped = false;
+#if HTTP_COMPRESSION
+  _compressing = false;
+#endif
+
+  // The length of a chunked body is only known once it's received, whatever the Content-Length header says
+  if (conn.chunked)
+    conn.contentLength = 0;
+
+  _clientContentLength = conn.contentLength;
+
+  _setHeaderValues(conn);
 
   HTTPMethod method = HTTP_GET;
 
   // KH
 #if USE_NEW_WEBSERVER_VERSION
 
-  if (methodStr == "HEAD")
+  if (strcmp(methodStr, "HEAD") == 0)
   {
     method = HTTP_HEAD;
   }
-  else if (methodStr == "POST")
+  else if (strcmp(methodStr, "POST") == 0)
   {
     method = HTTP_POST;
   }
-  else if (methodStr == "DELETE")
+  else if (strcmp(methodStr, "DELETE") == 0)
   {
     method = HTTP_DELETE;
   }
-  else if (methodStr == "OPTIONS")
+  else if (strcmp(methodStr, "OPTIONS") == 0)
   {
     method = HTTP_OPTIONS;
   }
-  else if (methodStr == "PUT")
+  else if (strcmp(methodStr, "PUT") == 0)
   {
     method = HTTP_PUT;
   }
-  else if (methodStr == "PATCH")
+  else if (strcmp(methodStr, "PATCH") == 0)
   {
     method = HTTP_PATCH;
   }
 
 #else    // #if USE_NEW_WEBSERVER_VERSION
 
-  if (methodStr == "POST")
+  if (strcmp(methodStr, "POST") == 0)
   {
     method = HTTP_POST;
   }
-  else if (methodStr == "DELETE")
+  else if (strcmp(methodStr, "DELETE") == 0)
   {
 
     method = HTTP_DELETE;
   }
-  else if (methodStr == "OPTIONS")
+  else if (strcmp(methodStr, "OPTIONS") == 0)
   {
     method = HTTP_OPTIONS;
   }
-  else if (methodStr == "PUT")
+  else if (strcmp(methodStr, "PUT") == 0)
   {
     method = HTTP_PUT;
   }
-  else if (methodStr == "PATCH")
+  else if (strcmp(methodStr, "PATCH") == 0)
   {
     method = HTTP_PATCH;
   }
@@ -244,201 +712,883 @@ bool EthernetWebServer::_parseRequest(EthernetClient& client)
 #endif    // #if USE_NEW_WEBSERVER_VERSION
 
   _currentMethod = method;
+  _keepAlive = false;
 
-  ET_LOGDEBUG1(F("method: "), methodStr);
-  ET_LOGDEBUG1(F("url: "), url);
-  ET_LOGDEBUG1(F("search: "), searchStr);
+  // KH
+#if USE_NEW_WEBSERVER_VERSION
+
+  // Close the connection after the last request allowed on it. Also after HEAD, as the handler may send a body
+  if ( (HTTP_KEEPALIVE_TIMEOUT == 0) || (conn.requestCount + 1 >= HTTP_MAX_KEEPALIVE_REQUESTS)
+       || (method == HTTP_HEAD) )
+  {
+    conn.keepAlive = false;
+  }
+
+#else
+
+  conn.keepAlive = false;
+
+#endif
+
+  ET_LOGDEBUG1(F("method: "), methodStr);
+  ET_LOGDEBUG1(F("url: "), _currentUri);
+  ET_LOGDEBUG1(F("search: "), _viewToChars(conn.query));
 
   //attach handler
-  ethernetRequestHandler* handler;
+  if (!_findTableRoute())
+    _currentHandler = _router.find(_firstHandler, _currentMethod, _currentUri, _pathArgs, _pathArgCount);
 
-  for (handler = _firstHandler; handler; handler = handler->next())
+  // Path arguments are left in place in the URI, _currentUri holding a copy of it
+  for (uint8_t i = 0; i < _pathArgCount; i++)
   {
-    if (handler->canHandle(_currentMethod, _currentUri))
-      break;
+    _pathArgs[i].offset += conn.uri.offset;
+    conn.buf[_pathArgs[i].offset + _pathArgs[i].length] = 0;
   }
+}
 
-  _currentHandler = handler;
+////////////////////////////////////////
+
+// Look for the first route of the table in flash accepting the request, and attach _tableHandler to it
+bool EthernetWebServer::_findTableRoute()
+{
+  for (uint16_t i = 0; i < _routeTableCount; i++)
+  {
+    const ethernetRoute* entry = &_routeTable[i];
 
-  String formData;
+    // Only the methods of a route are read from flash, then its URI if they accept the request
+    if (!ethernetTableRequestHandler::acceptsMethod(pgm_read_dword(&entry->methods), _currentMethod))
+      continue;
 
-  // below is needed only when POST type request
-  if (method == HTTP_POST || method == HTTP_PUT || method == HTTP_PATCH || method == HTTP_DELETE)
+    PGM_P uri;
+
+    memcpy_P(&uri, &entry->uri, sizeof(uri));
+
+    int count = ethernetMatchRoute(uri, _currentUri.c_str(), _pathArgs, HTTP_MAX_PATH_ARGS, true);
+
+    if (count < 0)
+      continue;
+
+    ethernetRoute route;
+
+    memcpy_P(&route, entry, sizeof(route));
+
+    _tableHandler.route(route);
+
+    _pathArgCount   = (count > HTTP_MAX_PATH_ARGS) ? HTTP_MAX_PATH_ARGS : count;
+    _currentHandler = &_tableHandler;
+
+    return true;
+  }
+
+  return false;
+}
+
+////////////////////////////////////////
+
+// Point the collected headers to the header lines kept in the buffer of the connection
+void EthernetWebServer::_setHeaderValues(ethernetHTTPConnection& conn)
+{
+  for (int i = 0; i < _headerKeysCount; ++i)
   {
-    String boundaryStr;
-    String headerName;
-    String headerValue;
+    _currentHeaders[i].value = { 0, 0 };
+  }
+
+  char* name  = conn.buf + conn.headersStart;
+  char* end   = conn.buf + conn.bodyBase;
+
+  while (name < end)
+  {
+    char* value     = name + strlen(name) + 1;
+    size_t valueLen = strlen(value);
+    int index       = _headerIndex(name);
+
+    if (index >= 0)
+      setHTTPView(_currentHeaders[index].value, conn, value, value + valueLen);
+
+    name = value + valueLen + 1;
+  }
+}
+
+////////////////////////////////////////
 
+//KH
 #if USE_NEW_WEBSERVER_VERSION
-    bool isEncoded  = false;
-#endif
 
-    bool isForm     = false;
-    uint32_t contentLength = 0;
+////////////////////////////////////////
 
-    //parse headers
-    while (1)
+// Parse what the client has sent so far, reading at most HTTP_MAX_READ_PER_LOOP bytes and never waiting for more.
+// The progress is kept in the current connection between calls.
+// Return 1 when the request is complete, 0 if more data is needed, -1 on error
+int EthernetWebServer::_parseRequest(EthernetClient& client)
+{
+  ethernetHTTPConnection& conn = *_currentConnection;
+  size_t budget = HTTP_MAX_READ_PER_LOOP;
+
+  while ( (conn.state != HP_DONE) || conn.bodyRemaining )
+  {
+    int res;
+
+    if (conn.state < HP_BEGIN)
     {
-      req = client.readStringUntil('\r');
-      client.readStringUntil('\n');
+      res = _parseRequestHead(conn);
+    }
+    else if (conn.state == HP_BEGIN)
+    {
+      // The request state is shared by all connections. Only one request at a time is read past its headers
+      if (_requestOwner && (_requestOwner != &conn))
+        return 0;
 
-      if (req == "")
-        break;//no more headers
+      _requestOwner = &conn;
+      _requestSince = millis();
 
-      int headerDiv = req.indexOf(':');
+      _beginRequest();
+      res = _beginRequestBody();
+    }
+    else
+    {
+      res = conn.chunked ? _decodeChunks() : 0;
 
-      if (headerDiv == -1)
+      if ( (res == 0) && _maxBodyLength && (conn.chunkedLength > _maxBodyLength) )
       {
-        break;
+        ET_LOGDEBUG1(F("_parseRequest: Chunked body too large, length ="), conn.chunkedLength);
+
+        _rejectRequest(413);
+
+        res = -1;
       }
 
-      headerName  = req.substring(0, headerDiv);
-      headerValue = req.substring(headerDiv + 1);
+      if (res == 0)
+        res = _parseRequestBody();
+    }
 
-      headerValue.trim();
-      _collectHeader(headerName.c_str(), headerValue.c_str());
+    if (res < 0)
+      return -1;
 
-      ET_LOGDEBUG1(F("headerName: "), headerName);
-      ET_LOGDEBUG1(F("headerValue: "), headerValue);
+    if (res > 0)
+      continue;
 
-      if (headerName.equalsIgnoreCase("Content-Type"))
-      {
-        using namespace mime;
+    // Everything buffered is parsed, read more if the client already sent it
+    int len = budget ? _fillBuffer(client, budget) : 0;
 
-        if (headerValue.startsWith(mimeTable[txt].mimeType))
-        {
-          isForm = false;
-        }
-        else if (headerValue.startsWith("application/x-www-form-urlencoded"))
-        {
-          isForm = false;
-#if USE_NEW_WEBSERVER_VERSION
-          isEncoded = true;
-#endif
-        }
-        else if (headerValue.startsWith("multipart/"))
+    if (len <= 0)
+      return 0;
+
+    budget -= len;
+    conn.statusChange = millis();
+  }
+
+  // Not flushed, the bytes already received after the request are the next one. See _prepareNextRequest()
+
+  ET_LOGDEBUG1(F("Request:"), _currentUri);
+  ET_LOGDEBUG1(F("Arguments:"), _viewToChars(conn.query));
+
+  return 1;
+}
+
+////////////////////////////////////////
+
+// Read the bytes already received, without waiting, into the free space of the connection buffer.
+// While parsing the body, the bytes not parsed yet are first moved back to the start of the body window
+int EthernetWebServer::_fillBuffer(EthernetClient& client, size_t maxLength)
+{
+  ethernetHTTPConnection& conn = *_currentConnection;
+
+  if ( (conn.state >= HP_BODY) && (conn.readPos > conn.bodyBase) )
+  {
+    memmove(conn.buf + conn.bodyBase, conn.buf + conn.readPos, conn.length - conn.readPos);
+    conn.length   -= conn.readPos - conn.bodyBase;
+    conn.chunkEnd -= conn.readPos - conn.bodyBase;
+    conn.readPos   = conn.bodyBase;
+  }
+
+  size_t avail = client.available();
+  size_t space = HTTP_REQUEST_BUFLEN - conn.length;
+
+  if (avail > space)
+    avail = space;
+
+  if (avail > maxLength)
+    avail = maxLength;
+
+  if (!avail)
+    return 0;
+
+  int len = client.read((uint8_t *) conn.buf + conn.length, avail);
+
+  if (len > 0)
+    conn.length += len;
+
+  return len;
+}
+
+////////////////////////////////////////
+
+// Called after the response was sent with "Connection: keep-alive", to get ready for the next request on the same
+// connection. Bytes received after the body are the start of the next request, pipelined by the client, and are kept
+// to be parsed first
+void EthernetWebServer::_prepareNextRequest()
+{
+  ethernetHTTPConnection& conn = *_currentConnection;
+
+  uint16_t next       = conn.readPos;
+  uint16_t pipelined  = conn.length - next;
+
+  conn.requestCount++;
+  _resetRequest();
+
+  if (pipelined)
+  {
+    ET_LOGDEBUG1(F("_prepareNextRequest: Pipelined bytes ="), pipelined);
+
+    memmove(conn.buf, conn.buf + next, pipelined);
+    conn.length = pipelined;
+  }
+}
+
+////////////////////////////////////////
+
+// Called once the headers are parsed, to choose how the body is read.
+// Return 1, or -1 on error
+int EthernetWebServer::_beginRequestBody()
+{
+  ethernetHTTPConnection& conn = *_currentConnection;
+
+  // The arguments are parsed on the first access to them, by _parseArguments()
+  _argsPending        = true;
+  _pendingQuery       = conn.buf + conn.query.offset;
+  _pendingQueryLength = conn.query.length;
+  _pendingBodyLength  = 0;
+
+  // UINT32_MAX until the last chunk of a chunked body is decoded
+  conn.bodyRemaining  = conn.chunked ? UINT32_MAX : conn.contentLength;
+
+  // Where the body ends isn't known, so neither is where the next request starts
+  if (conn.lengthInvalid)
+  {
+    ET_LOGDEBUG(F("_beginRequestBody: Invalid Content-Length"));
+
+    _rejectRequest(400);
+
+    return -1;
+  }
+
+  // below is needed only when POST type request
+  if ( !(_currentMethod == HTTP_POST || _currentMethod == HTTP_PUT || _currentMethod == HTTP_PATCH
+         || _currentMethod == HTTP_DELETE) )
+  {
+    // A body is ignored, and dropped before the next request
+    conn.state = HP_DONE;
+
+    return 1;
+  }
+
+  if (conn.transferUnknown)
+  {
+    ET_LOGDEBUG(F("_beginRequestBody: Unsupported Transfer-Encoding"));
+
+    _rejectRequest(501);
+
+    return -1;
+  }
+
+  if ( _maxBodyLength && (conn.contentLength > _maxBodyLength) )
+  {
+    ET_LOGDEBUG1(F("_beginRequestBody: Body too large, length ="), conn.contentLength);
+
+    _rejectRequest(413);
+
+    return -1;
+  }
+
+  if (!_checkExpectation())
+    return -1;
+
+  char* contentType = conn.buf + conn.contentType.offset;
+
+  // Whatever its type, the body for a route registered with onBody() isn't parsed but passed as it's received
+  if ( _currentHandler && _currentHandler->canStreamBody(_currentMethod, _currentUri) )
+  {
+    _currentBody.status         = BODY_START;
+    _currentBody.data           = nullptr;
+    _currentBody.currentSize    = 0;
+    _currentBody.totalSize      = 0;
+    _currentBody.contentLength  = conn.contentLength;
+    _currentBody.contentType    = conn.contentType.length ? contentType : "";
+
+    _currentHandler->body(*this, _currentUri, _currentBody);
+
+    _currentBody.status = BODY_WRITE;
+    conn.state          = HP_BODY_STREAM;
+
+    return 1;
+  }
+
+  if ( conn.contentType.length && strStartsWith(contentType, "multipart/") )
+  {
+    char* boundary = strstr(contentType, "boundary=");
+
+    if (!boundary)
+    {
+      ET_LOGDEBUG1(F("_beginRequestBody: No boundary: "), contentType);
+
+      return -1;
+    }
+
+    boundary += sizeof("boundary=") - 1;
+
+    char* boundaryEnd;
+
+    if (*boundary == '"')
+    {
+      boundaryEnd = strchr(++boundary, '"');
+    }
+    else
+    {
+      boundaryEnd = strchr(boundary, ';');
+    }
+
+    if (!boundaryEnd)
+      boundaryEnd = boundary + strlen(boundary);
+
+    *boundaryEnd = 0;
+    setHTTPView(conn.boundary, conn, boundary, boundaryEnd);
+
+    ET_LOGDEBUG1(F("Parse Form: Boundary: "), boundary);
+    ET_LOGDEBUG1(F("Length: "), conn.contentLength);
+
+    if ( (conn.boundary.length == 0) || (conn.boundary.length > 70) )
+      return -1;
+
+    // Query arguments follow the form arguments, see _finishForm()
+    conn.state = HP_FORM_START;
+
+    return 1;
+  }
+
+  // Plain, urlencoded or any other content type: read the whole body into _plainBuf
+  conn.isEncoded = conn.contentType.length && strStartsWith(contentType, "application/x-www-form-urlencoded");
+
+  // contentLength + 1 mustn't wrap, nor be more than the arena without its heap fallback
+  _plainBuf = ethernetRequestArena::canAllocString(conn.contentLength) ? (char *) _arena.alloc(conn.contentLength + 1)
+              : nullptr;
+
+  if (!_plainBuf)
+  {
+    ET_LOGERROR1(F("_beginRequestBody: Can't allocate body, length ="), conn.contentLength);
+
+    _rejectRequest(413);
+
+    return -1;
+  }
+
+  conn.state = HP_BODY;
+
+  return 1;
+}
+
+////////////////////////////////////////
+
+// Parse the body bytes held in the connection buffer.
+// Return 1 when the body is complete, 0 if more data is needed, -1 on error
+int EthernetWebServer::_parseRequestBody()
+{
+  ethernetHTTPConnection& conn = *_currentConnection;
+
+  if (conn.state == HP_BODY_STREAM)
+    return _parseBodyStream();
+
+  if (conn.state == HP_DONE)
+  {
+    // What follows the end of a form, or the body of a GET, is dropped so that the next request can follow
+    uint16_t avail = _bodyBuffered();
+
+    conn.readPos        += avail;
+    conn.bodyRemaining  -= avail;
+
+    return conn.bodyRemaining ? 0 : 1;
+  }
+
+  if (conn.state != HP_BODY)
+  {
+    int res = _parseFormBody();
+
+    if ( (res == 0) && (conn.bodyRemaining == 0) )
+    {
+      ET_LOGDEBUG(F("_parseRequestBody: Body too short for the form"));
+
+      return -1;
+    }
+
+    return res;
+  }
+
+  uint16_t avail = _bodyBuffered();
+
+  if (conn.chunked)
+  {
+    // The body grows in _arena as its chunks are decoded
+    size_t length = conn.chunkedLength - avail;
+    char* body    = _arena.extend(_plainBuf, length, avail);
+
+    if (!body)
+    {
+      ET_LOGERROR1(F("_parseRequestBody: Can't allocate chunked body, length ="), conn.chunkedLength);
+
+      _rejectRequest(413);
+
+      return -1;
+    }
+
+    _plainBuf = body;
+    memcpy(_plainBuf + length, conn.buf + conn.readPos, avail);
+  }
+  else
+  {
+    memcpy(_plainBuf + conn.contentLength - conn.bodyRemaining, conn.buf + conn.readPos, avail);
+  }
+
+  conn.readPos        += avail;
+  conn.bodyRemaining  -= avail;
+
+  if (conn.bodyRemaining)
+    return 0;
+
+  _plainBuf[conn.contentLength] = 0;
+
+  // The arguments of an urlencoded body follow those of the query, then key=value: plain={body}
+  if (conn.isEncoded)
+    _pendingBodyLength = conn.contentLength;
+
+  if (!conn.contentLength)
+    _plainBuf = nullptr;
+
+  conn.state = HP_DONE;
+
+  return 1;
+}
+
+////////////////////////////////////////
+
+// Pass the body bytes held in the connection buffer to the body handler, as they are.
+// Return 1 when the body is complete, 0 if more data is needed
+int EthernetWebServer::_parseBodyStream()
+{
+  ethernetHTTPConnection& conn = *_currentConnection;
+
+  uint16_t avail = _bodyBuffered();
+
+  if (avail)
+  {
+    _currentBody.data         = (const uint8_t *) conn.buf + conn.readPos;
+    _currentBody.currentSize  = avail;
+
+    _currentHandler->body(*this, _currentUri, _currentBody);
+
+    _currentBody.totalSize   += avail;
+    _currentBody.currentSize  = 0;
+
+    conn.readPos        += avail;
+    conn.bodyRemaining  -= avail;
+  }
+
+  if (conn.bodyRemaining)
+    return 0;
+
+  _currentBody.status = BODY_END;
+  _currentBody.data   = nullptr;
+
+  _currentHandler->body(*this, _currentUri, _currentBody);
+
+  conn.state = HP_DONE;
+
+  return 1;
+}
+
+////////////////////////////////////////
+
+bool EthernetWebServer::_parseBodyAborted()
+{
+  _currentBody.status = BODY_ABORTED;
+  _currentBody.data   = nullptr;
+
+  if (_currentHandler)
+    _currentHandler->body(*this, _currentUri, _currentBody);
+
+  return false;
+}
+
+////////////////////////////////////////
+
+// Answer the request with code before its body is read, unless the handler of onExpectContinue() already answered
+// it. The connection is closed, as the body is left unread
+void EthernetWebServer::_rejectRequest(int code)
+{
+  using namespace mime;
+
+  _currentConnection->keepAlive = false;
+
+  if (!_responseStarted)
+  {
+    _currentClient.setTimeout(HTTP_MAX_SEND_WAIT);
+    _contentLength = CONTENT_LENGTH_NOT_SET;
+
+    send(code, mimeTable[txt].mimeType, _responseCodeToString(code));
+  }
+
+  _finalizeResponse();
+
+  _responseHeadersLength = 0;
+}
+
+////////////////////////////////////////
+
+// Handle the Expect header of a request with a body, before the body is read: "100-continue" is checked by the
+// handler of onExpectContinue(), then answered with "100 Continue", and other expectations with 417. The header is
+// ignored from HTTP/1.0 clients. Return false if the request was rejected
+bool EthernetWebServer::_checkExpectation()
+{
+  ethernetHTTPConnection& conn = *_currentConnection;
+
+  if ( !_currentVersion || !(conn.expectContinue || conn.expectUnknown) )
+    return true;
+
+  if (conn.expectUnknown)
+  {
+    ET_LOGDEBUG(F("_checkExpectation: Unknown expectation"));
+
+    _rejectRequest(417);
+
+    return false;
+  }
+
+  if (_expectContinueHandler)
+  {
+    // A response sent by the handler closes the connection
+    bool keepAlive = conn.keepAlive;
+
+    conn.keepAlive = false;
+
+    _currentClient.setTimeout(HTTP_MAX_SEND_WAIT);
+    _contentLength = CONTENT_LENGTH_NOT_SET;
+
+    _expectContinueHandler();
+
+    if (_responseStarted)
+    {
+      ET_LOGDEBUG(F("_checkExpectation: Rejected by handler"));
+
+      _rejectRequest(0);
+
+      return false;
+    }
+
+    conn.keepAlive = keepAlive;
+  }
+
+  // Not needed if there's no body, or if the client already started sending it
+  if ( conn.bodyRemaining && (conn.readPos == conn.length) )
+  {
+    char line[ethernetStatus::maxLength + 2];
+    size_t length = 0;
+    PGM_P statusLine = ethernetStatus::find(100, length);
+
+    if (statusLine)
+    {
+      memcpy_P(line, statusLine, length);
+      memcpy(line + length, "\r\n", 2);
+
+      _currentClient.write((const uint8_t *) line, length + 2);
+    }
+  }
+
+  return true;
+}
+
+////////////////////////////////////////
+
+// Decode in place the chunked body bytes received after chunkEnd: the data of the chunks stays where it is, for the
+// body parsers, and the lines framing it are removed from the buffer. Return 0, or -1 if the body isn't validly chunked
+int EthernetWebServer::_decodeChunks()
+{
+  ethernetHTTPConnection& conn = *_currentConnection;
+
+  while ( (conn.chunkState != CHUNK_DONE) && (conn.chunkEnd < conn.length) )
+  {
+    char*    raw    = conn.buf + conn.chunkEnd;
+    uint16_t rawLen = conn.length - conn.chunkEnd;
+
+    if (conn.chunkState == CHUNK_DATA)
+    {
+      uint16_t len = (rawLen < conn.chunkRemaining) ? rawLen : conn.chunkRemaining;
+
+      conn.chunkEnd       += len;
+      conn.chunkRemaining -= len;
+      conn.chunkedLength  += len;
+
+      if (!conn.chunkRemaining)
+        conn.chunkState = CHUNK_DATA_END;
+
+      continue;
+    }
+
+    // Size of a chunk, CRLF after its data, or trailer
+    char* lineEnd = (char *) memchr(raw, '\n', (rawLen < HTTP_CHUNK_LINE_LEN) ? rawLen : HTTP_CHUNK_LINE_LEN);
+
+    if (!lineEnd)
+    {
+      if (rawLen < HTTP_CHUNK_LINE_LEN)
+        return 0;
+
+      ET_LOGDEBUG1(F("_decodeChunks: Line too long, HTTP_CHUNK_LINE_LEN ="), HTTP_CHUNK_LINE_LEN);
+
+      return -1;
+    }
+
+    uint16_t lineLen = (lineEnd - raw) + 1;
+
+    if ( (lineEnd > raw) && (lineEnd[-1] == '\r') )
+      lineEnd--;
+
+    if (conn.chunkState == CHUNK_SIZE)
+    {
+      // Size in hex, then extensions which are ignored
+      char*     digit = raw;
+      uint32_t  size  = 0;
+      uint8_t   value;
+
+      while ( (digit < lineEnd) && ( (value = hexDigitValue(*digit)) != 0xFF ) )
+      {
+        if (size > (UINT32_MAX >> 4))
         {
-          boundaryStr = headerValue.substring(headerValue.indexOf('=') + 1);
-          boundaryStr.replace("\"", "");
-          isForm = true;
+          ET_LOGDEBUG(F("_decodeChunks: Chunk too large"));
+
+          return -1;
         }
+
+        size = (size << 4) | value;
+        digit++;
       }
-      else if (headerName.equalsIgnoreCase("Content-Length"))
+
+      if ( (digit == raw) || ( (digit < lineEnd) && (*digit != ';') && (*digit != ' ') && (*digit != '\t') ) )
       {
-        _clientContentLength = contentLength = headerValue.toInt();
+        ET_LOGDEBUG(F("_decodeChunks: Invalid chunk size"));
+
+        return -1;
       }
-      else if (headerName.equalsIgnoreCase("Host"))
+
+      conn.chunkRemaining = size;
+      conn.chunkState     = size ? CHUNK_DATA : CHUNK_TRAILER;
+    }
+    else if (conn.chunkState == CHUNK_DATA_END)
+    {
+      if (lineEnd != raw)
       {
-        _hostHeader = headerValue;
+        ET_LOGDEBUG(F("_decodeChunks: No CRLF after chunk data"));
+
+        return -1;
       }
+
+      conn.chunkState = CHUNK_SIZE;
     }
+    else if (lineEnd == raw)
+    {
+      // Empty line ending the trailers. The whole body is decoded, its length is now known
+      conn.chunkState     = CHUNK_DONE;
+      conn.bodyRemaining  = conn.chunkEnd - conn.readPos;
+      conn.contentLength  = conn.chunkedLength;
+
+      _clientContentLength = conn.chunkedLength;
+    }
+
+    // Remove the line, the bytes after it follow the data decoded so far
+    memmove(raw, raw + lineLen, rawLen - lineLen);
+    conn.length -= lineLen;
+  }
+
+  return 0;
+}
+
+////////////////////////////////////////
+
+// Consume the next line of the body from the connection buffer, and NUL-terminate it in place without its CRLF.
+// Return its length, -1 if the line isn't complete yet, -2 if the line doesn't fit in the buffer
+int EthernetWebServer::_readBodyLine(char*& line)
+{
+  ethernetHTTPConnection& conn = *_currentConnection;
+
+  uint16_t avail  = _bodyBuffered();
+  uint16_t used;
+
+  line = conn.buf + conn.readPos;
+
+  char* lineEnd = (char *) memchr(line, '\n', avail);
+
+  if (lineEnd)
+  {
+    used = (lineEnd - line) + 1;
+  }
+  else if ( avail && (avail == conn.bodyRemaining) )
+  {
+    // Last line of the body, without CRLF
+    lineEnd = line + avail;
+    used    = avail;
+  }
+  else if ( (conn.readPos == conn.bodyBase) && (conn.length == HTTP_REQUEST_BUFLEN) )
+  {
+    return -2;
+  }
+  else
+  {
+    return -1;
+  }
+
+  conn.readPos        += used;
+  conn.bodyRemaining  -= used;
+
+  if ( (lineEnd > line) && (lineEnd[-1] == '\r') )
+    lineEnd--;
+
+  *lineEnd = 0;
+
+  return lineEnd - line;
+}
+
+////////////////////////////////////////
+
+#else   // #if USE_NEW_WEBSERVER_VERSION
+
+////////////////////////////////////////
+
+// Read the request line and the headers in bulk into the connection buffer, then tokenize them in place.
+// Body bytes already received with the headers stay in the buffer, and are returned first by _clientRead()
+bool EthernetWebServer::_readRequestHead(EthernetClient& client)
+{
+  ethernetHTTPConnection& conn = *_currentConnection;
+
+  _resetRequest();
+
+  unsigned long startMillis = millis();
+
+  while (conn.state < HP_BEGIN)
+  {
+    size_t avail = client.available();
+
+    if (!avail)
+    {
+      if ( !client.connected() || (millis() - startMillis > HTTP_MAX_DATA_WAIT) )
+      {
+        ET_LOGDEBUG(F("_readRequestHead: Timeout or client disconnected"));
+
+        return false;
+      }
+
+      delay(1);
+
+      continue;
+    }
+
+    size_t space = HTTP_REQUEST_BUFLEN - conn.length;
+
+    if (avail > space)
+      avail = space;
+
+    int len = client.read((uint8_t *) conn.buf + conn.length, avail);
+
+    if (len > 0)
+      conn.length += len;
+
+    if (_parseRequestHead(conn) < 0)
+      return false;
+  }
 
-    //KH
-#if USE_NEW_WEBSERVER_VERSION
+  return true;
+}
 
-    ////////////////////////////////////////
+////////////////////////////////////////
 
-    String plainBuf;
+int EthernetWebServer::_clientAvailable(EthernetClient& client)
+{
+  return (_currentConnection->length - _currentConnection->readPos) + client.available();
+}
 
-    if ( !isForm
-         && // read content into plainBuf
-         (   !readBytesWithTimeout(client, contentLength, plainBuf, HTTP_MAX_POST_WAIT)
-             || (plainBuf.length() < contentLength)
-         )
-       )
-    {
-      return false;
-    }
+////////////////////////////////////////
 
-    if (isEncoded)
-    {
-      // isEncoded => !isForm => plainBuf is not empty
-      // add plainBuf in search str
-      if (searchStr.length())
-        searchStr += '&';
+int EthernetWebServer::_clientRead(EthernetClient& client)
+{
+  if (_currentConnection->readPos < _currentConnection->length)
+    return (uint8_t) _currentConnection->buf[_currentConnection->readPos++];
 
-      searchStr += plainBuf;
-    }
+  return client.read();
+}
 
-    // parse searchStr for key/value pairs
-    _parseArguments(searchStr);
+////////////////////////////////////////
 
-    if (!isForm)
-    {
-      if (contentLength)
-      {
-        // add key=value: plain={body} (post json or other data)
-        RequestArgument& arg = _currentArgs[_currentArgCount++];
-        arg.key   = F("plain");
-        arg.value = plainBuf;
-      }
-    }
-    else
-    {
-      // isForm is true
-      // here: content is not yet read (plainBuf is still empty)
-      if (!_parseForm(client, boundaryStr, contentLength))
-      {
-        return false;
-      }
-    }
-  }
-  else
-  {
-    String headerName;
-    String headerValue;
+int EthernetWebServer::_clientTimedRead(EthernetClient& client)
+{
+  unsigned long startMillis = millis();
 
-    //parse headers
-    while (1)
-    {
-      req = client.readStringUntil('\r');
-      client.readStringUntil('\n');
+  do
+  {
+    int c = _clientRead(client);
 
-      if (req == "")
-        break;//no more headers
+    if (c >= 0)
+      return c;
 
-      int headerDiv = req.indexOf(':');
+    yield();
+  } while ( client.connected() && (millis() - startMillis < HTTP_MAX_POST_WAIT) );
 
-      if (headerDiv == -1)
-      {
-        break;
-      }
+  return -1;
+}
 
-      headerName  = req.substring(0, headerDiv);
-      headerValue = req.substring(headerDiv + 2);
-      _collectHeader(headerName.c_str(), headerValue.c_str());
+////////////////////////////////////////
 
-      ET_LOGDEBUG1(F("headerName:"), headerName);
-      ET_LOGDEBUG1(F("headerValue:"), headerValue);
+// Read a CRLF terminated line of the request body, without the CRLF
+void EthernetWebServer::_clientReadLine(EthernetClient& client, String& line)
+{
+  int c;
 
-      if (headerName.equalsIgnoreCase(F("Host")))
-      {
-        _hostHeader = headerValue;
-      }
-    }
+  line = "";
 
-    _parseArguments(searchStr);
+  while ( ( (c = _clientTimedRead(client)) >= 0 ) && (c != '\n') )
+  {
+    if (c != '\r')
+      line += (char) c;
   }
+}
 
-  client.flush();
-
-  ET_LOGDEBUG1(F("Request:"), url);
-  ET_LOGDEBUG1(F("Arguments:"), searchStr);
-  ET_LOGDEBUG (F("Final list of key/value pairs:"));
+////////////////////////////////////////
 
-  for (int i = 0; i < _currentArgCount; i++)
+bool EthernetWebServer::_parseRequest(EthernetClient& client)
+{
+  // Read the request line and headers into the connection buffer
+  if (!_readRequestHead(client))
   {
-    ET_LOGDEBUG1("key:",   _currentArgs[i].key.c_str());
-    ET_LOGDEBUG1("value:", _currentArgs[i].value.c_str());
+    return false;
   }
 
-  return true;
+  _beginRequest();
 
-  ////////////////////////////////////////
+  ethernetHTTPConnection& conn = *_currentConnection;
 
-#else   // #if USE_NEW_WEBSERVER_VERSION
+  String searchStr = _viewToString(conn.query);
+
+  // below is needed only when POST type request
+  if (_currentMethod == HTTP_POST || _currentMethod == HTTP_PUT || _currentMethod == HTTP_PATCH
+      || _currentMethod == HTTP_DELETE)
+  {
+    String boundaryStr;
+    bool isForm     = false;
+    uint32_t contentLength = conn.contentLength;
+    const char* contentType = _viewToChars(conn.contentType);
+
+    if (strStartsWith(contentType, "multipart/"))
+    {
+      const char* boundary = strchr(contentType, '=');
 
-    ////////////////////////////////////////
+      boundaryStr = boundary ? boundary + 1 : contentType;
+      boundaryStr.replace("\"", "");
+      isForm = true;
+    }
 
     if (isForm)
     {
@@ -452,231 +1602,234 @@ bool EthernetWebServer::_parseRequest(EthernetClient& client)
   }
   else
   {
-    String headerName;
-    String headerValue;
+    _parseArguments(searchStr);
+  }
 
-    //parse headers
-    while (1)
-    {
-      req = client.readStringUntil('\r');
-      client.readStringUntil('\n');
+  client.flush();
 
-      if (req == "")
-        break;//no more headers
+  ET_LOGDEBUG1(F("Request: "), _currentUri);
+  ET_LOGDEBUG1(F("Arguments: "), searchStr);
 
-      int headerDiv = req.indexOf(':');
+  return true;
+}
 
-      if (headerDiv == -1)
-      {
-        break;
-      }
+////////////////////////////////////////
 
-      headerName  = req.substring(0, headerDiv);
-      headerValue = req.substring(headerDiv + 2);
-      _collectHeader(headerName.c_str(), headerValue.c_str());
+#endif    // #if USE_NEW_WEBSERVER_VERSION
 
-      ET_LOGDEBUG1(F("headerName: "), headerName);
-      ET_LOGDEBUG1(F("headerValue: "), headerValue);
+////////////////////////////////////////
 
-      if (headerName == "Host")
-      {
-        _hostHeader = headerValue;
-      }
+// Return the index of headerName in the collected headers, or -1 if it isn't collected
+int EthernetWebServer::_headerIndex(const char* headerName)
+{
+  if (!_headerSlots)
+  {
+    for (int i = 0; i < _headerKeysCount; i++)
+    {
+      if (strcasecmp(_currentHeaders[i].key.c_str(), headerName) == 0)
+        return i;
     }
 
-    _parseArguments(searchStr);
+    return -1;
   }
 
-  client.flush();
+  uint32_t hash = _hashKey(headerName, true);
 
-  ET_LOGDEBUG1(F("Request: "), url);
-  ET_LOGDEBUG1(F("Arguments: "), searchStr);
+  for (uint16_t slot = hash & _headerSlotMask; _headerSlots[slot]; slot = (slot + 1) & _headerSlotMask)
+  {
+    RequestHeader& header = _currentHeaders[_headerSlots[slot] - 1];
 
-  return true;
+    if ( (header.hash == hash) && (strcasecmp(header.key.c_str(), headerName) == 0) )
+      return _headerSlots[slot] - 1;
+  }
 
-#endif
+  return -1;
 }
 
 ////////////////////////////////////////
 
-bool EthernetWebServer::_collectHeader(const char* headerName, const char* headerValue)
+// Make room for count more arguments in _currentArgs, moving those already there to a larger array of the arena
+bool EthernetWebServer::_reserveArgs(int count)
 {
-  for (int i = 0; i < _headerKeysCount; i++)
-  {
-    if (_currentHeaders[i].key.equalsIgnoreCase(headerName))
-    {
-      _currentHeaders[i].value = headerValue;
+  _argIndexValid = false;
 
-      return true;
-    }
-  }
+  if (_currentArgCount + count <= _currentArgsCapacity)
+    return true;
 
-  return false;
-}
+  RequestArgument* args = (RequestArgument *) _arena.alloc((_currentArgCount + count) * sizeof(RequestArgument),
+                                                          alignof(RequestArgument));
 
-////////////////////////////////////////
+  if (!args)
+    return false;
 
-#if USE_NEW_WEBSERVER_VERSION
+  if (_currentArgCount)
+    memcpy(args, _currentArgs, _currentArgCount * sizeof(RequestArgument));
 
-////////////////////////////////////////
+  memset(args + _currentArgCount, 0, count * sizeof(RequestArgument));
 
-struct storeArgHandler
-{
-  void operator() (String& key, String& value, const String& data, int equal_index, int pos, int key_end_pos,
-                   int next_index)
-  {
-    key = EthernetWebServer::urlDecode(data.substring(pos, key_end_pos));
+  _currentArgs          = args;
+  _currentArgsCapacity  = _currentArgCount + count;
 
-    if ((equal_index != -1) && ((equal_index < next_index - 1) || (next_index == -1)))
-      value = EthernetWebServer::urlDecode(data.substring(equal_index + 1, next_index));
-  }
-};
+  return true;
+}
 
 ////////////////////////////////////////
 
-void EthernetWebServer::_parseArguments(const String& data)
+// Release what the arena holds for the request, the arguments with it
+void EthernetWebServer::_resetArena()
 {
-  if (_currentArgs)
-    delete[] _currentArgs;
+  _arena.reset();
 
-  _currentArgs = 0;
+  _currentArgs          = nullptr;
+  _currentArgCount      = 0;
+  _currentArgsCapacity  = 0;
+  _argIndexValid        = false;
 
-  if (data.length() == 0)
-  {
-    _currentArgCount = 0;
-    _currentArgs = new RequestArgument[1];
+#if USE_NEW_WEBSERVER_VERSION
+  _postArgs     = nullptr;
+  _postArgsLen  = 0;
+  _plainBuf     = nullptr;
+  _argsPending  = false;
+#endif
+}
 
-    return;
-  }
+////////////////////////////////////////
 
-  _currentArgCount = 1;
+// Return the value of argument i, URL-decoding it the first time it's read. A value of the query is decoded in
+// place, over its raw chars followed by '&' or the end of the query replaced by the NUL. The body is kept intact
+// for the "plain" argument, its values are decoded into the arena
+const char* EthernetWebServer::_argValue(int i)
+{
+  RequestArgument& arg = _currentArgs[i];
 
-  for (int i = 0; i < (int)data.length(); )
+  if (arg.encoded)
   {
-    i = data.indexOf('&', i);
+    char* value = arg.inPlace ? (char *) arg.value : (char *) _arena.alloc(arg.rawLength + 1);
 
-    if (i == -1)
-      break;
+    if (!value)
+      return "";
 
-    ++i;
-    ++_currentArgCount;
+    value[urlDecodeChars(value, arg.value, arg.rawLength)] = 0;
+
+    arg.value   = value;
+    arg.encoded = false;
   }
 
-  _currentArgs = new RequestArgument[_currentArgCount + 1];
+  return arg.value;
+}
 
-  int pos = 0;
-  int iarg;
+////////////////////////////////////////
 
-  for (iarg = 0; iarg < _currentArgCount;)
-  {
-    int equal_sign_index = data.indexOf('=', pos);
-    int next_arg_index = data.indexOf('&', pos);
+#if USE_NEW_WEBSERVER_VERSION
 
-    if ((equal_sign_index == -1) || ((equal_sign_index > next_arg_index) && (next_arg_index != -1)))
-    {
-      if (next_arg_index == -1)
-        break;
+////////////////////////////////////////
 
-      pos = next_arg_index + 1;
+// Parse the arguments of the query and of an urlencoded body, left raw until now, after those of a form.
+// Called on the first access to the arguments, so that requests whose handler doesn't read them don't pay for it
+void EthernetWebServer::_parseArguments()
+{
+  _argsPending = false;
 
-      continue;
-    }
+  int argCount = argumentCount(_pendingQuery, _pendingQueryLength) + argumentCount(_plainBuf, _pendingBodyLength);
 
-    RequestArgument& arg = _currentArgs[iarg];
-    arg.key = urlDecode(data.substring(pos, equal_sign_index));
-    arg.value = urlDecode(data.substring(equal_sign_index + 1, next_arg_index));
+  if (_plainBuf)
+    argCount++;
 
-    ++iarg;
+  if (!_reserveArgs(argCount))
+    return;
 
-    if (next_arg_index == -1)
-      break;
+  _parseArguments(_pendingQuery, _pendingQueryLength, true);
+  _parseArguments(_plainBuf, _pendingBodyLength, false);
 
-    pos = next_arg_index + 1;
+  if (_plainBuf)
+  {
+    // add key=value: plain={body} (post json or other data)
+    _currentArgs[_currentArgCount++] = { "plain", _plainBuf };
   }
-
-  _currentArgCount = iarg;
 }
 
 ////////////////////////////////////////
 
-void EthernetWebServer::_uploadWriteByte(uint8_t b)
+// Append the key=value pairs of data to _currentArgs, room being reserved for them. Keys are URL-decoded, in place
+// and NUL-terminated over their '=' if inPlace, else into the arena. Values are left raw until read, see
+// _argValue(). Pairs without '=' are skipped
+void EthernetWebServer::_parseArguments(char* data, size_t length, bool inPlace)
 {
-  if (_currentUpload->currentSize == HTTP_UPLOAD_BUFLEN)
+  char* end = data + length;
+
+  for (char* pos = data; pos < end; )
   {
-    if (_currentHandler && _currentHandler->canUpload(_currentUri))
-      _currentHandler->upload(*this, _currentUri, *_currentUpload);
+    char* next = (char *) memchr(pos, '&', end - pos);
 
-    _currentUpload->totalSize += _currentUpload->currentSize;
-    _currentUpload->currentSize = 0;
-  }
+    if (!next)
+      next = end;
 
-  _currentUpload->buf[_currentUpload->currentSize++] = b;
-}
+    char* equal = (char *) memchr(pos, '=', next - pos);
 
-////////////////////////////////////////
+    if (equal)
+    {
+      char* key = inPlace ? pos : (char *) _arena.alloc(equal - pos + 1);
 
-#if 1
+      if (!key)
+        return;
 
-uint8_t EthernetWebServer::_uploadReadByte(EthernetClient& client)
-{
-  int res = client.read();
+      key[urlDecodeChars(key, pos, equal - pos)] = 0;
 
-  if (res == -1)
-  {
-    while (!client.available() && client.connected())
-      yield();
+      _currentArgs[_currentArgCount++] = { key, equal + 1, (size_t) (next - equal - 1), true, inPlace };
+    }
 
-    res = client.read();
+    pos = next + 1;
   }
-
-  return (uint8_t)res;
 }
 
-#else
+////////////////////////////////////////
 
-uint8_t EthernetWebServer::_uploadReadByte(EthernetClient& client)
+// Pass length bytes of file content to the upload handler: as they are with HTTP_UPLOAD_ZERO_COPY, else through the
+// upload buffer, passed to the handler each time it's full
+void EthernetWebServer::_uploadWrite(const char* data, size_t length)
 {
-  int res = client.read();
+#if HTTP_UPLOAD_ZERO_COPY
 
-  if (res < 0)
-  {
-    // keep trying until you either read a valid byte or timeout
-    unsigned long startMillis = millis();
-    unsigned long timeoutIntervalMillis = client.getTimeout();
-    bool timedOut = false;
+  if (!length)
+    return;
 
-    for (;;)
-    {
-      if (!client.connected())
-        return -1;
+  _currentUpload->data        = (const uint8_t *) data;
+  _currentUpload->currentSize = length;
 
-      // loosely modeled after blinkWithoutDelay pattern
-      while (!timedOut && !client.available() && client.connected())
-      {
-        delay(2);
-        timedOut = (millis() - startMillis) >= timeoutIntervalMillis;
-      }
+  if (_currentHandler && _currentHandler->canUpload(_currentUri))
+    _currentHandler->upload(*this, _currentUri, *_currentUpload);
 
-      res = client.read();
+  _currentUpload->totalSize   += length;
+  _currentUpload->currentSize = 0;
 
-      if (res >= 0)
-      {
-        return res; // exit on a valid read
-      }
+#else
 
-      timedOut = (millis() - startMillis) >= timeoutIntervalMillis;
+  while (length)
+  {
+    if (_currentUpload->currentSize == HTTP_UPLOAD_BUFLEN)
+    {
+      if (_currentHandler && _currentHandler->canUpload(_currentUri))
+        _currentHandler->upload(*this, _currentUri, *_currentUpload);
 
-      if (timedOut)
-      {
-        return res; // exit on a timeout
-      }
+      _currentUpload->totalSize += _currentUpload->currentSize;
+      _currentUpload->currentSize = 0;
     }
+
+    size_t len = HTTP_UPLOAD_BUFLEN - _currentUpload->currentSize;
+
+    if (len > length)
+      len = length;
+
+    memcpy(_currentUpload->buf + _currentUpload->currentSize, data, len);
+
+    _currentUpload->currentSize += len;
+    data    += len;
+    length  -= len;
   }
 
-  return res;
+#endif
 }
 
-#endif
 ////////////////////////////////////////
 
 #else   // #if USE_NEW_WEBSERVER_VERSION
@@ -687,20 +1840,12 @@ void EthernetWebServer::_parseArguments(const String& data)
 {
   ET_LOGDEBUG1(F("args: "), data);
 
-  if (_currentArgs)
-    delete[] _currentArgs;
-
-  _currentArgs = 0;
+  _currentArgCount = 0;
 
   if (data.length() == 0)
-  {
-    _currentArgCount = 0;
-    _currentArgs = new RequestArgument[1];
-
     return;
-  }
 
-  _currentArgCount = 1;
+  int argCount = 1;
 
   for (int i = 0; i < (int)data.length(); )
   {
@@ -710,17 +1855,18 @@ void EthernetWebServer::_parseArguments(const String& data)
       break;
 
     ++i;
-    ++_currentArgCount;
+    ++argCount;
   }
 
-  ET_LOGDEBUG1(F("args count: "), _currentArgCount);
+  ET_LOGDEBUG1(F("args count: "), argCount);
 
-  _currentArgs = new RequestArgument[_currentArgCount + 1];
+  if (!_reserveArgs(argCount))
+    return;
 
   int pos = 0;
   int iarg;
 
-  for (iarg = 0; iarg < _currentArgCount;)
+  for (iarg = 0; iarg < argCount;)
   {
     int equal_sign_index  = data.indexOf('=', pos);
     int next_arg_index    = data.indexOf('&', pos);
@@ -741,9 +1887,14 @@ void EthernetWebServer::_parseArguments(const String& data)
       continue;
     }
 
+    int value_end_index = (next_arg_index == -1) ? data.length() : next_arg_index;
+
     RequestArgument& arg = _currentArgs[iarg];
-    arg.key   = data.substring(pos, equal_sign_index);
-    arg.value = data.substring(equal_sign_index + 1, next_arg_index);
+    arg.key   = _arena.copy(data.c_str() + pos, equal_sign_index - pos);
+    arg.value = _arena.copy(data.c_str() + equal_sign_index + 1, value_end_index - equal_sign_index - 1);
+
+    if (!arg.key || !arg.value)
+      break;
 
     ET_LOGDEBUG1(F("arg: "), iarg);
     ET_LOGDEBUG1(F("key: "), arg.key);
@@ -782,7 +1933,7 @@ void EthernetWebServer::_uploadWriteByte(uint8_t b)
 
 uint8_t EthernetWebServer::_uploadReadByte(EthernetClient& client)
 {
-  int res = client.read();
+  int res = _clientRead(client);
 
   if (res == -1)
   {
@@ -805,131 +1956,171 @@ uint8_t EthernetWebServer::_uploadReadByte(EthernetClient& client)
 
 ////////////////////////////////////////
 
-bool EthernetWebServer::_parseForm(EthernetClient& client, const String& boundary, uint32_t len)
+// Find param="value" or param=value in a Content-Disposition line. Return the start of the value and set valueEnd,
+// or nullptr if the parameter isn't there
+static char* findDispositionParam(char* line, const char* param, char*& valueEnd)
 {
-  (void) len;
+  size_t paramLen = strlen(param);
 
-  ET_LOGDEBUG1(F("Parse Form: Boundary: "), boundary);
-  ET_LOGDEBUG1(F("Length: "), len);
+  for (char* p = strstr(line, param); p; p = strstr(p + paramLen, param))
+  {
+    if ( (p > line) && ( (p[-1] == ' ') || (p[-1] == ';') ) && (p[paramLen] == '=') )
+    {
+      char* value = p + paramLen + 1;
 
-  String line;
-  int retry = 0;
+      if (*value == '"')
+        valueEnd = strchr(++value, '"');
+      else
+        valueEnd = strchr(value, ';');
 
-  do
-  {
-    line = client.readStringUntil('\r');
-    ++retry;
-  } while (line.length() == 0 && retry < 3);
+      if (!valueEnd)
+        valueEnd = value + strlen(value);
 
-  client.readStringUntil('\n');
+      return value;
+    }
+  }
 
-  //start reading the form
-  if (line == ("--" + boundary))
+  return nullptr;
+}
+
+////////////////////////////////////////
+
+static void setStringFromRange(String& str, char* start, char* end)
+{
+  char saved = *end;
+
+  *end  = 0;
+  str   = start;
+  *end  = saved;
+}
+
+////////////////////////////////////////
+
+// Return 1 if line is "--boundary", 2 if it is the final "--boundary--", 0 otherwise
+static int formBoundaryLine(const ethernetHTTPConnection& conn, const char* line, int len)
+{
+  int boundaryLen = conn.boundary.length;
+
+  if ( (len < boundaryLen + 2) || (line[0] != '-') || (line[1] != '-')
+       || (memcmp(line + 2, conn.buf + conn.boundary.offset, boundaryLen) != 0) )
   {
-    if (_postArgs)
-      delete[] _postArgs;
+    return 0;
+  }
 
-    _postArgs = new RequestArgument[WEBSERVER_MAX_POST_ARGS];
-    _postArgsLen = 0;
+  return ( (len >= boundaryLen + 4) && (line[boundaryLen + 2] == '-') && (line[boundaryLen + 3] == '-') ) ? 2 : 1;
+}
 
-    while (1)
-    {
-      String argName;
-      String argValue;
-      String argType;
-      String argFilename;
+////////////////////////////////////////
 
-      bool argIsFile = false;
+// The content of a file ends with the delimiter "\r\n--boundary"
+static inline char formDelimiterChar(const char* boundary, uint8_t i)
+{
+  return (i < 4) ? "\r\n--"[i] : boundary[i - 4];
+}
+
+////////////////////////////////////////
 
-      line = client.readStringUntil('\r');
-      client.readStringUntil('\n');
+// Return true if the length chars of data are those of the delimiter from its char from
+static bool formDelimiterMatch(const char* data, uint16_t length, const char* boundary, uint8_t from)
+{
+  for (uint16_t i = 0; i < length; i++)
+  {
+    if (data[i] != formDelimiterChar(boundary, from + i))
+      return false;
+  }
 
-      if (line.length() > 19 && line.substring(0, 19).equalsIgnoreCase(F("Content-Disposition")))
-      {
-        int nameStart = line.indexOf('=');
+  return true;
+}
+
+////////////////////////////////////////
+
+// Parse the multipart/form-data body held in the connection buffer.
+// Return 1 when the form is complete, 0 if more data is needed, -1 on error
+int EthernetWebServer::_parseFormBody()
+{
+  ethernetHTTPConnection& conn = *_currentConnection;
+
+  while (conn.state != HP_DONE)
+  {
+    if (conn.state == HP_FORM_FILE)
+    {
+      if (!_parseFormFile())
+        return 0;
 
-        if (nameStart != -1)
-        {
-          argName = line.substring(nameStart + 2);
-          nameStart = argName.indexOf('=');
+      continue;
+    }
 
-          if (nameStart == -1)
-          {
-            argName = argName.substring(0, argName.length() - 1);
-          }
-          else
-          {
-            argFilename = argName.substring(nameStart + 2, argName.length() - 1);
-            argName = argName.substring(0, argName.indexOf('"'));
-            argIsFile = true;
+    char* line;
+    int len = _readBodyLine(line);
+    bool partial = false;
 
-            ET_LOGDEBUG1(F("PostArg FileName: "), argFilename);
+    if (len == -1)
+      return 0;
 
-            //use GET to set the filename if uploading using blob
-            if (argFilename == F("blob") && hasArg("filename"))
-              argFilename = arg("filename");
-          }
+    if (len == -2)
+    {
+      len = _bodyBuffered();
 
-          ET_LOGDEBUG1(F("PostArg Name: "), argName);
+      if (line[len - 1] == '\r')
+        len--;
 
-          using namespace mime;
+      if ( (conn.state != HP_FORM_VALUE) || (len == 0) )
+      {
+        ET_LOGDEBUG1(F("_parseFormBody: Line too long, HTTP_REQUEST_BUFLEN ="), HTTP_REQUEST_BUFLEN);
 
-          argType = mimeTable[txt].mimeType;
-          line    = client.readStringUntil('\r');
-          client.readStringUntil('\n');
+        return -1;
+      }
 
-          if (line.length() > 12 && line.substring(0, 12).equalsIgnoreCase("Content-Type"))
-          {
-            argType = line.substring(line.indexOf(':') + 2);
-            //skip next line
-            client.readStringUntil('\r');
-            client.readStringUntil('\n');
-          }
+      // Value line longer than the buffer. Keep what is buffered, the line continues
+      conn.readPos        += len;
+      conn.bodyRemaining  -= len;
+      partial = true;
+    }
 
-          ET_LOGDEBUG1(F("PostArg Type: "), argType);
+    switch (conn.state)
+    {
+      case HP_FORM_START:
 
-          if (!argIsFile)
-          {
-            while (1)
-            {
-              line = client.readStringUntil('\r');
-              client.readStringUntil('\n');
+        //start reading the form
+        if (formBoundaryLine(conn, line, len) == 1)
+        {
+          _postArgs = (RequestArgument *) _arena.alloc(WEBSERVER_MAX_POST_ARGS * sizeof(RequestArgument),
+                                                       alignof(RequestArgument));
 
-              if (line.startsWith("--" + boundary))
-                break;
+          // Without room for its arguments, the form is still read for its files, the arguments being dropped
+          _postArgsLen = _postArgs ? 0 : WEBSERVER_MAX_POST_ARGS;
 
-              if (argValue.length() > 0)
-                argValue += "\n";
+          for (int i = 0; _postArgs && (i < WEBSERVER_MAX_POST_ARGS); i++)
+            _postArgs[i] = { "", "" };
 
-              argValue += line;
-            }
+          conn.formIsFile = false;
+          conn.state      = HP_FORM_HEADERS;
+        }
+        else if ( (len != 0) || (++conn.formRetry >= 3) )
+        {
+          ET_LOGDEBUG1(F("Error: line: "), line);
 
-            ET_LOGDEBUG1(F("PostArg Value: "), argValue);
+          return -1;
+        }
 
-            RequestArgument& arg = _postArgs[_postArgsLen++];
-            arg.key = argName;
-            arg.value = argValue;
+        break;
 
-            if (line == ("--" + boundary + "--"))
-            {
-              ET_LOGDEBUG(F("Done Parsing POST"));
+      case HP_FORM_HEADERS:
 
-              break;
-            }
-          }
-          else
+        if (len == 0)
+        {
+          // Empty line, end of the part headers
+          if (conn.formIsFile)
           {
-            //_currentUpload.reset(new ethernetHTTPUpload());
-            if (!_currentUpload)
-              _currentUpload = new ethernetHTTPUpload();
-
             _currentUpload->status = UPLOAD_FILE_START;
-            _currentUpload->name = argName;
-            _currentUpload->filename = argFilename;
-            _currentUpload->type = argType;
             _currentUpload->totalSize = 0;
             _currentUpload->currentSize = 0;
-            _currentUpload->contentLength = len;
+            _currentUpload->contentLength = conn.contentLength;
+#if HTTP_UPLOAD_ZERO_COPY
+            _currentUpload->data = nullptr;
+#else
+            _currentUpload->data = _currentUpload->buf;
+#endif
 
             ET_LOGDEBUG1(F("Start File: "), _currentUpload->filename);
             ET_LOGDEBUG1(F("Type: "), _currentUpload->type);
@@ -938,162 +2129,284 @@ bool EthernetWebServer::_parseForm(EthernetClient& client, const String& boundar
               _currentHandler->upload(*this, _currentUri, *_currentUpload);
 
             _currentUpload->status = UPLOAD_FILE_WRITE;
-            uint8_t argByte = _uploadReadByte(client);
 
-readfile:
+            conn.formMatch  = 0;
+            conn.state      = HP_FORM_FILE;
+          }
+          else
+          {
+            conn.formPartial  = false;
+            conn.state        = HP_FORM_VALUE;
+            _postValueLength  = 0;
+          }
+        }
+        else if (strncasecmp(line, "Content-Disposition:", 20) == 0)
+        {
+          char* nameEnd;
+          char* filenameEnd;
+          char* name      = findDispositionParam(line, "name", nameEnd);
+          char* filename  = findDispositionParam(line, "filename", filenameEnd);
 
-            while (argByte != 0x0D)
-            {
-              if (!client.connected())
-                return _parseFormUploadAborted();
+          if (filename)
+          {
+            conn.formIsFile = true;
 
-              _uploadWriteByte(argByte);
-              argByte = _uploadReadByte(client);
-            }
+            if (!_currentUpload)
+              _currentUpload = new ethernetHTTPUpload();
 
-            argByte = _uploadReadByte(client);
+            if (name)
+              setStringFromRange(_currentUpload->name, name, nameEnd);
+            else
+              _currentUpload->name = String();
 
-            if (!client.connected())
-              return _parseFormUploadAborted();
+            setStringFromRange(_currentUpload->filename, filename, filenameEnd);
 
-            if (argByte == 0x0A)
-            {
-              argByte = _uploadReadByte(client);
+            ET_LOGDEBUG1(F("PostArg FileName: "), _currentUpload->filename);
 
-              if (!client.connected())
-                return _parseFormUploadAborted();
+            //use GET to set the filename if uploading using blob
+            if (_currentUpload->filename == F("blob") && hasArg("filename"))
+              _currentUpload->filename = arg("filename");
 
-              if ((char)argByte != '-')
-              {
-                //continue reading the file
-                _uploadWriteByte(0x0D);
-                _uploadWriteByte(0x0A);
-                goto readfile;
-              }
-              else
-              {
-                argByte = _uploadReadByte(client);
+            using namespace mime;
 
-                if (!client.connected())
-                  return _parseFormUploadAborted();
+            _currentUpload->type = mimeTable[txt].mimeType;
+          }
+          else if ( name && (_postArgsLen < WEBSERVER_MAX_POST_ARGS) )
+          {
+            const char* key = _arena.copy(name, nameEnd - name);
 
-                if ((char)argByte != '-')
-                {
-                  //continue reading the file
-                  _uploadWriteByte(0x0D);
-                  _uploadWriteByte(0x0A);
-                  _uploadWriteByte((uint8_t)('-'));
-                  goto readfile;
-                }
-              }
+            if (key)
+              _postArgs[_postArgsLen].key = key;
 
-              // Better compiler warning than risk of fragmented heap
-              uint8_t endBuf[boundary.length()];
+            ET_LOGDEBUG1(F("PostArg Name: "), _postArgs[_postArgsLen].key);
+          }
+        }
+        else if ( conn.formIsFile && (strncasecmp(line, "Content-Type:", 13) == 0) )
+        {
+          const char* type = line + 13;
 
-              client.readBytes(endBuf, boundary.length());
+          while (*type == ' ')
+            type++;
 
-              if (strstr((const char*)endBuf, boundary.c_str()) != NULL)
-              {
-                if (_currentHandler && _currentHandler->canUpload(_currentUri))
-                  _currentHandler->upload(*this, _currentUri, *_currentUpload);
+          _currentUpload->type = type;
 
-                _currentUpload->totalSize += _currentUpload->currentSize;
-                _currentUpload->status = UPLOAD_FILE_END;
+          ET_LOGDEBUG1(F("PostArg Type: "), _currentUpload->type);
+        }
 
-                if (_currentHandler && _currentHandler->canUpload(_currentUri))
-                  _currentHandler->upload(*this, _currentUri, *_currentUpload);
+        break;
 
-                ET_LOGDEBUG1(F("End File: "), _currentUpload->filename);
-                ET_LOGDEBUG1(F("Type: "), _currentUpload->type);
-                ET_LOGDEBUG1(F("Size: "), _currentUpload->totalSize);
+      case HP_FORM_VALUE:
+      {
+        int boundary = conn.formPartial ? 0 : formBoundaryLine(conn, line, len);
 
-                line = client.readStringUntil(0x0D);
-                client.readStringUntil(0x0A);
+        if (boundary)
+        {
+          if (_postArgsLen < WEBSERVER_MAX_POST_ARGS)
+          {
+            ET_LOGDEBUG1(F("PostArg Value: "), _postArgs[_postArgsLen].value);
 
-                if (line == "--")
-                {
-                  ET_LOGDEBUG(F("Done Parsing POST"));
+            _postArgsLen++;
+          }
 
-                  break;
-                }
+          if (boundary == 2)
+          {
+            ET_LOGDEBUG(F("Done Parsing POST"));
 
-                continue;
-              }
-              else
-              {
-                _uploadWriteByte(0x0D);
-                _uploadWriteByte(0x0A);
-                _uploadWriteByte((uint8_t)('-'));
-                _uploadWriteByte((uint8_t)('-'));
+            return _finishForm() ? 1 : -1;
+          }
 
-                uint32_t i = 0;
+          conn.formIsFile = false;
+          conn.state      = HP_FORM_HEADERS;
 
-                while (i < boundary.length())
-                {
-                  _uploadWriteByte(endBuf[i++]);
-                }
+          break;
+        }
 
-                argByte = _uploadReadByte(client);
-                goto readfile;
-              }
-            }
-            else
-            {
-              _uploadWriteByte(0x0D);
-              goto readfile;
-            }
+        if (_postArgsLen < WEBSERVER_MAX_POST_ARGS)
+        {
+          // Lines of the value after the first are joined with '\n'
+          RequestArgument& arg  = _postArgs[_postArgsLen];
+          size_t newline        = (!conn.formPartial && (_postValueLength > 0)) ? 1 : 0;
+          char* value           = _arena.extend(arg.value, _postValueLength, newline + len);
 
-            break;
+          if (value)
+          {
+            if (newline)
+              value[_postValueLength] = '\n';
+
+            memcpy(value + _postValueLength + newline, line, len);
+
+            _postValueLength += newline + len;
+            value[_postValueLength] = 0;
+            arg.value = value;
           }
         }
+
+        conn.formPartial = partial;
+
+        break;
       }
-    }
 
-    int iarg;
-    int totalArgs = ((WEBSERVER_MAX_POST_ARGS - _postArgsLen) < _currentArgCount) ?
-                    (WEBSERVER_MAX_POST_ARGS - _postArgsLen) : _currentArgCount;
+      case HP_FORM_BOUNDARY:
 
-    for (iarg = 0; iarg < totalArgs; iarg++)
-    {
-      RequestArgument& arg = _postArgs[_postArgsLen++];
-      arg.key = _currentArgs[iarg].key;
-      arg.value = _currentArgs[iarg].value;
+        // Rest of the line after the boundary ending a file
+        if (strStartsWith(line, "--"))
+        {
+          ET_LOGDEBUG(F("Done Parsing POST"));
+
+          return _finishForm() ? 1 : -1;
+        }
+
+        conn.formIsFile = false;
+        conn.state      = HP_FORM_HEADERS;
+
+        break;
+
+      default:
+        break;
     }
+  }
+
+  return 1;
+}
+
+////////////////////////////////////////
 
-    if (_currentArgs)
-      delete[] _currentArgs;
+// Pass the file content held in the connection buffer to the upload handler, until the delimiter "\r\n--boundary".
+// The content up to the delimiter or the end of the buffer is passed as a whole, the delimiter being only looked for
+// at each '\r'. A delimiter cut by the end of the buffer is matched on by conn.formMatch. Return true at the end of
+// the file
+bool EthernetWebServer::_parseFormFile()
+{
+  ethernetHTTPConnection& conn = *_currentConnection;
+
+  const char* boundary  = conn.buf + conn.boundary.offset;
+  uint8_t delimiterLen  = conn.boundary.length + 4;
+  const char* data      = conn.buf + conn.readPos;
+  uint16_t avail        = _bodyBuffered();
+  uint16_t pos          = 0;
+  bool done             = false;
+
+  if (conn.formMatch)
+  {
+    // Delimiter matched up to the end of the previous buffer, its rest starts this one
+    pos = delimiterLen - conn.formMatch;
 
-    _currentArgs = new RequestArgument[_postArgsLen];
+    if (pos > avail)
+      pos = avail;
 
-    if (_currentArgs == nullptr)
+    if (formDelimiterMatch(data, pos, boundary, conn.formMatch))
     {
-      ET_LOGERROR(F("EthernetWebServer::_parseForm: null _currentArgs"));
+      conn.formMatch += pos;
+      done = (conn.formMatch == delimiterLen);
+    }
+    else
+    {
+      // Not the delimiter, the bytes matched so far are file content
+      uint8_t head = (conn.formMatch < 4) ? conn.formMatch : 4;
 
-      return false;
+      _uploadWrite("\r\n--", head);
+      _uploadWrite(boundary, conn.formMatch - head);
+
+      conn.formMatch  = 0;
+      pos             = 0;
     }
+  }
+
+  // Content up to the next delimiter, or to the end of the buffer, is passed as one run
+  uint16_t runStart = pos;
+
+  while ( !done && (pos < avail) )
+  {
+    const char* cr = (const char *) memchr(data + pos, '\r', avail - pos);
 
-    for (iarg = 0; iarg < _postArgsLen; iarg++)
+    if (!cr)
     {
-      RequestArgument& arg = _currentArgs[iarg];
-      arg.key = _postArgs[iarg].key;
-      arg.value = _postArgs[iarg].value;
+      pos = avail;
+
+      break;
     }
 
-    _currentArgCount = iarg;
+    pos = cr - data;
+
+    uint16_t len = avail - pos;
 
-    if (_postArgs)
+    if (len > delimiterLen)
+      len = delimiterLen;
+
+    if (!formDelimiterMatch(cr, len, boundary, 0))
     {
-      delete[] _postArgs;
-      _postArgs = nullptr;
-      _postArgsLen = 0;
+      // The delimiter has only one '\r', at its start: look for it again after this one
+      pos++;
+
+      continue;
     }
 
+    _uploadWrite(data + runStart, pos - runStart);
+
+    pos      += len;
+    runStart  = pos;
+
+    if (len == delimiterLen)
+      done = true;
+    else
+      conn.formMatch = len;
+  }
+
+  _uploadWrite(data + runStart, pos - runStart);
+
+  conn.readPos        += pos;
+  conn.bodyRemaining  -= pos;
+
+  if (!done)
+    return false;
+
+  // Rest of the content in the upload buffer
+  if ( _currentUpload->currentSize && _currentHandler && _currentHandler->canUpload(_currentUri) )
+    _currentHandler->upload(*this, _currentUri, *_currentUpload);
+
+  _currentUpload->totalSize += _currentUpload->currentSize;
+  _currentUpload->status = UPLOAD_FILE_END;
+
+  if (_currentHandler && _currentHandler->canUpload(_currentUri))
+    _currentHandler->upload(*this, _currentUri, *_currentUpload);
+
+  ET_LOGDEBUG1(F("End File: "), _currentUpload->filename);
+  ET_LOGDEBUG1(F("Type: "), _currentUpload->type);
+  ET_LOGDEBUG1(F("Size: "), _currentUpload->totalSize);
+
+  conn.state = HP_FORM_BOUNDARY;
+
+  return true;
+}
+
+////////////////////////////////////////
+
+// Merge the query arguments after the form arguments, _postArgs becoming _currentArgs. Query arguments still
+// raw are appended when parsed
+bool EthernetWebServer::_finishForm()
+{
+  _currentConnection->state = HP_DONE;
+
+  if (!_postArgs)
     return true;
+
+  int totalArgs = ((WEBSERVER_MAX_POST_ARGS - _postArgsLen) < _currentArgCount) ?
+                  (WEBSERVER_MAX_POST_ARGS - _postArgsLen) : _currentArgCount;
+
+  for (int iarg = 0; iarg < totalArgs; iarg++)
+  {
+    _postArgs[_postArgsLen++] = _currentArgs[iarg];
   }
 
-  ET_LOGDEBUG1(F("Error: line: "), line);
+  _argIndexValid        = false;
+  _currentArgs          = _postArgs;
+  _currentArgCount      = _postArgsLen;
+  _currentArgsCapacity  = WEBSERVER_MAX_POST_ARGS;
 
-  return false;
+  _postArgs     = nullptr;
+  _postArgsLen  = 0;
+
+  return true;
 }
 
 ////////////////////////////////////////
@@ -1125,19 +2438,22 @@ bool EthernetWebServer::_parseForm(EthernetClient& client, const String& boundar
 
   do
   {
-    line = client.readStringUntil('\r');
+    _clientReadLine(client, line);
     ++retry;
   } while (line.length() == 0 && retry < 3);
 
-  client.readStringUntil('\n');
-
   //start reading the form
   if (line == ("--" + boundary))
   {
-    RequestArgument* postArgs = new RequestArgument[32];
+    RequestArgument* postArgs = (RequestArgument *) _arena.alloc(32 * sizeof(RequestArgument), alignof(RequestArgument));
 
     int postArgsLen = 0;
 
+    if (!postArgs)
+      return false;
+
+    memset(postArgs, 0, 32 * sizeof(RequestArgument));
+
     while (1)
     {
       String argName;
@@ -1147,8 +2463,7 @@ bool EthernetWebServer::_parseForm(EthernetClient& client, const String& boundar
 
       bool argIsFile = false;
 
-      line = client.readStringUntil('\r');
-      client.readStringUntil('\n');
+      _clientReadLine(client, line);
 
       if (line.startsWith("Content-Disposition"))
       {
@@ -1179,15 +2494,13 @@ bool EthernetWebServer::_parseForm(EthernetClient& client, const String& boundar
           ET_LOGDEBUG1(F("PostArg Name: "), argName);
 
           argType = "text/plain";
-          line    = client.readStringUntil('\r');
-          client.readStringUntil('\n');
+          _clientReadLine(client, line);
 
           if (line.startsWith("Content-Type"))
           {
             argType = line.substring(line.indexOf(':') + 2);
             //skip next line
-            client.readStringUntil('\r');
-            client.readStringUntil('\n');
+            _clientReadLine(client, line);
           }
 
           ET_LOGDEBUG1(F("PostArg Type: "), argType);
@@ -1196,8 +2509,7 @@ bool EthernetWebServer::_parseForm(EthernetClient& client, const String& boundar
           {
             while (1)
             {
-              line = client.readStringUntil('\r');
-              client.readStringUntil('\n');
+              _clientReadLine(client, line);
 
               if (line.startsWith("--" + boundary))
                 break;
@@ -1210,9 +2522,16 @@ bool EthernetWebServer::_parseForm(EthernetClient& client, const String& boundar
 
             ET_LOGDEBUG1(F("PostArg Value: "), argValue);
 
-            RequestArgument& arg = postArgs[postArgsLen++];
-            arg.key   = argName;
-            arg.value = argValue;
+            // Fields after the 32nd are dropped
+            if (postArgsLen < 32)
+            {
+              RequestArgument& arg = postArgs[postArgsLen];
+              arg.key   = _arena.copy(argName.c_str(), argName.length());
+              arg.value = _arena.copy(argValue.c_str(), argValue.length());
+
+              if (arg.key && arg.value)
+                postArgsLen++;
+            }
 
             if (line == ("--" + boundary + "--"))
             {
@@ -1229,6 +2548,7 @@ bool EthernetWebServer::_parseForm(EthernetClient& client, const String& boundar
             _currentUpload.type         = argType;
             _currentUpload.totalSize    = 0;
             _currentUpload.currentSize  = 0;
+            _currentUpload.data         = _currentUpload.buf;
 
             ET_LOGDEBUG1(F("Start File: "), _currentUpload.filename);
             ET_LOGDEBUG1(F("Type: "), _currentUpload.type);
@@ -1289,9 +2609,10 @@ readfile:
               // Better compiler warning than risk of fragmented heap
               uint8_t endBuf[boundary.length()];
 
-              client.readBytes(endBuf, boundary.length());
+              for (uint32_t i = 0; i < boundary.length(); i++)
+                endBuf[i] = (uint8_t) _clientTimedRead(client);
 
-              if (strstr((const char*)endBuf, boundary.c_str()) != NULL)
+              if (memcmp(endBuf, boundary.c_str(), boundary.length()) == 0)
               {
                 if (_currentHandler && _currentHandler->canUpload(_currentUri))
                   _currentHandler->upload(*this, _currentUri, _currentUpload);
@@ -1306,8 +2627,7 @@ readfile:
                 ET_LOGDEBUG1(F("Type: "), _currentUpload.type);
                 ET_LOGDEBUG1(F("Size: "), _currentUpload.totalSize);
 
-                line = client.readStringUntil(0x0D);
-                client.readStringUntil(0x0A);
+                _clientReadLine(client, line);
 
                 if (line == "--")
                 {
@@ -1353,34 +2673,14 @@ readfile:
 
     for (iarg = 0; iarg < totalArgs; iarg++)
     {
-      RequestArgument& arg = postArgs[postArgsLen++];
-      arg.key = _currentArgs[iarg].key;
-      arg.value = _currentArgs[iarg].value;
-    }
-
-    if (_currentArgs)
-      delete[] _currentArgs;
-
-    _currentArgs = new RequestArgument[postArgsLen];
-
-    if (_currentArgs == nullptr)
-    {
-      ET_LOGERROR(F("EthernetWebServer::_parseForm: null _currentArgs"));
-
-      return false;
-    }
-
-    for (iarg = 0; iarg < postArgsLen; iarg++)
-    {
-      RequestArgument& arg = _currentArgs[iarg];
-      arg.key = postArgs[iarg].key;
-      arg.value = postArgs[iarg].value;
+      postArgs[postArgsLen++] = _currentArgs[iarg];
     }
 
-    _currentArgCount = iarg;
-
-    if (postArgs)
-      delete[] postArgs;
+    // The form arguments, followed by the query arguments, become the arguments of the request
+    _argIndexValid        = false;
+    _currentArgs          = postArgs;
+    _currentArgCount      = postArgsLen;
+    _currentArgsCapacity  = 32;
 
     return true;
   }
@@ -1410,36 +2710,14 @@ bool EthernetWebServer::_parseFormUploadAborted()
 
 String EthernetWebServer::urlDecode(const String& text)
 {
-  String decoded    = "";
-  char temp[]       = "0x00";
-  unsigned int len  = text.length();
-  unsigned int i    = 0;
+  String decoded = text;
 
-  while (i < len)
+  // Decoded in place in the copy, then cut to the decoded length
+  if (decoded.length())
   {
-    char decodedChar;
-    char encodedChar = text.charAt(i++);
-
-    if ((encodedChar == '%') && (i + 1 < len))
-    {
-      temp[2] = text.charAt(i++);
-      temp[3] = text.charAt(i++);
-
-      decodedChar = strtol(temp, NULL, 16);
-    }
-    else
-    {
-      if (encodedChar == '+')
-      {
-        decodedChar = ' ';
-      }
-      else
-      {
-        decodedChar = encodedChar;  // normal ascii char
-      }
-    }
+    char* buf = (char *) decoded.c_str();
 
-    decoded += decodedChar;
+    decoded.remove(urlDecodeChars(buf, buf, decoded.length()));
   }
 
   return decoded;
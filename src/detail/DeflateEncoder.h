@@ -0,0 +1,533 @@
+/****************************************************************************************************************************
+  DeflateEncoder.h - Dead simple web-server.
+  For Ethernet shields
+
+  EthernetWebServer is a library for the Ethernet shields to run WebServer
+
+  Based on and modified from ESP8266 https://github.com/esp8266/Arduino/releases
+  Built by Khoi Hoang https://github.com/khoih-prog/EthernetWebServer
+  Licensed under MIT license
+
+  Original author:
+  @file       Esp8266WebServer.h
+  @author     Ivan Grokhotkov
+
+  Version: 2.3.0
+
+  Version Modified By   Date      Comments
+  ------- -----------  ---------- -----------
+  1.0.0   K Hoang      13/02/2020 Initial coding for Arduino Mega, Teensy, etc to support Ethernetx libraries
+  ...
+  2.0.0   K Hoang      16/01/2022 To coexist with ESP32 WebServer and ESP8266 ESP8266WebServer
+  2.0.1   K Hoang      02/03/2022 Fix decoding error bug
+  2.0.2   K Hoang      14/03/2022 Fix bug when using QNEthernet staticIP. Add staticIP option to NativeEthernet
+  2.1.0   K Hoang      03/04/2022 Use Ethernet_Generic library as default. Support SPI2 for ESP32
+  2.1.1   K Hoang      04/04/2022 Fix compiler error for Portenta_H7 using Portenta Ethernet
+  2.1.2   K Hoang      08/04/2022 Add support to SPI1 for RP2040 using arduino-pico core
+  2.1.3   K Hoang      27/04/2022 Change from `arduino.cc` to `arduino.tips` in examples
+  2.2.0   K Hoang      05/05/2022 Add support to custom SPI for Teensy, Mbed RP2040, Portenta_H7, etc.
+  2.2.1   K Hoang      25/08/2022 Auto-select SPI SS/CS pin according to board package
+  2.2.2   K Hoang      06/09/2022 Slow SPI clock for old W5100 shield or SAMD Zero. Improve support for SAMD21
+  2.2.3   K Hoang      17/09/2022 Add support to AVR Dx (AVR128Dx, AVR64Dx, AVR32Dx, etc.) using DxCore
+  2.2.4   K Hoang      26/10/2022 Add support to Seeed XIAO_NRF52840 and XIAO_NRF52840_SENSE using `mbed` or `nRF52` core
+  2.3.0   K Hoang      15/11/2022 Add new features, such as CORS. Update code and examples to send big data
+ *************************************************************************************************************************************/
+
+#pragma once
+
+#ifndef DEFLATE_ENCODER_H
+#define DEFLATE_ENCODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Content coding of a response, negotiated from the Accept-Encoding header of the request
+enum HTTPContentEncoding
+{
+  ENCODING_NONE     = 0,
+  ENCODING_GZIP     = 1,      // gzip stream, RFC 1952
+  ENCODING_DEFLATE  = 2       // zlib stream, RFC 1950, which HTTP calls "deflate"
+};
+
+// Use of the deflate encoder, kept over all responses
+typedef struct
+{
+  size_t    memory;           // bytes taken by the encoder, allocated once by enableCompression()
+  uint32_t  responses;        // responses compressed
+  uint32_t  inputBytes;       // content bytes compressed
+  uint32_t  outputBytes;      // compressed bytes sent, gzip or zlib framing included
+} ethernetDeflateStats;
+
+namespace ethernetDeflate
+{
+
+// Codes of the match lengths and distances are computed, only the bit reversal of the codes, per nibble, and the
+// CRC-32 need a table
+const uint8_t reverseTable[16] PROGMEM =
+{
+  0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF
+};
+
+const uint32_t crcTable[256] PROGMEM =
+{
+  0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA, 0x076DC419, 0x706AF48F, 0xE963A535, 0x9E6495A3,
+  0x0EDB8832, 0x79DCB8A4, 0xE0D5E91E, 0x97D2D988, 0x09B64C2B, 0x7EB17CBD, 0xE7B82D07, 0x90BF1D91,
+  0x1DB71064, 0x6AB020F2, 0xF3B97148, 0x84BE41DE, 0x1ADAD47D, 0x6DDDE4EB, 0xF4D4B551, 0x83D385C7,
+  0x136C9856, 0x646BA8C0, 0xFD62F97A, 0x8A65C9EC, 0x14015C4F, 0x63066CD9, 0xFA0F3D63, 0x8D080DF5,
+  0x3B6E20C8, 0x4C69105E, 0xD56041E4, 0xA2677172, 0x3C03E4D1, 0x4B04D447, 0xD20D85FD, 0xA50AB56B,
+  0x35B5A8FA, 0x42B2986C, 0xDBBBC9D6, 0xACBCF940, 0x32D86CE3, 0x45DF5C75, 0xDCD60DCF, 0xABD13D59,
+  0x26D930AC, 0x51DE003A, 0xC8D75180, 0xBFD06116, 0x21B4F4B5, 0x56B3C423, 0xCFBA9599, 0xB8BDA50F,
+  0x2802B89E, 0x5F058808, 0xC60CD9B2, 0xB10BE924, 0x2F6F7C87, 0x58684C11, 0xC1611DAB, 0xB6662D3D,
+  0x76DC4190, 0x01DB7106, 0x98D220BC, 0xEFD5102A, 0x71B18589, 0x06B6B51F, 0x9FBFE4A5, 0xE8B8D433,
+  0x7807C9A2, 0x0F00F934, 0x9609A88E, 0xE10E9818, 0x7F6A0DBB, 0x086D3D2D, 0x91646C97, 0xE6635C01,
+  0x6B6B51F4, 0x1C6C6162, 0x856530D8, 0xF262004E, 0x6C0695ED, 0x1B01A57B, 0x8208F4C1, 0xF50FC457,
+  0x65B0D9C6, 0x12B7E950, 0x8BBEB8EA, 0xFCB9887C, 0x62DD1DDF, 0x15DA2D49, 0x8CD37CF3, 0xFBD44C65,
+  0x4DB26158, 0x3AB551CE, 0xA3BC0074, 0xD4BB30E2, 0x4ADFA541, 0x3DD895D7, 0xA4D1C46D, 0xD3D6F4FB,
+  0x4369E96A, 0x346ED9FC, 0xAD678846, 0xDA60B8D0, 0x44042D73, 0x33031DE5, 0xAA0A4C5F, 0xDD0D7CC9,
+  0x5005713C, 0x270241AA, 0xBE0B1010, 0xC90C2086, 0x5768B525, 0x206F85B3, 0xB966D409, 0xCE61E49F,
+  0x5EDEF90E, 0x29D9C998, 0xB0D09822, 0xC7D7A8B4, 0x59B33D17, 0x2EB40D81, 0xB7BD5C3B, 0xC0BA6CAD,
+  0xEDB88320, 0x9ABFB3B6, 0x03B6E20C, 0x74B1D29A, 0xEAD54739, 0x9DD277AF, 0x04DB2615, 0x73DC1683,
+  0xE3630B12, 0x94643B84, 0x0D6D6A3E, 0x7A6A5AA8, 0xE40ECF0B, 0x9309FF9D, 0x0A00AE27, 0x7D079EB1,
+  0xF00F9344, 0x8708A3D2, 0x1E01F268, 0x6906C2FE, 0xF762575D, 0x806567CB, 0x196C3671, 0x6E6B06E7,
+  0xFED41B76, 0x89D32BE0, 0x10DA7A5A, 0x67DD4ACC, 0xF9B9DF6F, 0x8EBEEFF9, 0x17B7BE43, 0x60B08ED5,
+  0xD6D6A3E8, 0xA1D1937E, 0x38D8C2C4, 0x4FDFF252, 0xD1BB67F1, 0xA6BC5767, 0x3FB506DD, 0x48B2364B,
+  0xD80D2BDA, 0xAF0A1B4C, 0x36034AF6, 0x41047A60, 0xDF60EFC3, 0xA867DF55, 0x316E8EEF, 0x4669BE79,
+  0xCB61B38C, 0xBC66831A, 0x256FD2A0, 0x5268E236, 0xCC0C7795, 0xBB0B4703, 0x220216B9, 0x5505262F,
+  0xC5BA3BBE, 0xB2BD0B28, 0x2BB45A92, 0x5CB36A04, 0xC2D7FFA7, 0xB5D0CF31, 0x2CD99E8B, 0x5BDEAE1D,
+  0x9B64C2B0, 0xEC63F226, 0x756AA39C, 0x026D930A, 0x9C0906A9, 0xEB0E363F, 0x72076785, 0x05005713,
+  0x95BF4A82, 0xE2B87A14, 0x7BB12BAE, 0x0CB61B38, 0x92D28E9B, 0xE5D5BE0D, 0x7CDCEFB7, 0x0BDBDF21,
+  0x86D3D2D4, 0xF1D4E242, 0x68DDB3F8, 0x1FDA836E, 0x81BE16CD, 0xF6B9265B, 0x6FB077E1, 0x18B74777,
+  0x88085AE6, 0xFF0F6A70, 0x66063BCA, 0x11010B5C, 0x8F659EFF, 0xF862AE69, 0x616BFFD3, 0x166CCF45,
+  0xA00AE278, 0xD70DD2EE, 0x4E048354, 0x3903B3C2, 0xA7672661, 0xD06016F7, 0x4969474D, 0x3E6E77DB,
+  0xAED16A4A, 0xD9D65ADC, 0x40DF0B66, 0x37D83BF0, 0xA9BCAE53, 0xDEBB9EC5, 0x47B2CF7F, 0x30B5FFE9,
+  0xBDBDF21C, 0xCABAC28A, 0x53B39330, 0x24B4A3A6, 0xBAD03605, 0xCDD70693, 0x54DE5729, 0x23D967BF,
+  0xB3667A2E, 0xC4614AB8, 0x5D681B02, 0x2A6F2B94, 0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D
+};
+
+} // namespace ethernetDeflate
+
+// Deflate encoder compressing a response as it's sent, in constant memory: a window of 2^HTTP_DEFLATE_WINDOW_BITS
+// bytes kept twice for the matches to be found in, a hash table of 2^HTTP_DEFLATE_HASH_BITS positions, without
+// chains, and HTTP_DEFLATE_OUTPUT_BUFLEN bytes of output, passed to the writer each time they're full.
+// Matches are found greedily, with one probe of the hash table, and coded with the fixed Huffman codes, so that
+// nothing has to be buffered to build a code table. Text and JSON compress 3 to 6 times.
+// Only depends on <string.h>, pgm_read_byte() and pgm_read_dword(), to be built and measured on a host as well
+class ethernetDeflateEncoder
+{
+  public:
+
+    typedef void (*TWriteFunction)(void* context, const uint8_t* data, size_t length);
+
+    ethernetDeflateEncoder(TWriteFunction writer, void* context)
+      : _writer(writer)
+      , _context(context)
+      , _encoding(ENCODING_NONE)
+      , _pos(0)
+      , _end(0)
+      , _bitBuf(0)
+      , _bitCount(0)
+      , _outLength(0)
+      , _checksum(0)
+      , _inputLength(0)
+      , _stats()
+    {
+      _stats.memory = sizeof(*this);
+    }
+
+    ////////////////////////////////////////
+
+    // Start the stream of a new response, in encoding
+    void begin(HTTPContentEncoding encoding)
+    {
+      _encoding     = encoding;
+      _pos          = 0;
+      _end          = 0;
+      _bitBuf       = 0;
+      _bitCount     = 0;
+      _outLength    = 0;
+      _inputLength  = 0;
+
+      memset(_head, 0, sizeof(_head));
+
+      if (encoding == ENCODING_GZIP)
+      {
+        // No name nor time, unknown OS
+        static const uint8_t gzipHeader[] = { 0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF };
+
+        for (uint8_t i = 0; i < sizeof(gzipHeader); i++)
+          _putByte(gzipHeader[i]);
+
+        _checksum = 0xFFFFFFFF;
+      }
+      else
+      {
+        // Window size, fastest level
+        uint8_t cmf = ((HTTP_DEFLATE_WINDOW_BITS - 8) << 4) | 0x08;
+
+        _putByte(cmf);
+        _putByte(31 - (cmf << 8) % 31);
+
+        _checksum = 1;
+      }
+
+      // One last block, with the fixed codes
+      _putBits(0x03, 3);
+    }
+
+    ////////////////////////////////////////
+
+    // Compress length bytes of content. Output is written once HTTP_DEFLATE_OUTPUT_BUFLEN bytes are ready
+    void write(const uint8_t* data, size_t length)
+    {
+      _inputLength        += length;
+      _stats.inputBytes   += length;
+
+      while (length)
+      {
+        if (_end == BUFFER_SIZE)
+          _slide();
+
+        size_t toCopy = BUFFER_SIZE - _end;
+
+        if (toCopy > length)
+          toCopy = length;
+
+        memcpy(_window + _end, data, toCopy);
+        _updateChecksum(_window + _end, toCopy);
+
+        _end   += toCopy;
+        data   += toCopy;
+        length -= toCopy;
+
+        _compress(false);
+      }
+    }
+
+    ////////////////////////////////////////
+
+    // Compress what is left, end the stream and write the output
+    void finish()
+    {
+      _compress(true);
+
+      // End of block
+      _putSymbol(256);
+
+      if (_bitCount)
+        _putByte(_bitBuf);
+
+      _bitBuf   = 0;
+      _bitCount = 0;
+
+      if (_encoding == ENCODING_GZIP)
+      {
+        _putWord(~_checksum);
+        _putWord(_inputLength);
+      }
+      else
+      {
+        // Adler-32, big-endian
+        for (int8_t shift = 24; shift >= 0; shift -= 8)
+          _putByte(_checksum >> shift);
+      }
+
+      _flush();
+
+      _stats.responses++;
+    }
+
+    ////////////////////////////////////////
+
+    const ethernetDeflateStats& stats() const
+    {
+      return _stats;
+    }
+
+    ////////////////////////////////////////
+
+    void resetStats()
+    {
+      _stats        = ethernetDeflateStats();
+      _stats.memory = sizeof(*this);
+    }
+
+    ////////////////////////////////////////
+
+  private:
+
+    static const uint16_t WINDOW_SIZE = 1 << HTTP_DEFLATE_WINDOW_BITS;
+    static const uint16_t BUFFER_SIZE = 2 * WINDOW_SIZE;
+    static const uint16_t HASH_SIZE   = 1 << HTTP_DEFLATE_HASH_BITS;
+    static const uint16_t MIN_MATCH   = 3;
+    // Bytes needed ahead of a position to find its longest match, at most half the window to keep half of it
+    static const uint16_t MAX_MATCH   = (WINDOW_SIZE / 2 < 258) ? WINDOW_SIZE / 2 : 258;
+
+    ////////////////////////////////////////
+
+    // Encode the bytes of the window from _pos, while MAX_MATCH of them are ahead, or up to the end if flush
+    void _compress(bool flush)
+    {
+      uint16_t lookahead = flush ? 1 : MAX_MATCH;
+
+      while (_end - _pos >= lookahead)
+      {
+        uint16_t avail  = _end - _pos;
+        uint16_t length = 0;
+        uint16_t distance = 0;
+
+        if (avail >= MIN_MATCH)
+        {
+          uint16_t  hash      = _hash(_window + _pos);
+          uint16_t  candidate = _head[hash];
+
+          _head[hash] = _pos + 1;
+
+          if ( candidate && (_pos + 1 - candidate <= WINDOW_SIZE) )
+          {
+            const uint8_t* match    = _window + candidate - 1;
+            const uint8_t* current  = _window + _pos;
+            uint16_t       maxLength = MAX_MATCH;
+
+            if (maxLength > avail)
+              maxLength = avail;
+
+            while ( (length < maxLength) && (match[length] == current[length]) )
+              length++;
+
+            distance = _pos + 1 - candidate;
+          }
+        }
+
+        if (length >= MIN_MATCH)
+        {
+          _putMatch(length, distance);
+
+          // The positions inside the match can be matched by the next ones
+          uint16_t last = (_pos + length + MIN_MATCH <= _end) ? _pos + length : _end - MIN_MATCH + 1;
+
+          for (uint16_t p = _pos + 1; p < last; p++)
+            _head[_hash(_window + p)] = p + 1;
+
+          _pos += length;
+        }
+        else
+        {
+          _putSymbol(_window[_pos]);
+          _pos++;
+        }
+      }
+    }
+
+    ////////////////////////////////////////
+
+    // Drop the oldest bytes of the window, keeping WINDOW_SIZE of them behind _pos
+    void _slide()
+    {
+      uint16_t delta = _pos - WINDOW_SIZE;
+
+      memmove(_window, _window + delta, _end - delta);
+      _pos -= delta;
+      _end -= delta;
+
+      for (uint16_t i = 0; i < HASH_SIZE; i++)
+        _head[i] = (_head[i] > delta) ? _head[i] - delta : 0;
+    }
+
+    ////////////////////////////////////////
+
+    static uint16_t _hash(const uint8_t* p)
+    {
+      uint32_t bytes = ((uint32_t) p[0] << 16) | ((uint32_t) p[1] << 8) | p[2];
+
+      return (uint32_t) (bytes * (uint32_t) 2654435761UL) >> (32 - HTTP_DEFLATE_HASH_BITS);
+    }
+
+    ////////////////////////////////////////
+
+    void _updateChecksum(const uint8_t* data, size_t length)
+    {
+      if (_encoding == ENCODING_GZIP)
+      {
+        uint32_t crc = _checksum;
+
+        while (length--)
+          crc = (crc >> 8) ^ pgm_read_dword(&ethernetDeflate::crcTable[(crc ^ *data++) & 0xFF]);
+
+        _checksum = crc;
+      }
+      else
+      {
+        uint32_t a = _checksum & 0xFFFF;
+        uint32_t b = _checksum >> 16;
+
+        while (length)
+        {
+          // Largest run without overflow of b before the modulo
+          size_t run = (length < 5552) ? length : 5552;
+
+          length -= run;
+
+          while (run--)
+          {
+            a += *data++;
+            b += a;
+          }
+
+          a %= 65521;
+          b %= 65521;
+        }
+
+        _checksum = (b << 16) | a;
+      }
+    }
+
+    ////////////////////////////////////////
+
+    // Huffman codes are sent from their most significant bit. Codes are 9 bits at most
+    static uint16_t _reverse(uint16_t code, uint8_t bits)
+    {
+      uint16_t reversed = (pgm_read_byte(&ethernetDeflate::reverseTable[code & 0x0F]) << 12)
+                          | (pgm_read_byte(&ethernetDeflate::reverseTable[(code >> 4) & 0x0F]) << 8)
+                          | (pgm_read_byte(&ethernetDeflate::reverseTable[(code >> 8) & 0x0F]) << 4);
+
+      return reversed >> (16 - bits);
+    }
+
+    ////////////////////////////////////////
+
+    // Literal, end of block or length code, with the fixed code of RFC 1951 3.2.6
+    void _putSymbol(uint16_t symbol)
+    {
+      if (symbol < 144)
+        _putBits(_reverse(0x30 + symbol, 8), 8);
+      else if (symbol < 256)
+        _putBits(_reverse(0x190 + symbol - 144, 9), 9);
+      else if (symbol < 280)
+        _putBits(_reverse(symbol - 256, 7), 7);
+      else
+        _putBits(_reverse(0xC0 + symbol - 280, 8), 8);
+    }
+
+    ////////////////////////////////////////
+
+    // Length code and distance code, each followed by its extra bits
+    void _putMatch(uint16_t length, uint16_t distance)
+    {
+      uint16_t x = length - MIN_MATCH;
+
+      if (x < 8)
+      {
+        _putSymbol(257 + x);
+      }
+      else if (x == 255)
+      {
+        _putSymbol(285);
+      }
+      else
+      {
+        uint8_t log2  = _log2(x);
+        uint8_t extra = log2 - 2;
+
+        _putSymbol(257 + 4 * (log2 - 1) + ((x >> extra) & 0x03));
+        _putBits(x & ((1 << extra) - 1), extra);
+      }
+
+      x = distance - 1;
+
+      if (x < 4)
+      {
+        _putBits(_reverse(x, 5), 5);
+      }
+      else
+      {
+        uint8_t log2  = _log2(x);
+        uint8_t extra = log2 - 1;
+
+        _putBits(_reverse(2 * log2 + ((x >> extra) & 0x01), 5), 5);
+        _putBits(x & ((1 << extra) - 1), extra);
+      }
+    }
+
+    ////////////////////////////////////////
+
+    static uint8_t _log2(uint16_t x)
+    {
+      uint8_t log2 = 0;
+
+      while (x >>= 1)
+        log2++;
+
+      return log2;
+    }
+
+    ////////////////////////////////////////
+
+    // Bits are packed from the least significant bit of each byte
+    void _putBits(uint32_t bits, uint8_t count)
+    {
+      _bitBuf   |= bits << _bitCount;
+      _bitCount += count;
+
+      while (_bitCount >= 8)
+      {
+        _putByte(_bitBuf);
+        _bitBuf  >>= 8;
+        _bitCount -= 8;
+      }
+    }
+
+    ////////////////////////////////////////
+
+    // Little-endian
+    void _putWord(uint32_t word)
+    {
+      for (uint8_t i = 0; i < 4; i++)
+      {
+        _putByte(word);
+        word >>= 8;
+      }
+    }
+
+    ////////////////////////////////////////
+
+    void _putByte(uint8_t byte)
+    {
+      _out[_outLength++] = byte;
+
+      if (_outLength == HTTP_DEFLATE_OUTPUT_BUFLEN)
+        _flush();
+    }
+
+    ////////////////////////////////////////
+
+    void _flush()
+    {
+      if (_outLength)
+      {
+        _writer(_context, _out, _outLength);
+
+        _stats.outputBytes += _outLength;
+        _outLength          = 0;
+      }
+    }
+
+    ////////////////////////////////////////
+
+    TWriteFunction        _writer;
+    void*                 _context;
+    HTTPContentEncoding   _encoding;
+    uint16_t              _pos;             // next byte of _window to encode
+    uint16_t              _end;             // bytes held in _window
+    uint32_t              _bitBuf;          // bits not output yet
+    uint8_t               _bitCount;
+    uint16_t              _outLength;
+    uint32_t              _checksum;        // CRC-32 for gzip, Adler-32 for deflate
+    uint32_t              _inputLength;
+    ethernetDeflateStats  _stats;
+    uint16_t              _head[HASH_SIZE];       // last position + 1 of each hash of 3 bytes, 0 if none
+    uint8_t               _window[BUFFER_SIZE];   // WINDOW_SIZE bytes already encoded, then those to encode
+    uint8_t               _out[HTTP_DEFLATE_OUTPUT_BUFLEN];
+};
+
+#endif // DEFLATE_ENCODER_H
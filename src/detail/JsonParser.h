@@ -0,0 +1,705 @@
+/****************************************************************************************************************************
+  JsonParser.h - Dead simple web-server.
+  For Ethernet shields
+
+  EthernetWebServer is a library for the Ethernet shields to run WebServer
+
+  Based on and modified from ESP8266 https://github.com/esp8266/Arduino/releases
+  Built by Khoi Hoang https://github.com/khoih-prog/EthernetWebServer
+  Licensed under MIT license
+
+  Original author:
+  @file       Esp8266WebServer.h
+  @author     Ivan Grokhotkov
+
+  Version: 2.3.0
+
+  Version Modified By   Date      Comments
+  ------- -----------  ---------- -----------
+  1.0.0   K Hoang      13/02/2020 Initial coding for Arduino Mega, Teensy, etc to support Ethernetx libraries
+  ...
+  2.0.0   K Hoang      16/01/2022 To coexist with ESP32 WebServer and ESP8266 ESP8266WebServer
+  2.0.1   K Hoang      02/03/2022 Fix decoding error bug
+  2.0.2   K Hoang      14/03/2022 Fix bug when using QNEthernet staticIP. Add staticIP option to NativeEthernet
+  2.1.0   K Hoang      03/04/2022 Use Ethernet_Generic library as default. Support SPI2 for ESP32
+  2.1.1   K Hoang      04/04/2022 Fix compiler error for Portenta_H7 using Portenta Ethernet
+  2.1.2   K Hoang      08/04/2022 Add support to SPI1 for RP2040 using arduino-pico core
+  2.1.3   K Hoang      27/04/2022 Change from `arduino.cc` to `arduino.tips` in examples
+  2.2.0   K Hoang      05/05/2022 Add support to custom SPI for Teensy, Mbed RP2040, Portenta_H7, etc.
+  2.2.1   K Hoang      25/08/2022 Auto-select SPI SS/CS pin according to board package
+  2.2.2   K Hoang      06/09/2022 Slow SPI clock for old W5100 shield or SAMD Zero. Improve support for SAMD21
+  2.2.3   K Hoang      17/09/2022 Add support to AVR Dx (AVR128Dx, AVR64Dx, AVR32Dx, etc.) using DxCore
+  2.2.4   K Hoang      26/10/2022 Add support to Seeed XIAO_NRF52840 and XIAO_NRF52840_SENSE using `mbed` or `nRF52` core
+  2.3.0   K Hoang      15/11/2022 Add new features, such as CORS. Update code and examples to send big data
+ *************************************************************************************************************************************/
+
+#pragma once
+
+#ifndef JSON_PARSER_H
+#define JSON_PARSER_H
+
+#include <ctype.h>
+#include <string.h>
+
+#include "Debug.h"
+
+enum HTTPJsonType
+{
+  JSON_STRING,
+  JSON_NUMBER,
+  JSON_BOOL,
+  JSON_NULL
+};
+
+enum HTTPJsonError
+{
+  JSON_OK,
+  JSON_INCOMPLETE,        // the document isn't complete yet, or the body ended before it
+  JSON_SYNTAX_ERROR,
+  JSON_TOO_DEEP,          // more than HTTP_JSON_MAX_DEPTH nested objects and arrays
+  JSON_TOO_LONG,          // path longer than HTTP_JSON_PATH_LEN, key or number longer than HTTP_JSON_VALUE_LEN
+  JSON_NOT_JSON           // Content-Type of the request isn't application/json
+};
+
+// Value of a JSON document, passed to the value handler as soon as it's parsed
+typedef struct
+{
+  HTTPJsonType  type;
+  const char*   path;       // "wifi.ssid", "leds[2].on", or "" for a document which is a single value
+  const char*   value;      // NUL-terminated: a string unescaped, a number as written, "true", "false" or "null"
+  uint16_t      length;     // of value
+  bool          truncated;  // string longer than HTTP_JSON_VALUE_LEN - 1 chars, cut
+} ethernetJsonValue;
+
+// Tokenizer of a JSON document received in pieces, calling its value handler for each string, number, boolean and
+// null with the path leading to it. Nothing of the document is kept but the path to the current value and the
+// value itself, in fixed buffers, so that a document of any size is parsed in constant memory
+class ethernetJsonParser
+{
+  public:
+
+    typedef vl::Func<void(void)> TValueFunction;
+
+    ethernetJsonParser()
+    {
+      begin();
+    }
+
+    ////////////////////////////////////////
+
+    // Get ready for a new document
+    void begin()
+    {
+      _state    = JS_VALUE;
+      _error    = JSON_INCOMPLETE;
+      _depth    = 0;
+      _pathLen  = 0;
+      _path[0]  = 0;
+    }
+
+    ////////////////////////////////////////
+
+    // Parse length more bytes of the document, calling fn for each value. Return false once an error was found
+    bool feed(const uint8_t* data, size_t length, const TValueFunction& fn)
+    {
+      for (size_t i = 0; (i < length) && (_state != JS_ERROR); i++)
+        _parseChar((char) data[i], fn);
+
+      return (_state != JS_ERROR);
+    }
+
+    ////////////////////////////////////////
+
+    // End of the document, a number ending it being complete. Return true if the document was valid
+    bool end(const TValueFunction& fn)
+    {
+      if ( (_state == JS_LITERAL) && (_depth == 0) )
+        _endLiteral(fn);
+
+      if (_state == JS_DONE)
+        _error = JSON_OK;
+
+      return (_error == JSON_OK);
+    }
+
+    ////////////////////////////////////////
+
+    void fail(HTTPJsonError error)
+    {
+      ET_LOGDEBUG1(F("JSON error:"), error);
+
+      _error = error;
+      _state = JS_ERROR;
+    }
+
+    ////////////////////////////////////////
+
+    HTTPJsonError error() const
+    {
+      return _error;
+    }
+
+    ////////////////////////////////////////
+
+    const ethernetJsonValue& value() const
+    {
+      return _value;
+    }
+
+    ////////////////////////////////////////
+
+  private:
+
+    enum State : uint8_t
+    {
+      JS_VALUE,           // value expected
+      JS_FIRST_VALUE,     // after '[': value or ']'
+      JS_FIRST_KEY,       // after '{': key or '}'
+      JS_KEY,             // after ',' in an object
+      JS_COLON,
+      JS_AFTER_VALUE,     // ',' or the end of the object or array
+      JS_STRING,
+      JS_ESCAPE,          // after '\' in a string
+      JS_UNICODE,         // in the 4 hex digits of "\uXXXX"
+      JS_LITERAL,         // number, true, false or null
+      JS_DONE,
+      JS_ERROR
+    };
+
+    ////////////////////////////////////////
+
+    void _parseChar(char c, const TValueFunction& fn)
+    {
+      switch (_state)
+      {
+        case JS_STRING:
+
+          if (c == '"')
+            _endString(fn);
+          else if (c == '\\')
+            _state = JS_ESCAPE;
+          else if ((uint8_t) c < 0x20)
+            fail(JSON_SYNTAX_ERROR);
+          else
+            _appendUtf8(c);
+
+          return;
+
+        case JS_ESCAPE:
+
+          _parseEscape(c);
+
+          return;
+
+        case JS_UNICODE:
+
+          _parseUnicode(c);
+
+          return;
+
+        case JS_LITERAL:
+
+          if ( isalnum((unsigned char) c) || (c == '-') || (c == '+') || (c == '.') )
+          {
+            _append(c);
+
+            return;
+          }
+
+          // The literal ends before c, which is parsed next
+          if (!_endLiteral(fn))
+            return;
+
+          break;
+
+        default:
+          break;
+      }
+
+      if ( (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n') )
+        return;
+
+      switch (_state)
+      {
+        case JS_FIRST_VALUE:
+
+          if (c == ']')
+          {
+            _close(c);
+
+            break;
+          }
+
+          _beginValue(c);
+
+          break;
+
+        case JS_VALUE:
+
+          _beginValue(c);
+
+          break;
+
+        case JS_FIRST_KEY:
+
+          if (c == '}')
+          {
+            _close(c);
+
+            break;
+          }
+
+          // fall through
+
+        case JS_KEY:
+
+          if (c != '"')
+          {
+            fail(JSON_SYNTAX_ERROR);
+
+            break;
+          }
+
+          _beginString(true);
+
+          break;
+
+        case JS_COLON:
+
+          if (c == ':')
+            _state = JS_VALUE;
+          else
+            fail(JSON_SYNTAX_ERROR);
+
+          break;
+
+        case JS_AFTER_VALUE:
+
+          if (c == ',')
+          {
+            if (_containers[_depth - 1] == '{')
+            {
+              _state = JS_KEY;
+            }
+            else
+            {
+              _index[_depth - 1]++;
+              _state = JS_VALUE;
+              _setIndexPath();
+            }
+          }
+          else if ( (c == '}') || (c == ']') )
+          {
+            _close(c);
+          }
+          else
+          {
+            fail(JSON_SYNTAX_ERROR);
+          }
+
+          break;
+
+        default:
+
+          // Anything but whitespace after the document
+          fail(JSON_SYNTAX_ERROR);
+
+          break;
+      }
+    }
+
+    ////////////////////////////////////////
+
+    void _beginValue(char c)
+    {
+      if ( (c == '{') || (c == '[') )
+      {
+        if (_depth == HTTP_JSON_MAX_DEPTH)
+        {
+          fail(JSON_TOO_DEEP);
+
+          return;
+        }
+
+        _containers[_depth] = c;
+        _pathBase[_depth]   = _pathLen;
+        _index[_depth]      = 0;
+        _depth++;
+
+        if (c == '{')
+        {
+          _state = JS_FIRST_KEY;
+        }
+        else
+        {
+          // Set first, an index path too long failing the document
+          _state = JS_FIRST_VALUE;
+          _setIndexPath();
+        }
+      }
+      else if (c == '"')
+      {
+        _beginString(false);
+      }
+      else if ( isalnum((unsigned char) c) || (c == '-') )
+      {
+        _valueLen   = 0;
+        _truncated  = false;
+        _append(c);
+        _state      = JS_LITERAL;
+      }
+      else
+      {
+        fail(JSON_SYNTAX_ERROR);
+      }
+    }
+
+    ////////////////////////////////////////
+
+    void _close(char c)
+    {
+      if (_containers[_depth - 1] != ( (c == '}') ? '{' : '[' ))
+      {
+        fail(JSON_SYNTAX_ERROR);
+
+        return;
+      }
+
+      _depth--;
+      _pathLen        = _pathBase[_depth];
+      _path[_pathLen] = 0;
+
+      _endValue();
+    }
+
+    ////////////////////////////////////////
+
+    void _endValue()
+    {
+      _state = _depth ? JS_AFTER_VALUE : JS_DONE;
+    }
+
+    ////////////////////////////////////////
+
+    void _emit(HTTPJsonType type, const TValueFunction& fn)
+    {
+      _buf[_valueLen] = 0;
+
+      _value.type       = type;
+      _value.path       = _path;
+      _value.value      = _buf;
+      _value.length     = _valueLen;
+      _value.truncated  = _truncated;
+
+      if (fn)
+        fn();
+
+      _endValue();
+    }
+
+    ////////////////////////////////////////
+
+    void _beginString(bool isKey)
+    {
+      _isKey          = isKey;
+      _valueLen       = 0;
+      _truncated      = false;
+      _highSurrogate  = 0;
+      _state          = JS_STRING;
+    }
+
+    ////////////////////////////////////////
+
+    void _endString(const TValueFunction& fn)
+    {
+      _flushSurrogate();
+
+      if (!_isKey)
+      {
+        _emit(JSON_STRING, fn);
+
+        return;
+      }
+
+      // Path of the member: path of the object, '.', key
+      uint16_t base = _pathBase[_depth - 1];
+
+      _pathLen = base;
+
+      if ( _truncated || !_appendPath(".", base ? 1 : 0) || !_appendPath(_buf, _valueLen) )
+      {
+        fail(JSON_TOO_LONG);
+
+        return;
+      }
+
+      _state = JS_COLON;
+    }
+
+    ////////////////////////////////////////
+
+    bool _endLiteral(const TValueFunction& fn)
+    {
+      _buf[_valueLen] = 0;
+
+      if (_truncated)
+      {
+        fail(JSON_TOO_LONG);
+
+        return false;
+      }
+
+      if ( (strcmp(_buf, "true") == 0) || (strcmp(_buf, "false") == 0) )
+        _emit(JSON_BOOL, fn);
+      else if (strcmp(_buf, "null") == 0)
+        _emit(JSON_NULL, fn);
+      else if (_isNumber(_buf))
+        _emit(JSON_NUMBER, fn);
+      else
+        fail(JSON_SYNTAX_ERROR);
+
+      return (_state != JS_ERROR);
+    }
+
+    ////////////////////////////////////////
+
+    // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+    static bool _isNumber(const char* p)
+    {
+      if (*p == '-')
+        p++;
+
+      if (*p == '0')
+        p++;
+      else if (!_skipDigits(p))
+        return false;
+
+      if ( (*p == '.') && !_skipDigits(++p) )
+        return false;
+
+      if ( (*p == 'e') || (*p == 'E') )
+      {
+        p++;
+
+        if ( (*p == '+') || (*p == '-') )
+          p++;
+
+        if (!_skipDigits(p))
+          return false;
+      }
+
+      return (*p == 0);
+    }
+
+    ////////////////////////////////////////
+
+    // Skip the digits at p, return false if there is none
+    static bool _skipDigits(const char*& p)
+    {
+      const char* start = p;
+
+      while ( (*p >= '0') && (*p <= '9') )
+        p++;
+
+      return (p > start);
+    }
+
+    ////////////////////////////////////////
+
+    void _parseEscape(char c)
+    {
+      static const char escapes[] = "\"\"\\\\//b\bf\fn\nr\rt\t";
+
+      _state = JS_STRING;
+
+      if (c == 'u')
+      {
+        _codePoint  = 0;
+        _hexCount   = 0;
+        _state      = JS_UNICODE;
+
+        return;
+      }
+
+      for (const char* e = escapes; *e; e += 2)
+      {
+        if (*e == c)
+        {
+          _appendUtf8(e[1]);
+
+          return;
+        }
+      }
+
+      fail(JSON_SYNTAX_ERROR);
+    }
+
+    ////////////////////////////////////////
+
+    void _parseUnicode(char c)
+    {
+      uint8_t digit;
+
+      if ( (c >= '0') && (c <= '9') )
+        digit = c - '0';
+      else if ( ((c | 0x20) >= 'a') && ((c | 0x20) <= 'f') )
+        digit = (c | 0x20) - 'a' + 10;
+      else
+      {
+        fail(JSON_SYNTAX_ERROR);
+
+        return;
+      }
+
+      _codePoint = (_codePoint << 4) | digit;
+
+      if (++_hexCount < 4)
+        return;
+
+      _state = JS_STRING;
+
+      if ( (_codePoint >= 0xD800) && (_codePoint < 0xDC00) )
+      {
+        // High surrogate, combined with the low surrogate expected next
+        _flushSurrogate();
+        _highSurrogate = _codePoint;
+
+        return;
+      }
+
+      if ( (_codePoint >= 0xDC00) && (_codePoint < 0xE000) )
+      {
+        if (!_highSurrogate)
+        {
+          _appendCodePoint(0xFFFD);
+
+          return;
+        }
+
+        _codePoint      = 0x10000 + (((uint32_t) (_highSurrogate - 0xD800)) << 10) + (_codePoint - 0xDC00);
+        _highSurrogate  = 0;
+      }
+
+      _flushSurrogate();
+      _appendCodePoint(_codePoint);
+    }
+
+    ////////////////////////////////////////
+
+    // A high surrogate not followed by a low one is replaced by U+FFFD
+    void _flushSurrogate()
+    {
+      if (_highSurrogate)
+      {
+        _highSurrogate = 0;
+        _appendCodePoint(0xFFFD);
+      }
+    }
+
+    ////////////////////////////////////////
+
+    void _appendUtf8(char c)
+    {
+      _flushSurrogate();
+      _append(c);
+    }
+
+    ////////////////////////////////////////
+
+    void _appendCodePoint(uint32_t cp)
+    {
+      if (cp < 0x80)
+      {
+        _append(cp);
+      }
+      else if (cp < 0x800)
+      {
+        _append(0xC0 | (cp >> 6));
+        _append(0x80 | (cp & 0x3F));
+      }
+      else if (cp < 0x10000)
+      {
+        _append(0xE0 | (cp >> 12));
+        _append(0x80 | ((cp >> 6) & 0x3F));
+        _append(0x80 | (cp & 0x3F));
+      }
+      else
+      {
+        _append(0xF0 | (cp >> 18));
+        _append(0x80 | ((cp >> 12) & 0x3F));
+        _append(0x80 | ((cp >> 6) & 0x3F));
+        _append(0x80 | (cp & 0x3F));
+      }
+    }
+
+    ////////////////////////////////////////
+
+    void _append(char c)
+    {
+      if (_valueLen < HTTP_JSON_VALUE_LEN - 1)
+        _buf[_valueLen++] = c;
+      else
+        _truncated = true;
+    }
+
+    ////////////////////////////////////////
+
+    bool _appendPath(const char* str, size_t length)
+    {
+      if (_pathLen + length >= HTTP_JSON_PATH_LEN)
+        return false;
+
+      memcpy(_path + _pathLen, str, length);
+
+      _pathLen        += length;
+      _path[_pathLen]  = 0;
+
+      return true;
+    }
+
+    ////////////////////////////////////////
+
+    // Path of the current element of an array: path of the array, "[index]"
+    void _setIndexPath()
+    {
+      char digits[8];
+      uint8_t pos   = sizeof(digits);
+      uint16_t index = _index[_depth - 1];
+
+      digits[--pos] = ']';
+
+      do
+      {
+        digits[--pos] = '0' + (index % 10);
+        index /= 10;
+      } while (index);
+
+      digits[--pos] = '[';
+
+      _pathLen = _pathBase[_depth - 1];
+
+      if (!_appendPath(digits + pos, sizeof(digits) - pos))
+        fail(JSON_TOO_LONG);
+    }
+
+    ////////////////////////////////////////
+
+    State             _state;
+    HTTPJsonError     _error;
+    bool              _isKey;
+    bool              _truncated;
+    uint8_t           _depth;
+    uint8_t           _hexCount;
+    uint16_t          _highSurrogate;
+    uint32_t          _codePoint;
+    uint16_t          _valueLen;
+    uint16_t          _pathLen;
+    char              _containers[HTTP_JSON_MAX_DEPTH];   // '{' or '[' of each nesting level
+    uint16_t          _pathBase[HTTP_JSON_MAX_DEPTH];     // length of the path of the object or array of each level
+    uint16_t          _index[HTTP_JSON_MAX_DEPTH];        // current element of an array
+    char              _path[HTTP_JSON_PATH_LEN];
+    char              _buf[HTTP_JSON_VALUE_LEN];
+    ethernetJsonValue _value;
+};
+
+#endif // JSON_PARSER_H
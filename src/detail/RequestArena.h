@@ -0,0 +1,267 @@
+/****************************************************************************************************************************
+  RequestArena.h - Dead simple web-server.
+  For Ethernet shields
+
+  EthernetWebServer is a library for the Ethernet shields to run WebServer
+
+  Based on and modified from ESP8266 https://github.com/esp8266/Arduino/releases
+  Built by Khoi Hoang https://github.com/khoih-prog/EthernetWebServer
+  Licensed under MIT license
+
+  Original author:
+  @file       Esp8266WebServer.h
+  @author     Ivan Grokhotkov
+
+  Version: 2.3.0
+
+  Version Modified By   Date      Comments
+  ------- -----------  ---------- -----------
+  1.0.0   K Hoang      13/02/2020 Initial coding for Arduino Mega, Teensy, etc to support Ethernetx libraries
+  ...
+  2.0.0   K Hoang      16/01/2022 To coexist with ESP32 WebServer and ESP8266 ESP8266WebServer
+  2.0.1   K Hoang      02/03/2022 Fix decoding error bug
+  2.0.2   K Hoang      14/03/2022 Fix bug when using QNEthernet staticIP. Add staticIP option to NativeEthernet
+  2.1.0   K Hoang      03/04/2022 Use Ethernet_Generic library as default. Support SPI2 for ESP32
+  2.1.1   K Hoang      04/04/2022 Fix compiler error for Portenta_H7 using Portenta Ethernet
+  2.1.2   K Hoang      08/04/2022 Add support to SPI1 for RP2040 using arduino-pico core
+  2.1.3   K Hoang      27/04/2022 Change from `arduino.cc` to `arduino.tips` in examples
+  2.2.0   K Hoang      05/05/2022 Add support to custom SPI for Teensy, Mbed RP2040, Portenta_H7, etc.
+  2.2.1   K Hoang      25/08/2022 Auto-select SPI SS/CS pin according to board package
+  2.2.2   K Hoang      06/09/2022 Slow SPI clock for old W5100 shield or SAMD Zero. Improve support for SAMD21
+  2.2.3   K Hoang      17/09/2022 Add support to AVR Dx (AVR128Dx, AVR64Dx, AVR32Dx, etc.) using DxCore
+  2.2.4   K Hoang      26/10/2022 Add support to Seeed XIAO_NRF52840 and XIAO_NRF52840_SENSE using `mbed` or `nRF52` core
+  2.3.0   K Hoang      15/11/2022 Add new features, such as CORS. Update code and examples to send big data
+ *************************************************************************************************************************************/
+
+#pragma once
+
+#ifndef REQUEST_ARENA_H
+#define REQUEST_ARENA_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Debug.h"
+
+// Use of the request arena, kept over all requests, to size HTTP_REQUEST_ARENA_SIZE
+typedef struct
+{
+  size_t    size;             // HTTP_REQUEST_ARENA_SIZE
+  size_t    highWater;        // most bytes of the arena used by one request
+  size_t    heapHighWater;    // most bytes one request took from the heap, its arena being full
+  uint32_t  heapAllocs;       // allocations taken from the heap
+  uint32_t  failures;         // allocations which failed, their argument or body being dropped
+} ethernetArenaStats;
+
+// Bump allocator for what a request allocates while it's parsed: arguments, their decoded keys and values, and
+// the body. Nothing is freed one by one, everything is released by reset() at the end of the request, so the heap
+// isn't fragmented by the String and argument arrays of each request.
+// When the arena is full, allocations fall back to the heap if HTTP_REQUEST_ARENA_FALLBACK, and also are released
+// by reset()
+class ethernetRequestArena
+{
+  public:
+
+    ethernetRequestArena()
+      : _used(0)
+      , _heapBlocks(nullptr)
+      , _heapUsed(0)
+      , _stats()
+    {
+      _stats.size = HTTP_REQUEST_ARENA_SIZE;
+    }
+
+    ////////////////////////////////////////
+
+    ~ethernetRequestArena()
+    {
+      reset();
+    }
+
+    ////////////////////////////////////////
+
+    // Return size bytes aligned on align (a power of 2, at most the alignment of a pointer), or nullptr
+    void* alloc(size_t size, size_t align = 1)
+    {
+      size_t start = (_used + align - 1) & ~(align - 1);
+
+      if ( (size <= HTTP_REQUEST_ARENA_SIZE) && (start + size <= HTTP_REQUEST_ARENA_SIZE) )
+      {
+        _used = start + size;
+
+        if (_used > _stats.highWater)
+          _stats.highWater = _used;
+
+        return _buf + start;
+      }
+
+      return _heapAlloc(size);
+    }
+
+    ////////////////////////////////////////
+
+    // Whether a string of length chars can be allocated at all, to check a length received before length + 1
+    // is computed
+    static bool canAllocString(size_t length)
+    {
+#if HTTP_REQUEST_ARENA_FALLBACK
+      return length < SIZE_MAX - sizeof(HeapBlock);
+#else
+      return length < HTTP_REQUEST_ARENA_SIZE;
+#endif
+    }
+
+    ////////////////////////////////////////
+
+    // Copy the length chars of str, NUL-terminated
+    char* copy(const char* str, size_t length)
+    {
+      char* dest = (char *) alloc(length + 1);
+
+      if (dest)
+      {
+        memcpy(dest, str, length);
+        dest[length] = 0;
+      }
+
+      return dest;
+    }
+
+    ////////////////////////////////////////
+
+    // Make room for addLength more chars after the length chars of str, NUL-terminated. The last string allocated
+    // grows in place, or with realloc() if it's from the heap, others are copied. Return the string, or nullptr with
+    // str left as it was
+    char* extend(const char* str, size_t length, size_t addLength)
+    {
+      if ( (str + length + 1 == (const char *) _buf + _used) && (_used + addLength <= HTTP_REQUEST_ARENA_SIZE) )
+      {
+        _used += addLength;
+
+        if (_used > _stats.highWater)
+          _stats.highWater = _used;
+
+        return (char *) str;
+      }
+
+      // Otherwise a string growing a line at a time would leave a copy of itself on the heap for each line
+      if ( _heapBlocks && (str == (const char *) (_heapBlocks + 1)) )
+        return _heapExtend(length, addLength);
+
+      char* dest = (char *) alloc(length + addLength + 1);
+
+      if (dest)
+        memcpy(dest, str, length + 1);
+
+      return dest;
+    }
+
+    ////////////////////////////////////////
+
+    // Release everything allocated since the last reset
+    void reset()
+    {
+      if (_heapUsed > _stats.heapHighWater)
+        _stats.heapHighWater = _heapUsed;
+
+      while (_heapBlocks)
+      {
+        HeapBlock* next = _heapBlocks->next;
+
+        free(_heapBlocks);
+        _heapBlocks = next;
+      }
+
+      _used     = 0;
+      _heapUsed = 0;
+    }
+
+    ////////////////////////////////////////
+
+    const ethernetArenaStats& stats() const
+    {
+      return _stats;
+    }
+
+    ////////////////////////////////////////
+
+    void resetStats()
+    {
+      _stats            = ethernetArenaStats();
+      _stats.size       = HTTP_REQUEST_ARENA_SIZE;
+      _stats.highWater  = _used;
+    }
+
+    ////////////////////////////////////////
+
+  private:
+
+    // Header of an allocation taken from the heap, the data following it
+    struct HeapBlock
+    {
+      HeapBlock* next;
+    };
+
+    ////////////////////////////////////////
+
+    void* _heapAlloc(size_t size)
+    {
+#if HTTP_REQUEST_ARENA_FALLBACK
+      HeapBlock* block = (size < SIZE_MAX - sizeof(HeapBlock)) ? (HeapBlock *) malloc(sizeof(HeapBlock) + size)
+                         : nullptr;
+
+      if (block)
+      {
+        block->next = _heapBlocks;
+        _heapBlocks = block;
+        _heapUsed  += size;
+
+        _stats.heapAllocs++;
+
+        ET_LOGDEBUG1(F("Request arena full, from heap:"), size);
+
+        return block + 1;
+      }
+#endif
+
+      _stats.failures++;
+
+      ET_LOGERROR1(F("Request arena full, can't allocate:"), size);
+
+      return nullptr;
+    }
+
+    ////////////////////////////////////////
+
+    // Grow the string of length chars in the last heap block by addLength chars
+    char* _heapExtend(size_t length, size_t addLength)
+    {
+      HeapBlock* block = (addLength < SIZE_MAX - sizeof(HeapBlock) - length - 1)
+                         ? (HeapBlock *) realloc(_heapBlocks, sizeof(HeapBlock) + length + addLength + 1) : nullptr;
+
+      if (!block)
+      {
+        _stats.failures++;
+
+        ET_LOGERROR1(F("Request arena full, can't allocate:"), length + addLength + 1);
+
+        return nullptr;
+      }
+
+      _heapBlocks = block;
+      _heapUsed  += addLength;
+
+      return (char *) (block + 1);
+    }
+
+    ////////////////////////////////////////
+
+    alignas(void*) uint8_t  _buf[HTTP_REQUEST_ARENA_SIZE];
+    size_t                  _used;
+    HeapBlock*              _heapBlocks;        // allocations taken from the heap, the last one first
+    size_t                  _heapUsed;
+    ethernetArenaStats      _stats;
+};
+
+#endif // REQUEST_ARENA_H
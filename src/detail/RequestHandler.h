@@ -42,6 +42,82 @@
   #define ETW_UNUSED(x) (void)(x)
 #endif
 
+inline char ethernetRouteChar(const char* p, bool inFlash)
+{
+  return inFlash ? (char) pgm_read_byte(p) : *p;
+}
+
+////////////////////////////////////////
+
+// Matches uri with the URI of a route, where "{name}" accepts one path segment, and a trailing "/*" all URIs
+// starting with the part before it. Returns the number of "{name}" segments, or -1 if uri doesn't match.
+// The first maxArgs segments are stored in args, as offset and length in uri. The route may be in PROGMEM
+inline int ethernetMatchRoute(const char* route, const char* uri, ethernetHTTPView* args, uint8_t maxArgs,
+                              bool inFlash = false)
+{
+  const char* uriStart = uri;
+  int count = 0;
+  char c;
+
+  while ( (c = ethernetRouteChar(route, inFlash)) )
+  {
+    if ( (c == '/') && (ethernetRouteChar(route + 1, inFlash) == '*') && !ethernetRouteChar(route + 2, inFlash) )
+      return count;
+
+    if (c == '{')
+    {
+      const char* close = route + 1;
+
+      while ( (c = ethernetRouteChar(close, inFlash)) && (c != '}') )
+        close++;
+
+      if (c)
+      {
+        size_t segmentLength = strcspn(uri, "/");
+
+        if (!segmentLength)
+          return -1;
+
+        if (count < maxArgs)
+          args[count] = { (uint16_t) (uri - uriStart), (uint16_t) segmentLength };
+
+        count++;
+        uri   += segmentLength;
+        route  = close + 1;
+
+        continue;
+      }
+
+      c = '{';
+    }
+
+    if (c != *uri)
+      return -1;
+
+    route++;
+    uri++;
+  }
+
+  return *uri ? -1 : count;
+}
+
+////////////////////////////////////////
+
+typedef void (*ethernetRouteFunction)(void);
+
+// Route of a table declared at compile time, and kept in flash with its URI. See EthernetWebServer::setRouteTable()
+typedef struct
+{
+  PGM_P                 uri;        // as for on(), "{name}" and a trailing "/*" are accepted
+  uint32_t              methods;    // ETHERNET_ROUTE_METHOD(HTTP_GET) | ETHERNET_ROUTE_METHOD(HTTP_POST), ...
+  ethernetRouteFunction fn;
+  ethernetRouteFunction ufn;        // upload handler, or nullptr
+} ethernetRoute;
+
+#define ETHERNET_ROUTE_METHOD(method)   ( ((method) == HTTP_ANY) ? 0xFFFFFFFFUL : (1UL << ((method) & 31)) )
+
+////////////////////////////////////////
+
 class ethernetRequestHandler
 {
   public:
@@ -79,6 +155,35 @@ class ethernetRequestHandler
       ETW_UNUSED(upload);
     }
 
+    // Handlers returning true get the body of the request with body() as it's received, instead of it being
+    // parsed into arguments
+    virtual bool canStreamBody(const HTTPMethod& method, const String& uri)
+    {
+      ETW_UNUSED(method);
+      ETW_UNUSED(uri);
+
+      return false;
+    }
+
+    virtual void body(EthernetWebServer& server, const String& requestUri, const ethernetHTTPBody& body)
+    {
+      ETW_UNUSED(server);
+      ETW_UNUSED(requestUri);
+      ETW_UNUSED(body);
+    }
+
+    // Handlers accepting the URIs matched by ethernetMatchRoute() return their route URI with the method they
+    // accept, to be found by the router of the server. canHandle() is then not called for each request
+    virtual const String* routeUri()
+    {
+      return nullptr;
+    }
+
+    virtual HTTPMethod routeMethod()
+    {
+      return HTTP_ANY;
+    }
+
     ethernetRequestHandler* next()
     {
       return _next;
@@ -94,4 +199,69 @@ class ethernetRequestHandler
     ethernetRequestHandler* _next = nullptr;
 };
 
+////////////////////////////////////////
+
+// Handler of the route of the table in flash found for the current request, owned by the server
+class ethernetTableRequestHandler : public ethernetRequestHandler
+{
+  public:
+
+    void route(const ethernetRoute& route)
+    {
+      _route = route;
+    }
+
+    PGM_P uri()
+    {
+      return _route.uri;
+    }
+
+    // A request of unknown method (HTTP_ANY) is only accepted by routes of all methods
+    static bool acceptsMethod(uint32_t methods, const HTTPMethod& requestMethod)
+    {
+      if (requestMethod == HTTP_ANY)
+        return (methods == ETHERNET_ROUTE_METHOD(HTTP_ANY));
+
+      return (methods & (1UL << ((uint8_t) requestMethod & 31)));
+    }
+
+    bool canHandle(const HTTPMethod& requestMethod, const String& requestUri) override
+    {
+      if (!_route.uri || !acceptsMethod(_route.methods, requestMethod))
+        return false;
+
+      return (ethernetMatchRoute(_route.uri, requestUri.c_str(), nullptr, 0, true) >= 0);
+    }
+
+    bool canUpload(const String& requestUri) override
+    {
+      return (_route.ufn && canHandle(HTTP_POST, requestUri));
+    }
+
+    bool handle(EthernetWebServer& server, const HTTPMethod& requestMethod, const String& requestUri) override
+    {
+      ETW_UNUSED(server);
+
+      if (!_route.fn || !canHandle(requestMethod, requestUri))
+        return false;
+
+      _route.fn();
+
+      return true;
+    }
+
+    void upload(EthernetWebServer& server, const String& requestUri, const ethernetHTTPUpload& upload) override
+    {
+      ETW_UNUSED(server);
+      ETW_UNUSED(upload);
+
+      if (canUpload(requestUri))
+        _route.ufn();
+    }
+
+  private:
+
+    ethernetRoute _route = { nullptr, 0, nullptr, nullptr };
+};
+
 #endif  // REQUEST_HANDLER_H
@@ -47,9 +47,11 @@ class ethernetFunctionRequestHandler : public ethernetRequestHandler
   public:
 
     ethernetFunctionRequestHandler(EthernetWebServer::THandlerFunction fn, EthernetWebServer::THandlerFunction ufn,
-                                   const String &uri, const HTTPMethod& method)
+                                   const String &uri, const HTTPMethod& method,
+                                   EthernetWebServer::THandlerFunction bfn = EthernetWebServer::THandlerFunction())
       : _fn(fn)
       , _ufn(ufn)
+      , _bfn(bfn)
       , _uri(uri)
       , _method(method)
     {
@@ -60,19 +62,8 @@ class ethernetFunctionRequestHandler : public ethernetRequestHandler
       if (_method != HTTP_ANY && _method != requestMethod)
         return false;
 
-      if (requestUri == _uri)
-        return true;
-
-      if (_uri.endsWith("/*"))
-      {
-        String _uristart = _uri;
-        _uristart.replace("/*", "");
-
-        if (requestUri.startsWith(_uristart))
-          return true;
-      }
-
-      return false;
+      // "/path/*" accepts all URIs starting with "/path", "/path/{id}" one more path segment
+      return (ethernetMatchRoute(_uri.c_str(), requestUri.c_str(), nullptr, 0) >= 0);
     }
 
     bool canUpload(const String& requestUri) override
@@ -103,9 +94,35 @@ class ethernetFunctionRequestHandler : public ethernetRequestHandler
         _ufn();
     }
 
+    bool canStreamBody(const HTTPMethod& requestMethod, const String& requestUri) override
+    {
+      return (_bfn && canHandle(requestMethod, requestUri));
+    }
+
+    void body(EthernetWebServer& server, const String& requestUri, const ethernetHTTPBody& body) override
+    {
+      ETW_UNUSED(server);
+      ETW_UNUSED(requestUri);
+      ETW_UNUSED(body);
+
+      if (_bfn)
+        _bfn();
+    }
+
+    const String* routeUri() override
+    {
+      return &_uri;
+    }
+
+    HTTPMethod routeMethod() override
+    {
+      return _method;
+    }
+
   protected:
     EthernetWebServer::THandlerFunction _fn;
     EthernetWebServer::THandlerFunction _ufn;
+    EthernetWebServer::THandlerFunction _bfn;
     String      _uri;
     HTTPMethod  _method;
 };
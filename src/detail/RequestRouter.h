@@ -0,0 +1,444 @@
+/****************************************************************************************************************************
+  RequestRouter.h - Dead simple web-server.
+  For Ethernet shields
+
+  EthernetWebServer is a library for the Ethernet shields to run WebServer
+
+  Based on and modified from ESP8266 https://github.com/esp8266/Arduino/releases
+  Built by Khoi Hoang https://github.com/khoih-prog/EthernetWebServer
+  Licensed under MIT license
+
+  Original author:
+  @file       Esp8266WebServer.h
+  @author     Ivan Grokhotkov
+
+  Version: 2.3.0
+
+  Version Modified By   Date      Comments
+  ------- -----------  ---------- -----------
+  1.0.0   K Hoang      13/02/2020 Initial coding for Arduino Mega, Teensy, etc to support Ethernetx libraries
+  ...
+  2.0.0   K Hoang      16/01/2022 To coexist with ESP32 WebServer and ESP8266 ESP8266WebServer
+  2.0.1   K Hoang      02/03/2022 Fix decoding error bug
+  2.0.2   K Hoang      14/03/2022 Fix bug when using QNEthernet staticIP. Add staticIP option to NativeEthernet
+  2.1.0   K Hoang      03/04/2022 Use Ethernet_Generic library as default. Support SPI2 for ESP32
+  2.1.1   K Hoang      04/04/2022 Fix compiler error for Portenta_H7 using Portenta Ethernet
+  2.1.2   K Hoang      08/04/2022 Add support to SPI1 for RP2040 using arduino-pico core
+  2.1.3   K Hoang      27/04/2022 Change from `arduino.cc` to `arduino.tips` in examples
+  2.2.0   K Hoang      05/05/2022 Add support to custom SPI for Teensy, Mbed RP2040, Portenta_H7, etc.
+  2.2.1   K Hoang      25/08/2022 Auto-select SPI SS/CS pin according to board package
+  2.2.2   K Hoang      06/09/2022 Slow SPI clock for old W5100 shield or SAMD Zero. Improve support for SAMD21
+  2.2.3   K Hoang      17/09/2022 Add support to AVR Dx (AVR128Dx, AVR64Dx, AVR32Dx, etc.) using DxCore
+  2.2.4   K Hoang      26/10/2022 Add support to Seeed XIAO_NRF52840 and XIAO_NRF52840_SENSE using `mbed` or `nRF52` core
+  2.3.0   K Hoang      15/11/2022 Add new features, such as CORS. Update code and examples to send big data
+ *************************************************************************************************************************************/
+
+#pragma once
+
+#ifndef REQUEST_ROUTER_H
+#define REQUEST_ROUTER_H
+
+#include "RequestHandler.h"
+#include "Debug.h"
+
+#define ROUTER_NONE     0xFFFF
+
+// Radix tree of the URIs of the handlers returning a routeUri(), built once from the handler list. Finding the
+// handler of a request walks the tree along the URI, without allocation, instead of asking every handler in turn.
+// A "{name}" segment of a route URI is a node accepting any path segment, whose position in the URI is returned
+// as a path argument. Handlers without routeUri() are still asked canHandle(). The first handler added accepting
+// the request wins, as with the handler list.
+class ethernetRequestRouter
+{
+  public:
+
+    ~ethernetRequestRouter()
+    {
+      clear();
+    }
+
+    ////////////////////////////////////////
+
+    // The tree is built again on next find(), after a handler is added
+    void invalidate()
+    {
+      _valid = false;
+    }
+
+    ////////////////////////////////////////
+
+    void build(ethernetRequestHandler* firstHandler)
+    {
+      clear();
+
+      _valid = true;
+
+      uint16_t handlerCount = 0;
+      uint32_t nodeCapacity = 1;
+
+      for (ethernetRequestHandler* handler = firstHandler; handler; handler = handler->next())
+      {
+        const String* uri = handler->routeUri();
+
+        // Each part of the URI between "{name}" segments adds at most one node, and one more splitting a label
+        if (uri)
+        {
+          for (const char* brace = uri->c_str(); (brace = strchr(brace, '{')); brace++)
+            nodeCapacity += 3;
+
+          nodeCapacity += 2;
+        }
+
+        if ( (++handlerCount == ROUTER_NONE) || (nodeCapacity >= ROUTER_NONE) )
+        {
+          ET_LOGERROR(F("Router: Too many handlers, using the handler list"));
+
+          return;
+        }
+      }
+
+      if (!handlerCount)
+        return;
+
+      _entries  = new Entry[handlerCount];
+      _nodes    = new Node[nodeCapacity];
+
+      if (!_entries || !_nodes)
+      {
+        ET_LOGERROR(F("Router: Can't allocate tree, using the handler list"));
+        clear();
+
+        return;
+      }
+
+      _nodes[0]  = Node();
+      _nodeCount = 1;
+
+      uint16_t lastOther = ROUTER_NONE;
+      uint16_t index = 0;
+
+      for (ethernetRequestHandler* handler = firstHandler; handler; handler = handler->next(), index++)
+      {
+        Entry& entry = _entries[index];
+
+        entry.handler = handler;
+        entry.method  = handler->routeMethod();
+        entry.next    = ROUTER_NONE;
+
+        const String* uri = handler->routeUri();
+
+        if (!uri)
+        {
+          if (lastOther == ROUTER_NONE)
+            _others = index;
+          else
+            _entries[lastOther].next = index;
+
+          lastOther = index;
+
+          continue;
+        }
+
+        uint16_t length = uri->length();
+        bool isPrefix = uri->endsWith("/*");
+
+        if (isPrefix)
+          length -= 2;
+
+        Node& node = _nodes[insert(uri->c_str(), length)];
+
+        uint16_t* chain = isPrefix ? &node.prefix : &node.exact;
+
+        while (*chain != ROUTER_NONE)
+          chain = &_entries[*chain].next;
+
+        *chain = index;
+
+        if (isPrefix)
+          node.prefixMethods |= methodMask(entry.method);
+        else
+          node.exactMethods |= methodMask(entry.method);
+      }
+
+      ET_LOGDEBUG3(F("Router: handlers ="), handlerCount, F(", nodes ="), _nodeCount);
+    }
+
+    ////////////////////////////////////////
+
+    // Returns the handler of the request, and the position in uri of the path segments matching its "{name}"
+    // segments, at most HTTP_MAX_PATH_ARGS
+    ethernetRequestHandler* find(ethernetRequestHandler* firstHandler, const HTTPMethod& method, const String& uri,
+                                 ethernetHTTPView* pathArgs, uint8_t& pathArgCount)
+    {
+      if (!_valid)
+        build(firstHandler);
+
+      pathArgCount = 0;
+
+      if (!_entries)
+      {
+        ethernetRequestHandler* handler;
+
+        for (handler = firstHandler; handler; handler = handler->next())
+        {
+          if (handler->canHandle(method, uri))
+            break;
+        }
+
+        if (handler && handler->routeUri())
+          setArgCount(pathArgCount, ethernetMatchRoute(handler->routeUri()->c_str(), uri.c_str(), pathArgs,
+                                                       HTTP_MAX_PATH_ARGS));
+
+        return handler;
+      }
+
+      Search search;
+
+      search.method       = method;
+      search.methodBit    = requestMask(method);
+      search.uri          = uri.c_str();
+      search.best         = ROUTER_NONE;
+      search.pathArgs     = pathArgs;
+      search.pathArgCount = 0;
+
+      find(search, 0, search.uri, uri.length(), 0);
+
+      // Handlers added before the one found, and not in the tree, come first
+      for (uint16_t index = _others; (index != ROUTER_NONE) && (index < search.best); index = _entries[index].next)
+      {
+        if (_entries[index].handler->canHandle(method, uri))
+          return _entries[index].handler;
+      }
+
+      if (search.best == ROUTER_NONE)
+        return nullptr;
+
+      pathArgCount = search.pathArgCount;
+
+      return _entries[search.best].handler;
+    }
+
+    ////////////////////////////////////////
+
+  private:
+
+    struct Entry
+    {
+      ethernetRequestHandler* handler;
+      HTTPMethod              method;
+      uint16_t                next;               // next entry of the same node, or next handler not in the tree
+    };
+
+    struct Node
+    {
+      const char* label         = "";             // part of the URI of the handler which added the node
+      uint16_t    labelLength   = 0;
+      uint16_t    child         = ROUTER_NONE;
+      uint16_t    sibling       = ROUTER_NONE;
+      uint16_t    param         = ROUTER_NONE;    // child accepting any path segment, for "{name}"
+      uint16_t    exact         = ROUTER_NONE;    // first handler of the URI ending here
+      uint16_t    prefix        = ROUTER_NONE;    // first handler of the "/*" URI ending here
+      uint8_t     exactMethods  = 0;
+      uint8_t     prefixMethods = 0;
+    };
+
+    struct Search
+    {
+      HTTPMethod        method;
+      uint8_t           methodBit;
+      const char*       uri;
+      uint16_t          best;                     // first entry found accepting the request
+      ethernetHTTPView* pathArgs;                 // path arguments of best
+      uint8_t           pathArgCount;
+      ethernetHTTPView  segments[HTTP_MAX_PATH_ARGS];   // path arguments of the nodes being walked
+    };
+
+    ////////////////////////////////////////
+
+    // One bit per method, shared by the methods of ESP32 beyond the first 8. Entries are then checked one by one
+    static uint8_t requestMask(const HTTPMethod& method)
+    {
+      return 1 << ((uint8_t) method & 7);
+    }
+
+    static uint8_t methodMask(const HTTPMethod& method)
+    {
+      return (method == HTTP_ANY) ? 0xFF : requestMask(method);
+    }
+
+    ////////////////////////////////////////
+
+    static void setArgCount(uint8_t& pathArgCount, int count)
+    {
+      pathArgCount = (count < 0) ? 0 : (count > HTTP_MAX_PATH_ARGS) ? HTTP_MAX_PATH_ARGS : count;
+    }
+
+    ////////////////////////////////////////
+
+    void accept(Search& search, uint16_t index, uint8_t segmentCount)
+    {
+      for ( ; (index != ROUTER_NONE) && (index < search.best); index = _entries[index].next)
+      {
+        if ( (_entries[index].method == HTTP_ANY) || (_entries[index].method == search.method) )
+        {
+          search.best = index;
+          setArgCount(search.pathArgCount, segmentCount);
+          memcpy(search.pathArgs, search.segments, search.pathArgCount * sizeof(ethernetHTTPView));
+
+          return;
+        }
+      }
+    }
+
+    ////////////////////////////////////////
+
+    // Walks the tree from current along path. Both the static child and the "{name}" child of a node may match,
+    // the first handler added is kept
+    void find(Search& search, uint16_t current, const char* path, uint16_t remaining, uint8_t segmentCount)
+    {
+      const Node& node = _nodes[current];
+
+      if (node.prefixMethods & search.methodBit)
+        accept(search, node.prefix, segmentCount);
+
+      if (!remaining)
+      {
+        if (node.exactMethods & search.methodBit)
+          accept(search, node.exact, segmentCount);
+
+        return;
+      }
+
+      uint16_t child = node.child;
+
+      while ( (child != ROUTER_NONE) && (_nodes[child].label[0] != *path) )
+        child = _nodes[child].sibling;
+
+      if ( (child != ROUTER_NONE) && (_nodes[child].labelLength <= remaining) &&
+           !memcmp(_nodes[child].label, path, _nodes[child].labelLength) )
+      {
+        find(search, child, path + _nodes[child].labelLength, remaining - _nodes[child].labelLength, segmentCount);
+      }
+
+      if ( (node.param != ROUTER_NONE) && (*path != '/') )
+      {
+        const char* segmentEnd = (const char*) memchr(path, '/', remaining);
+        uint16_t segmentLength = segmentEnd ? segmentEnd - path : remaining;
+
+        if (segmentCount < HTTP_MAX_PATH_ARGS)
+          search.segments[segmentCount] = { (uint16_t) (path - search.uri), segmentLength };
+
+        find(search, node.param, path + segmentLength, remaining - segmentLength,
+             (segmentCount < 0xFF) ? segmentCount + 1 : segmentCount);
+      }
+    }
+
+    ////////////////////////////////////////
+
+    // Returns the node where key ends, adding it, or splitting the label of a node to end there
+    uint16_t insert(const char* key, uint16_t length)
+    {
+      uint16_t current = 0;
+
+      while (length)
+      {
+        const char* brace = (const char*) memchr(key, '{', length);
+        const char* close = brace ? (const char*) memchr(brace, '}', key + length - brace) : nullptr;
+
+        if (!close)
+          return insertStatic(current, key, length);
+
+        current = insertStatic(current, key, brace - key);
+
+        if (_nodes[current].param == ROUTER_NONE)
+        {
+          _nodes[_nodeCount] = Node();
+          _nodes[current].param = _nodeCount++;
+        }
+
+        current  = _nodes[current].param;
+        length  -= close + 1 - key;
+        key      = close + 1;
+      }
+
+      return current;
+    }
+
+    ////////////////////////////////////////
+
+    uint16_t insertStatic(uint16_t current, const char* key, uint16_t length)
+    {
+      while (length)
+      {
+        uint16_t* link = &_nodes[current].child;
+
+        while ( (*link != ROUTER_NONE) && (_nodes[*link].label[0] != *key) )
+          link = &_nodes[*link].sibling;
+
+        if (*link == ROUTER_NONE)
+        {
+          Node& leaf = _nodes[_nodeCount];
+
+          leaf = Node();
+          leaf.label       = key;
+          leaf.labelLength = length;
+          *link = _nodeCount;
+
+          return _nodeCount++;
+        }
+
+        Node& child = _nodes[*link];
+        uint16_t common = 1;
+
+        while ( (common < child.labelLength) && (common < length) && (child.label[common] == key[common]) )
+          common++;
+
+        if (common < child.labelLength)
+        {
+          Node& split = _nodes[_nodeCount];
+
+          split = Node();
+          split.label       = child.label;
+          split.labelLength = common;
+          split.sibling     = child.sibling;
+          split.child       = *link;
+
+          child.label       += common;
+          child.labelLength -= common;
+          child.sibling      = ROUTER_NONE;
+
+          *link = _nodeCount++;
+        }
+
+        current  = *link;
+        key     += common;
+        length  -= common;
+      }
+
+      return current;
+    }
+
+    ////////////////////////////////////////
+
+    void clear()
+    {
+      delete[] _entries;
+      delete[] _nodes;
+
+      _entries    = nullptr;
+      _nodes      = nullptr;
+      _nodeCount  = 0;
+      _others     = ROUTER_NONE;
+      _valid      = false;
+    }
+
+    ////////////////////////////////////////
+
+    Entry*    _entries        = nullptr;          // one per handler, in the order of the handler list
+    Node*     _nodes          = nullptr;          // _nodes[0] is the root, for the empty URI
+    uint16_t  _nodeCount      = 0;
+    uint16_t  _others         = ROUTER_NONE;      // first handler not in the tree
+    bool      _valid          = false;
+};
+
+#endif  // REQUEST_ROUTER_H
@@ -0,0 +1,168 @@
+/****************************************************************************************************************************
+  StatusLines.h - Dead simple web-server.
+  For Ethernet shields
+
+  EthernetWebServer is a library for the Ethernet shields to run WebServer
+
+  Based on and modified from ESP8266 https://github.com/esp8266/Arduino/releases
+  Built by Khoi Hoang https://github.com/khoih-prog/EthernetWebServer
+  Licensed under MIT license
+
+  Original author:
+  @file       Esp8266WebServer.h
+  @author     Ivan Grokhotkov
+
+  Version: 2.3.0
+
+  Version Modified By   Date      Comments
+  ------- -----------  ---------- -----------
+  1.0.0   K Hoang      13/02/2020 Initial coding for Arduino Mega, Teensy, etc to support Ethernetx libraries
+  ...
+  2.0.0   K Hoang      16/01/2022 To coexist with ESP32 WebServer and ESP8266 ESP8266WebServer
+  2.0.1   K Hoang      02/03/2022 Fix decoding error bug
+  2.0.2   K Hoang      14/03/2022 Fix bug when using QNEthernet staticIP. Add staticIP option to NativeEthernet
+  2.1.0   K Hoang      03/04/2022 Use Ethernet_Generic library as default. Support SPI2 for ESP32
+  2.1.1   K Hoang      04/04/2022 Fix compiler error for Portenta_H7 using Portenta Ethernet
+  2.1.2   K Hoang      08/04/2022 Add support to SPI1 for RP2040 using arduino-pico core
+  2.1.3   K Hoang      27/04/2022 Change from `arduino.cc` to `arduino.tips` in examples
+  2.2.0   K Hoang      05/05/2022 Add support to custom SPI for Teensy, Mbed RP2040, Portenta_H7, etc.
+  2.2.1   K Hoang      25/08/2022 Auto-select SPI SS/CS pin according to board package
+  2.2.2   K Hoang      06/09/2022 Slow SPI clock for old W5100 shield or SAMD Zero. Improve support for SAMD21
+  2.2.3   K Hoang      17/09/2022 Add support to AVR Dx (AVR128Dx, AVR64Dx, AVR32Dx, etc.) using DxCore
+  2.2.4   K Hoang      26/10/2022 Add support to Seeed XIAO_NRF52840 and XIAO_NRF52840_SENSE using `mbed` or `nRF52` core
+  2.3.0   K Hoang      15/11/2022 Add new features, such as CORS. Update code and examples to send big data
+ *************************************************************************************************************************************/
+
+#pragma once
+
+#ifndef STATUS_LINES_H
+#define STATUS_LINES_H
+
+#include <stddef.h>
+
+// Codes and reasons of the status lines of the responses, in increasing order of code
+#define HTTP_STATUS_CODES(X)                            \
+  X(100, "Continue")                                    \
+  X(101, "Switching Protocols")                         \
+  X(200, "OK")                                          \
+  X(201, "Created")                                     \
+  X(202, "Accepted")                                    \
+  X(203, "Non-Authoritative Information")               \
+  X(204, "No Content")                                  \
+  X(205, "Reset Content")                               \
+  X(206, "Partial Content")                             \
+  X(300, "Multiple Choices")                            \
+  X(301, "Moved Permanently")                           \
+  X(302, "Found")                                       \
+  X(303, "See Other")                                   \
+  X(304, "Not Modified")                                \
+  X(305, "Use Proxy")                                   \
+  X(307, "Temporary Redirect")                          \
+  X(400, "Bad Request")                                 \
+  X(401, "Unauthorized")                                \
+  X(402, "Payment Required")                            \
+  X(403, "Forbidden")                                   \
+  X(404, "Not Found")                                   \
+  X(405, "Method Not Allowed")                          \
+  X(406, "Not Acceptable")                              \
+  X(407, "Proxy Authentication Required")               \
+  X(408, "Request Time-out")                            \
+  X(409, "Conflict")                                    \
+  X(410, "Gone")                                        \
+  X(411, "Length Required")                             \
+  X(412, "Precondition Failed")                         \
+  X(413, "Request Entity Too Large")                    \
+  X(414, "Request-URI Too Large")                       \
+  X(415, "Unsupported Media Type")                      \
+  X(416, "Requested range not satisfiable")             \
+  X(417, "Expectation Failed")                          \
+  X(500, "Internal Server Error")                       \
+  X(501, "Not Implemented")                             \
+  X(502, "Bad Gateway")                                 \
+  X(503, "Service Unavailable")                         \
+  X(504, "Gateway Time-out")                            \
+  X(505, "HTTP Version not supported")
+
+#define HTTP_STATUS_LINE(code, reason)          "HTTP/1.1 " #code " " reason "\r\n"
+#define HTTP_STATUS_LINE_FIELD(code, reason)    char line##code[sizeof(HTTP_STATUS_LINE(code, reason))];
+#define HTTP_STATUS_LINE_TEXT(code, reason)     HTTP_STATUS_LINE(code, reason),
+#define HTTP_STATUS_LINE_ENTRY(code, reason)    { code, offsetof(Lines, line##code) },
+
+namespace ethernetStatus
+{
+
+// Complete status lines, NUL-terminated one after the other. Being fields, the offset of each one is known when
+// compiling
+struct Lines
+{
+  HTTP_STATUS_CODES(HTTP_STATUS_LINE_FIELD)
+};
+
+// The same fields overlapping, the size of the longest line
+union LongestLine
+{
+  HTTP_STATUS_CODES(HTTP_STATUS_LINE_FIELD)
+};
+
+struct Entry
+{
+  uint16_t code;
+  uint16_t offset;      // of the line in lines
+};
+
+// Tables stored in PROGMEM, need to be global due to GCC section typing rules
+const Lines lines PROGMEM =
+{
+  HTTP_STATUS_CODES(HTTP_STATUS_LINE_TEXT)
+};
+
+// Sorted by code, for the binary search of find()
+const Entry table[] PROGMEM =
+{
+  HTTP_STATUS_CODES(HTTP_STATUS_LINE_ENTRY)
+};
+
+constexpr uint8_t tableSize     = sizeof(table) / sizeof(table[0]);
+
+// Length of the longest line, with its CRLF
+constexpr uint8_t maxLength     = sizeof(LongestLine) - 1;
+
+// The reason follows "HTTP/1.1 ddd "
+constexpr uint8_t reasonOffset  = sizeof("HTTP/1.1 100 ") - 1;
+
+// Return the status line of code in PROGMEM, "HTTP/1.1 code reason\r\n", and set its length. Return nullptr if
+// the code isn't in the table
+inline PGM_P find(int code, size_t& length)
+{
+  uint8_t low   = 0;
+  uint8_t high  = tableSize;
+
+  while (low < high)
+  {
+    uint8_t middle = (low + high) / 2;
+
+    if ((int) pgm_read_word(&table[middle].code) < code)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+
+  if ( (low == tableSize) || ((int) pgm_read_word(&table[low].code) != code) )
+    return nullptr;
+
+  uint16_t offset = pgm_read_word(&table[low].offset);
+  uint16_t end    = (low + 1 < tableSize) ? pgm_read_word(&table[low + 1].offset) : sizeof(Lines);
+
+  // Without the NUL
+  length = end - offset - 1;
+
+  return (PGM_P) &lines + offset;
+}
+
+} // namespace ethernetStatus
+
+#undef HTTP_STATUS_LINE_FIELD
+#undef HTTP_STATUS_LINE_TEXT
+#undef HTTP_STATUS_LINE_ENTRY
+
+#endif    // #ifndef STATUS_LINES_H
@@ -0,0 +1,222 @@
+/****************************************************************************************************************************
+  TemplateRenderer.h - Dead simple web-server.
+  For Ethernet shields
+
+  EthernetWebServer is a library for the Ethernet shields to run WebServer
+
+  Based on and modified from ESP8266 https://github.com/esp8266/Arduino/releases
+  Built by Khoi Hoang https://github.com/khoih-prog/EthernetWebServer
+  Licensed under MIT license
+
+  Original author:
+  @file       Esp8266WebServer.h
+  @author     Ivan Grokhotkov
+
+  Version: 2.3.0
+
+  Version Modified By   Date      Comments
+  ------- -----------  ---------- -----------
+  1.0.0   K Hoang      13/02/2020 Initial coding for Arduino Mega, Teensy, etc to support Ethernetx libraries
+  ...
+  2.0.0   K Hoang      16/01/2022 To coexist with ESP32 WebServer and ESP8266 ESP8266WebServer
+  2.0.1   K Hoang      02/03/2022 Fix decoding error bug
+  2.0.2   K Hoang      14/03/2022 Fix bug when using QNEthernet staticIP. Add staticIP option to NativeEthernet
+  2.1.0   K Hoang      03/04/2022 Use Ethernet_Generic library as default. Support SPI2 for ESP32
+  2.1.1   K Hoang      04/04/2022 Fix compiler error for Portenta_H7 using Portenta Ethernet
+  2.1.2   K Hoang      08/04/2022 Add support to SPI1 for RP2040 using arduino-pico core
+  2.1.3   K Hoang      27/04/2022 Change from `arduino.cc` to `arduino.tips` in examples
+  2.2.0   K Hoang      05/05/2022 Add support to custom SPI for Teensy, Mbed RP2040, Portenta_H7, etc.
+  2.2.1   K Hoang      25/08/2022 Auto-select SPI SS/CS pin according to board package
+  2.2.2   K Hoang      06/09/2022 Slow SPI clock for old W5100 shield or SAMD Zero. Improve support for SAMD21
+  2.2.3   K Hoang      17/09/2022 Add support to AVR Dx (AVR128Dx, AVR64Dx, AVR32Dx, etc.) using DxCore
+  2.2.4   K Hoang      26/10/2022 Add support to Seeed XIAO_NRF52840 and XIAO_NRF52840_SENSE using `mbed` or `nRF52` core
+  2.3.0   K Hoang      15/11/2022 Add new features, such as CORS. Update code and examples to send big data
+ *************************************************************************************************************************************/
+
+#pragma once
+
+#ifndef TEMPLATE_RENDERER_H
+#define TEMPLATE_RENDERER_H
+
+#include <ctype.h>
+#include <string.h>
+
+#include "Debug.h"
+
+// Renderer of a PROGMEM template, replacing each %NAME% placeholder with the value its processor returns for NAME.
+// The output is passed to the writer in pieces of up to HTTP_TEMPLATE_BUFLEN bytes, filled in a buffer on the stack,
+// so that a page of any size is rendered in constant memory.
+// A name is made of letters, digits and '_', up to 31 chars. A '%' not starting a placeholder, as in "width: 50%",
+// is kept as written, as is a placeholder for which the processor returns nullptr. "%%" is rendered as "%"
+class ethernetTemplateRenderer
+{
+  public:
+
+    // Return the value of the placeholder name, NUL-terminated and valid until the next call, or nullptr
+    typedef vl::Func<const char*(const char* name)>           TProcessorFunction;
+    typedef vl::Func<void(const char* data, size_t length)>   TWriteFunction;
+
+    ethernetTemplateRenderer(const TProcessorFunction& processor, const TWriteFunction& writer)
+      : _processor(processor)
+      , _writer(writer)
+      , _pieceLength(0)
+      , _length(0)
+    {
+    }
+
+    ////////////////////////////////////////
+
+    // Render tmpl, a NUL-terminated PROGMEM string. Return the length of the output
+    size_t render(PGM_P tmpl)
+    {
+      PGM_P literal = tmpl;       // start of the text not yet output
+      PGM_P p       = tmpl;
+      char  c;
+
+      while ( (c = pgm_read_byte(p)) )
+      {
+        if (c != '%')
+        {
+          p++;
+
+          continue;
+        }
+
+        char    name[NAME_LEN];
+        uint8_t nameLength  = 0;
+        PGM_P   end         = p + 1;
+
+        while (nameLength < NAME_LEN - 1)
+        {
+          c = pgm_read_byte(end);
+
+          if ( !isalnum((unsigned char) c) && (c != '_') )
+            break;
+
+          name[nameLength++] = c;
+          end++;
+        }
+
+        if (pgm_read_byte(end) != '%')
+        {
+          // Not a placeholder
+          p++;
+
+          continue;
+        }
+
+        _append_P(literal, p - literal);
+
+        name[nameLength] = 0;
+        end++;
+
+        const char* value = nameLength ? _processor(name) : "%";
+
+        if (value)
+        {
+          _append(value, strlen(value));
+        }
+        else
+        {
+          ET_LOGDEBUG1(F("render: no value for"), name);
+
+          _append_P(p, end - p);
+        }
+
+        p       = end;
+        literal = end;
+      }
+
+      _append_P(literal, p - literal);
+      _flush();
+
+      return _length;
+    }
+
+    ////////////////////////////////////////
+
+  private:
+
+    static const uint8_t NAME_LEN = 32;
+
+    ////////////////////////////////////////
+
+    void _append(const char* data, size_t length)
+    {
+      _length += length;
+
+      if (length >= HTTP_TEMPLATE_BUFLEN)
+      {
+        // Too long to be gathered, written as it is
+        _flush();
+        _writer(data, length);
+
+        return;
+      }
+
+      while (length)
+      {
+        size_t toCopy = HTTP_TEMPLATE_BUFLEN - _pieceLength;
+
+        if (toCopy > length)
+          toCopy = length;
+
+        memcpy(_piece + _pieceLength, data, toCopy);
+        _pieceLength  += toCopy;
+        data          += toCopy;
+        length        -= toCopy;
+
+        if (_pieceLength == HTTP_TEMPLATE_BUFLEN)
+          _flush();
+      }
+    }
+
+    ////////////////////////////////////////
+
+    void _append_P(PGM_P data, size_t length)
+    {
+#if ETHERNET_PROGMEM_MAPPED
+      // Flash is read in place
+      _append(data, length);
+#else
+      _length += length;
+
+      while (length)
+      {
+        size_t toCopy = HTTP_TEMPLATE_BUFLEN - _pieceLength;
+
+        if (toCopy > length)
+          toCopy = length;
+
+        memcpy_P(_piece + _pieceLength, data, toCopy);
+        _pieceLength  += toCopy;
+        data          += toCopy;
+        length        -= toCopy;
+
+        if (_pieceLength == HTTP_TEMPLATE_BUFLEN)
+          _flush();
+      }
+#endif
+    }
+
+    ////////////////////////////////////////
+
+    void _flush()
+    {
+      if (_pieceLength)
+      {
+        _writer(_piece, _pieceLength);
+        _pieceLength = 0;
+      }
+    }
+
+    ////////////////////////////////////////
+
+    const TProcessorFunction&   _processor;
+    const TWriteFunction&       _writer;
+    char                        _piece[HTTP_TEMPLATE_BUFLEN];
+    uint16_t                    _pieceLength;
+    size_t                      _length;
+};
+
+#endif // TEMPLATE_RENDERER_H